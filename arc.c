@@ -0,0 +1,210 @@
+#include "policy.h"
+
+#include <stdlib.h>
+
+/*
+ARC, the Adaptive Replacement Cache (Megiddo and Modha, FAST 2003).
+
+Resident pages are split between T1 (seen once recently) and T2 (seen at least
+twice). B1 and B2 remember pages recently evicted from T1 and T2. A miss that
+hits B1 grows the target size "p" of T1, a miss that hits B2 shrinks it, so the
+split between recency and frequency adapts to the workload. One-off scans only
+ever pass through T1 and cannot flush the frequently used pages out of T2.
+*/
+
+#define ARC_NONE 0
+#define ARC_T1 1
+#define ARC_T2 2
+#define ARC_B1 3
+#define ARC_B2 4
+
+struct arc_state
+{
+    unsigned char *where;
+    int *next;
+    int *prev;
+    struct page_list t1, t2, b1, b2;
+    int p;
+
+    // decisions taken in on_fault for the page being brought in
+    int into_t2;
+    int hit_b2;
+    int drop_victim;
+};
+
+static struct page_list *arc_list(struct arc_state *s, int where)
+{
+    switch (where)
+    {
+    case ARC_T1:
+        return &s->t1;
+    case ARC_T2:
+        return &s->t2;
+    case ARC_B1:
+        return &s->b1;
+    case ARC_B2:
+        return &s->b2;
+    }
+    return 0;
+}
+
+static void arc_move(struct arc_state *s, int page, int where)
+{
+    if (s->where[page] != ARC_NONE)
+        page_list_remove(arc_list(s, s->where[page]), s->next, s->prev, page);
+
+    s->where[page] = where;
+
+    if (where != ARC_NONE)
+        page_list_push(arc_list(s, where), s->next, s->prev, page);
+}
+
+static void arc_forget_lru(struct arc_state *s, struct page_list *l)
+{
+    int page = page_list_pop(l, s->next, s->prev);
+
+    if (page >= 0)
+        s->where[page] = ARC_NONE;
+}
+
+static void arc_destroy(struct policy *p)
+{
+    struct arc_state *s = p->state;
+
+    free(s->where);
+    free(s->next);
+    free(s->prev);
+    free(s);
+}
+
+static int arc_init(struct policy *p)
+{
+    struct arc_state *s = calloc(1, sizeof(*s));
+
+    if (!s)
+        return -1;
+
+    s->where = calloc(p->npages, 1);
+    s->next = malloc(sizeof(int) * p->npages);
+    s->prev = malloc(sizeof(int) * p->npages);
+    p->state = s;
+
+    if (!s->where || !s->next || !s->prev)
+    {
+        arc_destroy(p);
+        return -1;
+    }
+
+    page_list_init(&s->t1);
+    page_list_init(&s->t2);
+    page_list_init(&s->b1);
+    page_list_init(&s->b2);
+
+    return 0;
+}
+
+static void arc_on_fault(struct policy *p, int page)
+{
+    struct arc_state *s = p->state;
+    int c = p->nframes;
+
+    s->into_t2 = 0;
+    s->hit_b2 = 0;
+    s->drop_victim = 0;
+
+    if (s->where[page] == ARC_B1)
+    {
+        int delta = s->b2.size > s->b1.size ? s->b2.size / s->b1.size : 1;
+
+        s->p = s->p + delta < c ? s->p + delta : c;
+        arc_move(s, page, ARC_NONE);
+        s->into_t2 = 1;
+    }
+    else if (s->where[page] == ARC_B2)
+    {
+        int delta = s->b1.size > s->b2.size ? s->b1.size / s->b2.size : 1;
+
+        s->p = s->p - delta > 0 ? s->p - delta : 0;
+        arc_move(s, page, ARC_NONE);
+        s->into_t2 = 1;
+        s->hit_b2 = 1;
+    }
+    else if (s->t1.size + s->b1.size >= c)
+    {
+        if (s->t1.size < c)
+            arc_forget_lru(s, &s->b1);
+        else
+            s->drop_victim = 1;
+    }
+    else
+    {
+        int total = s->t1.size + s->t2.size + s->b1.size + s->b2.size;
+
+        if (total >= 2 * c)
+            arc_forget_lru(s, &s->b2);
+    }
+}
+
+static int arc_choose_victim(struct policy *p, int page)
+{
+    struct arc_state *s = p->state;
+    int victim = -1;
+
+    if (s->t1.size >= 1 && (s->drop_victim || s->t1.size > s->p || (s->hit_b2 && s->t1.size == s->p)))
+        victim = policy_list_victim(p, &s->t1, s->prev);
+
+    if (victim < 0)
+        victim = policy_list_victim(p, &s->t2, s->prev);
+
+    if (victim < 0)
+        victim = policy_list_victim(p, &s->t1, s->prev);
+
+    return victim < 0 ? -1 : frame_table_lookup(p->ft, victim);
+}
+
+static void arc_on_evict(struct policy *p, int page, int frame)
+{
+    struct arc_state *s = p->state;
+
+    if (s->where[page] == ARC_T1)
+        arc_move(s, page, s->drop_victim ? ARC_NONE : ARC_B1);
+    else if (s->where[page] == ARC_T2)
+        arc_move(s, page, ARC_B2);
+
+    s->drop_victim = 0;
+
+    // keep the directory within 2c pages even when pages are evicted behind our back
+    while (s->t1.size + s->b1.size > p->nframes)
+        arc_forget_lru(s, &s->b1);
+    while (s->t1.size + s->t2.size + s->b1.size + s->b2.size > 2 * p->nframes)
+        arc_forget_lru(s, &s->b2);
+}
+
+static void arc_on_load(struct policy *p, int page, int frame)
+{
+    struct arc_state *s = p->state;
+
+    arc_move(s, page, s->into_t2 ? ARC_T2 : ARC_T1);
+    s->into_t2 = 0;
+    s->hit_b2 = 0;
+}
+
+static void arc_on_access(struct policy *p, int page, int frame)
+{
+    struct arc_state *s = p->state;
+
+    if (s->where[page] == ARC_T1 || s->where[page] == ARC_T2)
+        arc_move(s, page, ARC_T2);
+}
+
+const struct policy_ops arc_policy_ops = {
+    .name = "arc",
+    .sampled = 1,
+    .init = arc_init,
+    .destroy = arc_destroy,
+    .on_fault = arc_on_fault,
+    .on_access = arc_on_access,
+    .choose_victim = arc_choose_victim,
+    .on_evict = arc_on_evict,
+    .on_load = arc_on_load,
+};
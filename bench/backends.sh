@@ -0,0 +1,20 @@
+#!/bin/sh
+# Compare fault throughput of the SIGSEGV and userfaultfd page table backends
+# on the four test programs.
+#
+# use: bench/backends.sh [npages] [nframes] [policy]
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+POLICY=${3:-fifo}
+VIRTMEM=${VIRTMEM:-./virtmem}
+
+printf "%-8s %-8s %12s %12s %14s\n" program backend faults seconds faults/sec
+for program in alpha beta gamma delta; do
+    for backend in sigsegv uffd; do
+        $VIRTMEM -b $backend $NPAGES $NFRAMES $POLICY $program | awk -v p=$program -v b=$backend '
+            /^Summary:/ { faults = $5 }
+            /^Timing:/  { secs = $2; rate = $5 }
+            END { printf "%-8s %-8s %12d %12.6f %14.0f\n", p, b, faults, secs, rate }'
+    done
+done
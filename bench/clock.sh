@@ -0,0 +1,35 @@
+#!/bin/sh
+# Report page faults and page-ins (disk reads) of CLOCK and CLOCK-Pro against
+# FIFO for the four test programs over a range of frame counts. Improvement is
+# the percentage of FIFO's figure avoided; negative means more than FIFO.
+# CLOCK and CLOCK-Pro sample reference bits by dropping pages to PROT_NONE every
+# SAMPLE faults, so their fault counts include those re-faults, which need no
+# disk read: page-ins show what the better victims save on their own.
+#
+# use: bench/clock.sh [npages] [nframes...]
+
+NPAGES=${1:-200}
+[ $# -gt 0 ] && shift
+FRAMES=${*:-"10 25 50 100 150"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+SAMPLE=${SAMPLE:-16}
+
+# prints "faults page-ins"
+run() {
+    $VIRTMEM -s $SAMPLE $NPAGES $1 $2 $3 | awk '/^Summary:/ { print $5, $10 }'
+}
+
+improvement() {
+    awk -v base=$1 -v n=$2 'BEGIN { printf "%+.1f%%", base ? 100.0 * (base - n) / base : 0 }'
+}
+
+printf "%-8s %8s %-8s %9s %9s %8s %9s %8s\n" program nframes figure fifo clock improv clockpro improv
+for program in alpha beta gamma delta; do
+    for nframes in $FRAMES; do
+        set -- $(run $nframes fifo $program) $(run $nframes clock $program) $(run $nframes clockpro $program)
+        printf "%-8s %8d %-8s %9d %9d %8s %9d %8s\n" $program $nframes faults $1 \
+            $3 "$(improvement $1 $3)" $5 "$(improvement $1 $5)"
+        printf "%-8s %8d %-8s %9d %9d %8s %9d %8s\n" $program $nframes page-ins $2 \
+            $4 "$(improvement $2 $4)" $6 "$(improvement $2 $6)"
+    done
+done
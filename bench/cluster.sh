@@ -0,0 +1,23 @@
+#!/bin/sh
+# Compare dirty-page write-back with and without write clustering on the
+# file-backed virtual disk: blocks written, write operations (system calls or
+# io_uring submissions) and time the fault handler spent waiting for the disk.
+#
+# use: bench/cluster.sh [npages] [nframes] [cluster]
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+CLUSTER=${3:-16}
+VIRTMEM=${VIRTMEM:-./virtmem}
+POLICY=${POLICY:-fifo}
+
+# prints: blocks written, write ops, seconds waiting
+writes() {
+    $VIRTMEM -c $1 $NPAGES $NFRAMES $POLICY $2 | awk '/^Disk I\/O:/ { print $9, $12, $17 }'
+}
+
+printf "%-8s %8s %10s %10s %10s %10s %10s %10s\n" program cluster writes ops wait-s writes ops wait-s
+for program in alpha beta gamma delta; do
+    set -- $(writes 0 $program) $(writes $CLUSTER $program)
+    printf "%-8s %8d %10d %10d %10.4f %10d %10d %10.4f\n" $program $CLUSTER $1 $2 $3 $4 $5 $6
+done
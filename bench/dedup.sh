@@ -0,0 +1,43 @@
+#!/bin/sh
+# Measure content-based page sharing (virtmem -K): faults and disk I/O with
+# sharing off, with it on, and with it on over the log-structured swap area,
+# where merged pages and dirty victims already on disk also share disk blocks.
+# "saved" is the most frames that pages merged onto others spared at once.
+#
+# use: bench/dedup.sh [npages] [nframes] [scan-frames]
+#
+# WORKLOADS sets the runs as policy:program pairs (default "fifo:gamma
+# fifo:delta clock:alpha fifo:beta"), SEGMENT the log's segment size in blocks
+# (default 64).
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+SCAN=${3:-32}
+WORKLOADS=${WORKLOADS:-"fifo:gamma fifo:delta clock:alpha fifo:beta"}
+SEGMENT=${SEGMENT:-64}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/dedup.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+printf "%-8s %-8s %-9s %8s %8s %8s %8s %8s %8s %8s %10s\n" \
+    policy program sharing faults reads writes merged saved broken blocks seconds
+for workload in $WORKLOADS; do
+    policy=${workload%%:*}
+    program=${workload#*:}
+    for mode in off on log; do
+        case $mode in
+        off) options= ;;
+        on)  options="-K $SCAN" ;;
+        log) options="-K $SCAN -L $SEGMENT" ;;
+        esac
+        $VIRTMEM $options -d $DISK $NPAGES $NFRAMES $policy $program | awk -v policy=$policy -v program=$program -v mode=$mode '
+            /^Summary:/       { faults = $5; reads = $10; writes = $15 }
+            /^Timing:/        { secs = $2 }
+            /^Page sharing:/  { merged = $11; saved = $21; broken = $27; blocks = $35 }
+            END {
+                if (secs == "") { printf "%-8s %-8s %-9s failed\n", policy, program, mode; exit }
+                printf "%-8s %-8s %-9s %8d %8d %8d %8d %8d %8d %8d %10.6f\n", policy, program, mode,
+                       faults, reads, writes, merged, saved, broken, blocks, secs
+            }'
+    done
+done
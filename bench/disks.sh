@@ -0,0 +1,34 @@
+#!/bin/sh
+# Compare the disk backends (virtmem -D): buffered file, O_DIRECT, mmap and RAM,
+# each with the engine it gets by default. Latencies are per disk operation, from
+# submission to completion (virtmem -l), in microseconds; throughput is the blocks
+# moved per second of the whole run.
+#
+# use: bench/disks.sh [npages] [nframes] [policy] [program]
+#
+# BACKENDS sets the backends (default "file direct mmap ram"). The disk file is
+# made in TMPDIR, which must support O_DIRECT for the direct backend.
+
+NPAGES=${1:-2000}
+NFRAMES=${2:-200}
+POLICY=${3:-fifo}
+PROGRAM=${4:-gamma}
+BACKENDS=${BACKENDS:-"file direct mmap ram"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/disks.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+printf "%-8s %-12s %8s %8s %10s %12s %9s %9s %9s %9s\n" \
+    backend engine reads writes seconds blocks/sec rd-p50 rd-p99 wr-p50 wr-p99
+for backend in $BACKENDS; do
+    $VIRTMEM -l -D $backend -d $DISK $NPAGES $NFRAMES $POLICY $PROGRAM | awk -v backend=$backend '
+        /^Summary:/ { reads = $10; writes = $15 }
+        /^Timing:/  { secs = $2; engine = $8 }
+        /^Latency \(us\): disk read/  { rp50 = $6; rp99 = $7 }
+        /^Latency \(us\): disk write/ { wp50 = $6; wp99 = $7 }
+        END {
+            if (secs == "") { printf "%-8s failed\n", backend; exit }
+            printf "%-8s %-12s %8d %8d %10.6f %12.0f %9.1f %9.1f %9.1f %9.1f\n", backend, engine, reads, writes, secs,
+                   (secs > 0 ? (reads + writes) / secs : 0), rp50, rp99, wp50, wp99
+        }'
+done
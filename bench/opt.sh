@@ -0,0 +1,34 @@
+#!/bin/sh
+# Report how far each policy is from optimal: record a trace of every test
+# program with two frames, then replay it in vmsim against every policy and OPT
+# over a range of frame counts. "vs OPT" is the policy's misses over OPT's.
+# OPT taking more misses than fifo anywhere is reported, and the script exits 1.
+#
+# use: bench/opt.sh [npages] [nframes...]
+
+NPAGES=${1:-200}
+[ $# -gt 0 ] && shift
+FRAMES=${*:-"10 25 50 100 150"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+VMSIM=${VMSIM:-./vmsim}
+TRACE=${TMPDIR:-/tmp}/opt-$$.trace
+
+status=0
+for program in alpha beta gamma delta; do
+    $VIRTMEM -t $TRACE $NPAGES 2 fifo $program > /dev/null || exit 1
+    for nframes in $FRAMES; do
+        echo "== $program, $nframes frames"
+        $VMSIM $TRACE $nframes all | tail -n +2 | tee $TRACE.out
+        awk -v key="$program, $nframes frames" '
+            $1 == "fifo" { fifo = $3 }
+            $1 == "opt"  { opt = $3 }
+            END {
+                if (opt > fifo) {
+                    printf "OPT WORSE  %s: opt %d misses, fifo %d\n", key, opt, fifo
+                    exit 1
+                }
+            }' $TRACE.out >&2 || status=1
+    done
+done
+rm -f $TRACE $TRACE.out
+exit $status
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Throughput of the page kernels (page_ops.h) in each instruction set the CPU
+# runs, in GB/s, over pages that stay in the cache and pages that do not. opsbench
+# checks every set against the scalar one first, and this fails if any disagrees.
+#
+# use: bench/pageops.sh
+#
+# SIZES sets the numbers of pages gone round (default "16 16384": 64 KiB and
+# 64 MiB), KERNELS limits the sets to the one named.
+
+SIZES=${SIZES:-"16 16384"}
+OPSBENCH=${OPSBENCH:-./opsbench}
+OUT=$(mktemp "${TMPDIR:-/tmp}/pageops.XXXXXX") || exit 1
+trap 'rm -f $OUT' EXIT
+status=0
+
+printf "%-8s %-8s %8s %8s %8s %8s\n" pages kernels zero hash equal copy
+for size in $SIZES; do
+    $OPSBENCH ${KERNELS:+-k $KERNELS} $size > $OUT || status=1
+    awk -v size=$size '
+        /^Kernels:.*failed/ { printf "%-8s %-8s failed %s checks\n", size, $2, $4; next }
+        /^Kernels:/ { printf "%-8s %-8s %8s %8s %8s %8s\n", size, $2, $11, $15, $19, $23 }' $OUT
+done
+exit $status
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Compare page sizes (virtmem -p) on the four test programs. Virtual and
+# physical memory stay the same size in bytes, so a larger page means fewer
+# pages, fewer faults and fewer, larger disk transfers. Speedup is the run time
+# against the first page size.
+#
+# use: bench/pagesize.sh [virtual-MiB] [physical-percent] [policy] [backend]
+#
+# SIZES sets the page sizes (default "4k 16k 64k 256k 1m 2m").
+
+VIRTUAL=${1:-16}
+PERCENT=${2:-25}
+POLICY=${3:-fifo}
+BACKEND=${4:-sigsegv}
+SIZES=${SIZES:-"4k 16k 64k 256k 1m 2m"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/pagesize.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+printf "%-8s %6s %7s %7s %10s %10s %10s %10s %12s %8s %s\n" \
+    program size npages nframes faults reads writes seconds faults/sec speedup memory
+for program in alpha beta gamma delta; do
+    base=
+    for size in $SIZES; do
+        kib=$(echo $size | awk '/[mM]$/ { print $0 * 1024; next } { print $0 + 0 }')
+        npages=$((VIRTUAL * 1024 / kib))
+        nframes=$((npages * PERCENT / 100))
+        [ $nframes -lt 2 ] && nframes=2
+        line=$($VIRTMEM -b $BACKEND -d $DISK -p $size $npages $nframes $POLICY $program | awk '
+            /^Summary:/ { faults = $5; reads = $10; writes = $15 }
+            /^Timing:/  { secs = $2; rate = $5 }
+            /^Pages:/   { memory = $5 }
+            END { printf "%d %d %d %.6f %.0f %s\n", faults, reads, writes, secs, rate, memory == "" ? "normal" : memory }')
+        set -- $line
+        [ -z "$base" ] && base=$4
+        printf "%-8s %6s %7d %7d %10d %10d %10d %10.6f %12.0f %7.2fx %s\n" $program $size $npages $nframes $1 $2 $3 $4 $5 \
+            $(awk -v t=$4 -v b=$base 'BEGIN { printf "%f", (t > 0 ? b / t : 0) }') $6
+    done
+done
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Memory taken by the page table as the virtual memory grows, with the same number
+# of entries set in each layout (see ptbench.c), next to the flat arrays of one
+# frame and one set of bits per page. Set and get are per entry, in nanoseconds.
+#
+# use: bench/pagetable.sh [count]
+#
+# SIZES sets the virtual memory sizes in pages (default 2^20, 2^24, 2^28 and 2^30),
+# PATTERNS the layouts (default "dense spread random"). Every page mapped on its
+# own takes its own kernel mappings, and Linux allows about 65530 per process
+# (vm.max_map_count), so scattered counts much past 16384 run out of memory.
+
+COUNT=${1:-16384}
+SIZES=${SIZES:-"1048576 16777216 268435456 1073741824"}
+PATTERNS=${PATTERNS:-"dense spread random"}
+PTBENCH=${PTBENCH:-./ptbench}
+
+printf "%-11s %-7s %12s %9s %14s %10s %8s %8s\n" \
+    pages pattern bytes per-entry flat-bytes saving set-ns get-ns
+for size in $SIZES; do
+    for pattern in $PATTERNS; do
+        $PTBENCH $size $COUNT $pattern | awk -v size=$size -v pattern=$pattern '
+            /^Page table:/ { bytes = $11; per = $15; flat = $22; saving = $24; set = $27; get = $30 }
+            END {
+                if (bytes == "") { printf "%-11s %-7s failed\n", size, pattern; exit }
+                printf "%-11s %-7s %12s %9s %14s %10s %8s %8s\n", size, pattern, bytes, per, flat, saving, set, get
+            }'
+    done
+done
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Measure warm restarts: each workload runs cold on a fresh disk, saving a
+# snapshot of its memory at the end (virtmem -S), then again from that snapshot
+# (virtmem -U) over the disk the first run left. "restored" is the pages put
+# back in frames before the program started, and "restore" the time it took,
+# which is not part of the run's own time.
+#
+# use: bench/snapshot.sh [npages] [nframes]
+#
+# WORKLOADS sets the runs as policy:program pairs (default "clock:alpha
+# clock:beta clock:gamma fifo:delta"), OPTIONS extra virtmem options for both runs.
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-1000}
+WORKLOADS=${WORKLOADS:-"clock:alpha clock:beta clock:gamma fifo:delta"}
+OPTIONS=${OPTIONS:-}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/snapshot.XXXXXX") || exit 1
+SNAPSHOT=$(mktemp "${TMPDIR:-/tmp}/snapshot.XXXXXX") || exit 1
+trap 'rm -f $DISK $SNAPSHOT' EXIT
+
+printf "%-8s %-8s %-5s %8s %8s %8s %10s %9s %10s\n" \
+    policy program start faults reads writes seconds restored restore
+for workload in $WORKLOADS; do
+    policy=${workload%%:*}
+    program=${workload#*:}
+    for start in cold warm; do
+        case $start in
+        cold) options="-S $SNAPSHOT" ;;
+        warm) options="-U $SNAPSHOT" ;;
+        esac
+        $VIRTMEM $OPTIONS $options -d $DISK $NPAGES $NFRAMES $policy $program | awk -v policy=$policy -v program=$program -v start=$start '
+            /^Summary:/     { faults = $5; reads = $10; writes = $15 }
+            /^Timing:/      { secs = $2 }
+            /^Warm start:/  { restored = $3; restore = $25 }
+            END {
+                if (secs == "") { printf "%-8s %-8s %-5s failed\n", policy, program, start; exit }
+                printf "%-8s %-8s %-5s %8d %8d %8d %10.6f %9d %10.6f\n", policy, program, start,
+                       faults, reads, writes, secs, restored, restore
+            }'
+    done
+done
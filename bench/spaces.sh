@@ -0,0 +1,42 @@
+#!/bin/sh
+# Measure how programs sharing one memory interfere: each program alone with all
+# the frames, then all of them side by side in their own address spaces (virtmem
+# with a list of programs), with global replacement and with local replacement
+# on equal quotas. Faults are counted per program; "stolen" is how many of its
+# pages were evicted to make room for another program's.
+#
+# use: bench/spaces.sh [npages] [nframes] [backend]
+#
+# PROGRAMS sets the programs run together (default "alpha beta"), POLICIES the
+# policies (default "fifo clock arc lirs").
+
+NPAGES=${1:-100}
+NFRAMES=${2:-20}
+BACKEND=${3:-sigsegv}
+PROGRAMS=${PROGRAMS:-"alpha beta"}
+POLICIES=${POLICIES:-"fifo clock arc lirs"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/spaces.XXXXXX") || exit 1
+trap 'rm -f $DISK $DISK.global $DISK.local' EXIT
+
+LIST=$(echo $PROGRAMS | tr ' ' ',')
+
+# the per-space lines of a run, as "faults stolen seconds", one per program
+spaces() {
+    $VIRTMEM -b $BACKEND -d $DISK "$@" | awk -F'|' '
+        /^Space / { split($3, f, " "); split($6, e, " "); split($7, t, " "); print f[4], e[3], t[1] }'
+}
+
+printf "%-8s %-8s %10s %10s %8s %10s %8s %10s %10s\n" \
+    policy program alone global stolen local stolen global/s local/s
+for policy in $POLICIES; do
+    spaces -R global $NPAGES $NFRAMES $policy $LIST > $DISK.global
+    spaces -R local $NPAGES $NFRAMES $policy $LIST > $DISK.local
+    i=1
+    for program in $PROGRAMS; do
+        alone=$($VIRTMEM -b $BACKEND -d $DISK $NPAGES $NFRAMES $policy $program | awk '/^Summary:/ { print $5 }')
+        set -- $(sed -n ${i}p $DISK.global) $(sed -n ${i}p $DISK.local)
+        printf "%-8s %-8s %10d %10d %8d %10d %8d %10.6f %10.6f\n" $policy $program $alone $1 $2 $4 $5 $3 $6
+        i=$((i + 1))
+    done
+done
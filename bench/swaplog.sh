@@ -0,0 +1,45 @@
+#!/bin/sh
+# Compare write-back in place with the log-structured swap area (virtmem -L):
+# how many write operations went to the disk, how many of them were sequential
+# (started where the handle's previous write ended), and what cleaning the log's
+# segments cost in pages moved. Each workload runs in place, then with the log
+# at every spare percentage.
+#
+# use: bench/swaplog.sh [npages] [nframes] [segment-blocks]
+#
+# WORKLOADS sets the runs as policy:program pairs (default "rand:beta fifo:beta
+# rand:alpha"), SPARES the spare space of the log in percent (default "10 25 50").
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+SEGMENT=${3:-64}
+WORKLOADS=${WORKLOADS:-"rand:beta fifo:beta rand:alpha"}
+SPARES=${SPARES:-"10 25 50"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/swaplog.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+printf "%-8s %-8s %-10s %8s %8s %8s %10s %8s %8s %10s\n" \
+    policy program layout pages writes ops sequential moved amplif seconds
+for workload in $WORKLOADS; do
+    policy=${workload%%:*}
+    program=${workload#*:}
+    for layout in place $SPARES; do
+        if [ $layout = place ]; then
+            options=
+            name=in-place
+        else
+            options="-L $SEGMENT:$layout"
+            name="log+$layout%"
+        fi
+        $VIRTMEM $options -d $DISK $NPAGES $NFRAMES $policy $program | awk -v policy=$policy -v program=$program -v name=$name '
+            /^Summary:/  { pages = $15 }
+            /^Timing:/   { secs = $2 }
+            /^Disk I\/O:/ { writes = $9; ops = $12; seq = $14 }
+            /^Swap log:/ { moved = $14 }
+            END {
+                printf "%-8s %-8s %-10s %8d %8d %8d %9.1f%% %8d %8.2f %10.6f\n", policy, program, name, pages, writes, ops,
+                       (ops ? 100 * seq / ops : 0), moved, (pages ? writes / pages : 0), secs
+            }'
+    done
+done
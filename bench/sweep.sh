@@ -0,0 +1,126 @@
+#!/bin/sh
+# Sweep npages x nframes x policy x program, running every combination in
+# parallel across all cores, and report faults, disk reads, disk writes, run time
+# and faults/sec for each as CSV or JSON. Every run has its own disk file
+# (virtmem -d); physical memory is per process already, so runs cannot interfere.
+#
+# Against a baseline (a CSV saved by an earlier sweep), a run whose faults, reads
+# or writes went up is a regression, reported on stderr, and the script exits 1.
+# A run whose faults/sec fell by more than TOLERANCE percent is reported as
+# slower but does not fail the sweep: timings depend on the machine and load.
+# With or without a baseline, a run where opt took more faults than fifo did on
+# the same program, pages and frames is reported too, and fails the sweep.
+#
+# use: bench/sweep.sh [-f csv|json] [-o output] [-b baseline] [-s save-baseline]
+#
+# The sweep is set by NPAGES, NFRAMES, POLICIES and PROGRAMS (lists separated by
+# spaces), JOBS (default: the number of cores) and TOLERANCE (default 50).
+
+NPAGES=${NPAGES:-"100 200"}
+NFRAMES=${NFRAMES:-"2 10 25 50"}
+POLICIES=${POLICIES:-"fifo rand custom clock clockpro arc lirs 2q opt"}
+PROGRAMS=${PROGRAMS:-"alpha beta gamma delta"}
+JOBS=${JOBS:-$(nproc 2>/dev/null || echo 4)}
+TOLERANCE=${TOLERANCE:-50}
+VIRTMEM=${VIRTMEM:-./virtmem}
+HEADER="program,npages,nframes,policy,faults,reads,writes,seconds,faults_per_sec"
+
+# one run, printed as a CSV row: called back through xargs
+if [ "$1" = --run ]; then
+    program=$2 npages=$3 nframes=$4 policy=$5 disk=$6
+    $VIRTMEM -d $disk $npages $nframes $policy $program | awk -v key="$program,$npages,$nframes,$policy" '
+        /^Summary:/ { faults = $5; reads = $10; writes = $15 }
+        /^Timing:/  { secs = $2; rate = $5 }
+        END {
+            if (faults == "") exit 1
+            printf "%s,%d,%d,%d,%.6f,%.0f\n", key, faults, reads, writes, secs, rate
+        }' || echo "$0: $program $npages $nframes $policy failed" >&2
+    rm -f $disk
+    exit 0
+fi
+
+FORMAT=csv
+OUTPUT=
+BASELINE=
+SAVE=
+while getopts f:o:b:s: opt; do
+    case $opt in
+    f) FORMAT=$OPTARG ;;
+    o) OUTPUT=$OPTARG ;;
+    b) BASELINE=$OPTARG ;;
+    s) SAVE=$OPTARG ;;
+    *) echo "use: $0 [-f csv|json] [-o output] [-b baseline] [-s save-baseline]" >&2; exit 1 ;;
+    esac
+done
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/sweep.XXXXXX") || exit 1
+trap 'rm -rf $WORK' EXIT
+
+n=0
+for program in $PROGRAMS; do
+    for npages in $NPAGES; do
+        for nframes in $NFRAMES; do
+            [ $nframes -gt $npages ] && continue
+            for policy in $POLICIES; do
+                n=$((n + 1))
+                echo "$program $npages $nframes $policy $WORK/disk.$n"
+            done
+        done
+    done
+done | xargs -P $JOBS -L 1 $0 --run | sort -t, -k1,1 -k2,2n -k3,3n -k4,4 > $WORK/results.csv
+
+if [ -n "$SAVE" ]; then
+    { echo $HEADER; cat $WORK/results.csv; } > $SAVE
+fi
+
+report() {
+    if [ "$FORMAT" = json ]; then
+        awk -F, 'BEGIN { print "[" }
+            { printf "%s  {\"program\": \"%s\", \"npages\": %d, \"nframes\": %d, \"policy\": \"%s\", \"faults\": %d, \"reads\": %d, \"writes\": %d, \"seconds\": %s, \"faults_per_sec\": %s}",
+                  (NR > 1 ? ",\n" : ""), $1, $2, $3, $4, $5, $6, $7, $8, $9 }
+            END { print "\n]" }' $WORK/results.csv
+    else
+        echo $HEADER
+        cat $WORK/results.csv
+    fi
+}
+
+if [ -n "$OUTPUT" ]; then
+    report > $OUTPUT
+else
+    report
+fi
+
+status=0
+awk -F, '
+    $4 == "fifo" { fifo[$1 "," $2 "," $3] = $5 }
+    $4 == "opt"  { opt[$1 "," $2 "," $3] = $5 }
+    END {
+        for (key in opt) {
+            if ((key in fifo) && opt[key] > fifo[key]) {
+                printf "OPT WORSE  %s: opt %d faults, fifo %d\n", key, opt[key], fifo[key]
+                worse++
+            }
+        }
+        exit worse > 0
+    }' $WORK/results.csv >&2 || status=1
+
+if [ -n "$BASELINE" ]; then
+    awk -F, -v tolerance=$TOLERANCE '
+        FNR == 1 && /^program,/ { next }
+        NR == FNR { key = $1 "," $2 "," $3 "," $4; faults[key] = $5; reads[key] = $6; writes[key] = $7; rate[key] = $9; next }
+        {
+            key = $1 "," $2 "," $3 "," $4
+            if (!(key in faults))
+                next
+            if ($5 > faults[key] || $6 > reads[key] || $7 > writes[key]) {
+                printf "REGRESSION %s: faults %d -> %d, reads %d -> %d, writes %d -> %d\n",
+                       key, faults[key], $5, reads[key], $6, writes[key], $7
+                regressions++
+            }
+            if (rate[key] > 0 && $9 < rate[key] * (1 - tolerance / 100))
+                printf "slower     %s: %d -> %d faults/sec\n", key, rate[key], $9
+        }
+        END { exit regressions > 0 }' $BASELINE $WORK/results.csv >&2 || status=1
+fi
+exit $status
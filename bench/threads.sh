@@ -0,0 +1,39 @@
+#!/bin/sh
+# Measure fault handling with several threads faulting at once: the parallel
+# variant of each program (virtmem -T) on 1 to N threads, on both page table
+# backends. Speedup is the faults/sec against one thread. Only writes to resident
+# read-only pages are handled without vm_lock; misses take it for the policy and
+# the frame, and let it go while they wait for the disk. Threads can only run
+# faults side by side with a CPU each, so the CPU count is printed first: on one
+# CPU expect no speedup at all.
+#
+# use: bench/threads.sh [npages] [nframes] [policy]
+#
+# THREADS sets the thread counts (default "1 2 4 8").
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+POLICY=${3:-fifo}
+THREADS=${THREADS:-"1 2 4 8"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/threads.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+echo "CPUs: $(nproc)"
+printf "%-8s %-8s %8s %12s %12s %14s %8s %8s\n" program backend threads faults seconds faults/sec speedup waits
+for program in alpha beta gamma delta; do
+    for backend in sigsegv uffd; do
+        base=
+        for threads in $THREADS; do
+            line=$($VIRTMEM -b $backend -d $DISK -T $threads $NPAGES $NFRAMES $POLICY $program | awk '
+                /^Summary:/ { faults = $5 }
+                /^Timing:/  { secs = $2; rate = $5 }
+                /^Threads:/ { waits = $10 }
+                END { printf "%d %.6f %.0f %d\n", faults, secs, rate, waits }')
+            set -- $line
+            [ -z "$base" ] && base=$3
+            printf "%-8s %-8s %8d %12d %12.6f %14.0f %7.2fx %8d\n" $program $backend $threads $1 $2 $3 \
+                $(awk -v r=$3 -v b=$base 'BEGIN { printf "%f", (b > 0 ? r / b : 0) }') $4
+        done
+    done
+done
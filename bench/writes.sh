@@ -0,0 +1,40 @@
+#!/bin/sh
+# Measure write intent: faults, disk I/O and run time with the access type taken
+# from the fault, so that a write miss maps its page writable at once, and with
+# it ignored (virtmem -W), so that the write faults again on the page just mapped
+# read-only. Disk reads and writes should not change; faults and time should fall.
+#
+# use: bench/writes.sh [npages] [nframes]
+#
+# WORKLOADS sets the runs as policy:program pairs (default "fifo:alpha fifo:beta
+# fifo:gamma fifo:delta clock:beta"), BACKENDS the fault backends (default
+# "sigsegv uffd").
+
+NPAGES=${1:-1000}
+NFRAMES=${2:-100}
+WORKLOADS=${WORKLOADS:-"fifo:alpha fifo:beta fifo:gamma fifo:delta clock:beta"}
+BACKENDS=${BACKENDS:-"sigsegv uffd"}
+VIRTMEM=${VIRTMEM:-./virtmem}
+DISK=$(mktemp "${TMPDIR:-/tmp}/writes.XXXXXX") || exit 1
+trap 'rm -f $DISK' EXIT
+
+printf "%-8s %-8s %-8s %-7s %8s %8s %8s %10s %12s\n" \
+    backend policy program intent faults reads writes seconds faults/sec
+for backend in $BACKENDS; do
+    for workload in $WORKLOADS; do
+        policy=${workload%%:*}
+        program=${workload#*:}
+        for intent in on off; do
+            options=
+            [ $intent = off ] && options=-W
+            $VIRTMEM -b $backend $options -d $DISK $NPAGES $NFRAMES $policy $program | awk -v backend=$backend -v policy=$policy -v program=$program -v intent=$intent '
+                /^Summary:/ { faults = $5; reads = $10; writes = $15 }
+                /^Timing:/  { secs = $2; rate = $5 }
+                END {
+                    if (secs == "") { printf "%-8s %-8s %-8s %-7s failed\n", backend, policy, program, intent; exit }
+                    printf "%-8s %-8s %-8s %-7s %8d %8d %8d %10.6f %12.0f\n", backend, policy, program, intent,
+                           faults, reads, writes, secs, rate
+                }'
+        done
+    done
+done
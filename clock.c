@@ -0,0 +1,351 @@
+#include "clock.h"
+
+#include <stdlib.h>
+
+/*
+CLOCK sweeps a hand over the frames: a frame whose reference bit is set gets a
+second chance (the bit is cleared), the first frame found unreferenced is evicted.
+
+CLOCK-Pro (Jiang, Chen, Zhang, USENIX 2005) keeps resident hot pages, resident
+cold pages and non-resident cold pages still in their test period on one circular
+list, swept by three hands. A cold page referenced during its test period is
+promoted to hot; a miss on a page still in its test period grows the share of
+memory given to cold pages, and a test period expiring unused shrinks it.
+*/
+
+#define PAGE_NONE 0
+#define PAGE_HOT 1
+#define PAGE_COLD 2
+#define PAGE_TEST 3 // non-resident cold page in its test period
+
+struct clock
+{
+    struct frame_table *ft;
+    clock_unreference_t unreference;
+    void *arg;
+    int nframes; // frames it may hold
+    int hand;
+
+    // CLOCK-Pro state, indexed by page
+    int pro;
+    unsigned char *type;
+    int *next;
+    int *prev;
+    int hand_hot;
+    int hand_cold;
+    int hand_test;
+    int count_hot;
+    int count_cold;
+    int count_test;
+    int cold_target;
+    int promote; // page that missed while in its test period
+    int victim;
+};
+
+struct clock *clock_create(struct frame_table *ft, int npages, int nframes, int pro, clock_unreference_t unreference, void *arg)
+{
+    struct clock *c;
+    int i;
+
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        return 0;
+
+    c->ft = ft;
+    c->unreference = unreference;
+    c->arg = arg;
+    c->nframes = nframes;
+    c->pro = pro;
+
+    if (pro)
+    {
+        c->type = malloc(npages);
+        c->next = malloc(sizeof(int) * npages);
+        c->prev = malloc(sizeof(int) * npages);
+        if (!c->type || !c->next || !c->prev)
+        {
+            clock_delete(c);
+            return 0;
+        }
+
+        for (i = 0; i < npages; i++)
+            c->type[i] = PAGE_NONE;
+
+        c->hand_hot = c->hand_cold = c->hand_test = -1;
+        // at least one page stays cold, and one may be hot unless there is a single frame
+        c->cold_target = c->nframes > 1 ? c->nframes - 1 : 1;
+        c->promote = -1;
+    }
+
+    return c;
+}
+
+void clock_delete(struct clock *c)
+{
+    free(c->type);
+    free(c->next);
+    free(c->prev);
+    free(c);
+}
+
+static int referenced(struct clock *c, int frame)
+{
+    return frame_table_info(c->ft, frame)->flags & FRAME_REFERENCED;
+}
+
+static int plain_choose_victim(struct clock *c)
+{
+    int nframes = frame_table_nframes(c->ft);
+
+    // at most two sweeps: the first may only clear reference bits
+    for (int i = 0; i < 2 * nframes + 1; i++)
+    {
+        int frame = c->hand;
+        struct frame_info *fi = frame_table_info(c->ft, frame);
+
+        c->hand = (c->hand + 1) % nframes;
+
+        if (fi->pins)
+            continue;
+
+        if (fi->flags & FRAME_REFERENCED)
+        {
+            c->unreference(c->arg, frame);
+            continue;
+        }
+
+        return frame;
+    }
+
+    return -1;
+}
+
+// insert "page" just behind the hot hand, i.e. at the head of the list
+static void list_add(struct clock *c, int page)
+{
+    if (c->hand_hot < 0)
+    {
+        c->next[page] = c->prev[page] = page;
+        c->hand_hot = c->hand_cold = c->hand_test = page;
+        return;
+    }
+
+    int after = c->prev[c->hand_hot];
+
+    c->next[after] = page;
+    c->prev[page] = after;
+    c->next[page] = c->hand_hot;
+    c->prev[c->hand_hot] = page;
+
+    if (c->hand_cold == c->hand_hot)
+        c->hand_cold = c->prev[c->hand_cold];
+}
+
+static void list_del(struct clock *c, int page)
+{
+    if (c->next[page] == page)
+    {
+        c->hand_hot = c->hand_cold = c->hand_test = -1;
+    }
+    else
+    {
+        if (c->hand_hot == page)
+            c->hand_hot = c->prev[page];
+        if (c->hand_cold == page)
+            c->hand_cold = c->prev[page];
+        if (c->hand_test == page)
+            c->hand_test = c->prev[page];
+
+        c->next[c->prev[page]] = c->next[page];
+        c->prev[c->next[page]] = c->prev[page];
+    }
+
+    c->type[page] = PAGE_NONE;
+}
+
+// bound on a hand's steps: two sweeps of the list, the first may only clear reference bits
+static int list_steps(struct clock *c)
+{
+    return 2 * (c->count_hot + c->count_cold + c->count_test) + 1;
+}
+
+// look at the page under the cold hand, then move the hand past it
+static void step_hand_cold(struct clock *c, int may_evict)
+{
+    int page = c->hand_cold;
+
+    if (page < 0)
+        return;
+
+    if (c->type[page] == PAGE_COLD)
+    {
+        int frame = frame_table_lookup(c->ft, page);
+        struct frame_info *fi = frame_table_info(c->ft, frame);
+
+        if (fi->flags & FRAME_REFERENCED)
+        {
+            c->unreference(c->arg, frame);
+            c->type[page] = PAGE_HOT;
+            c->count_cold--;
+            c->count_hot++;
+        }
+        else if (may_evict && !fi->pins)
+        {
+            c->type[page] = PAGE_TEST;
+            c->count_cold--;
+            c->count_test++;
+            c->victim = frame;
+        }
+    }
+
+    c->hand_cold = c->next[c->hand_cold];
+}
+
+// end the test period of the page under the test hand
+static void run_hand_test(struct clock *c)
+{
+    // the test hand never passes the cold hand: push it one page ahead
+    if (c->hand_test == c->hand_cold)
+        step_hand_cold(c, 0);
+
+    if (c->hand_test < 0)
+        return;
+
+    int page = c->hand_test;
+
+    if (c->type[page] == PAGE_TEST)
+    {
+        list_del(c, page);
+        c->count_test--;
+        if (c->cold_target > 1)
+            c->cold_target--;
+    }
+
+    if (c->hand_test >= 0)
+        c->hand_test = c->next[c->hand_test];
+}
+
+// demote an unreferenced hot page, so hot pages fit beside the cold target
+static void run_hand_hot(struct clock *c)
+{
+    if (c->hand_hot == c->hand_test)
+        run_hand_test(c);
+
+    if (c->hand_hot < 0)
+        return;
+
+    int page = c->hand_hot;
+
+    if (c->type[page] == PAGE_HOT)
+    {
+        int frame = frame_table_lookup(c->ft, page);
+
+        if (referenced(c, frame))
+        {
+            c->unreference(c->arg, frame);
+        }
+        else
+        {
+            c->type[page] = PAGE_COLD;
+            c->count_hot--;
+            c->count_cold++;
+        }
+    }
+
+    c->hand_hot = c->next[c->hand_hot];
+}
+
+static void run_hand_cold(struct clock *c, int may_evict)
+{
+    step_hand_cold(c, may_evict);
+
+    for (int i = list_steps(c); c->nframes < c->count_test && i > 0; i--)
+        run_hand_test(c);
+
+    for (int i = list_steps(c); c->nframes - c->cold_target < c->count_hot && i > 0; i--)
+        run_hand_hot(c);
+}
+
+static int pro_choose_victim(struct clock *c)
+{
+    c->victim = -1;
+
+    // bounded in case every cold page is pinned
+    for (int i = 0; c->victim < 0 && i < 4 * (c->nframes + c->count_test) + 4; i++)
+        run_hand_cold(c, 1);
+
+    return c->victim;
+}
+
+void clock_on_miss(struct clock *c, int page)
+{
+    if (!c->pro)
+        return;
+
+    if (c->type[page] == PAGE_TEST)
+    {
+        // re-referenced during its test period: cold pages deserve more room
+        if (c->cold_target < c->nframes - 1)
+            c->cold_target++;
+        c->count_test--;
+        list_del(c, page);
+        c->promote = page;
+    }
+}
+
+int clock_choose_victim(struct clock *c)
+{
+    if (c->pro)
+        return pro_choose_victim(c);
+
+    return plain_choose_victim(c);
+}
+
+void clock_on_evict(struct clock *c, int page)
+{
+    if (!c->pro)
+        return;
+
+    if (c->type[page] == PAGE_HOT)
+    {
+        c->count_hot--;
+        list_del(c, page);
+    }
+    else if (c->type[page] == PAGE_COLD)
+    {
+        c->count_cold--;
+        list_del(c, page);
+    }
+}
+
+void clock_on_load(struct clock *c, int page, int frame)
+{
+    if (!c->pro)
+        return;
+
+    // the page may still be listed if it was loaded without missing first
+    if (c->type[page] != PAGE_NONE)
+    {
+        if (c->type[page] == PAGE_HOT)
+            c->count_hot--;
+        else if (c->type[page] == PAGE_COLD)
+            c->count_cold--;
+        else
+            c->count_test--;
+        list_del(c, page);
+    }
+
+    if (c->promote == page)
+    {
+        c->type[page] = PAGE_HOT;
+        c->count_hot++;
+    }
+    else
+    {
+        c->type[page] = PAGE_COLD;
+        c->count_cold++;
+    }
+    c->promote = -1;
+
+    list_add(c, page);
+}
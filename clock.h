@@ -0,0 +1,46 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "frame_table.h"
+
+/*
+CLOCK (second chance) and CLOCK-Pro page replacement.
+
+Both policies read reference bits from the frame table (FRAME_REFERENCED).
+They never touch the page table themselves: to clear a reference bit they call
+the "unreference" callback, which must clear the bit and arrange for the next
+access to the page to set it again.
+*/
+
+struct clock;
+
+typedef void (*clock_unreference_t)(void *arg, int frame);
+
+/* Create a CLOCK policy over the frames of "ft", or a CLOCK-Pro policy if "pro"
+ is nonzero. CLOCK-Pro also tracks recently evicted pages, so it needs "npages",
+ and divides "nframes", the frames it may hold, between hot and cold pages.
+ "arg" is passed through to the unreference callback. */
+
+struct clock *clock_create(struct frame_table *ft, int npages, int nframes, int pro, clock_unreference_t unreference, void *arg);
+
+/* Delete a policy. */
+
+void clock_delete(struct clock *c);
+
+/* Tell the policy that "page" missed, before a victim is chosen for it. */
+
+void clock_on_miss(struct clock *c, int page);
+
+/* Pick a resident frame to evict. Only called when there are no free frames. */
+
+int clock_choose_victim(struct clock *c);
+
+/* Tell the policy that "page" left memory. Victims it chose itself are already accounted for. */
+
+void clock_on_evict(struct clock *c, int page);
+
+/* Tell the policy that "page" was loaded into "frame". */
+
+void clock_on_load(struct clock *c, int page, int frame);
+
+#endif
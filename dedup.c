@@ -0,0 +1,190 @@
+#include "dedup.h"
+#include "page_ops.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct dedup
+{
+    int npages;
+    int nframes;
+    int page_size;
+    const char *physmem;
+
+    // the index: a hash table of frames, chained through "chain"
+    unsigned long long *hash; // contents hash of each indexed frame
+    unsigned char *indexed;
+    int *bucket; // first frame of each bucket, or -1
+    int *chain;  // next frame in the same bucket, or -1
+    int nbuckets; // a power of two
+
+    // pages merged onto each frame, in a doubly linked list
+    int *head;  // first page merged onto each frame, or -1
+    int *share; // frame each page is merged onto, or -1
+    int *next;
+    int *prev;
+
+    struct dedup_stats stats;
+};
+
+struct dedup *dedup_create(int npages, int nframes, int page_size, const char *physmem)
+{
+    struct dedup *d = calloc(1, sizeof(*d));
+
+    if (!d)
+        return 0;
+
+    d->npages = npages;
+    d->nframes = nframes;
+    d->page_size = page_size;
+    d->physmem = physmem;
+    for (d->nbuckets = 1; d->nbuckets < nframes; d->nbuckets *= 2)
+        ;
+
+    d->hash = malloc(nframes * sizeof(unsigned long long));
+    d->indexed = calloc(nframes, 1);
+    d->bucket = malloc(d->nbuckets * sizeof(int));
+    d->chain = malloc(nframes * sizeof(int));
+    d->head = malloc(nframes * sizeof(int));
+    d->share = malloc(npages * sizeof(int));
+    d->next = malloc(npages * sizeof(int));
+    d->prev = malloc(npages * sizeof(int));
+    if (!d->hash || !d->indexed || !d->bucket || !d->chain || !d->head || !d->share || !d->next || !d->prev)
+    {
+        dedup_delete(d);
+        return 0;
+    }
+
+    memset(d->bucket, -1, d->nbuckets * sizeof(int));
+    memset(d->head, -1, nframes * sizeof(int));
+    memset(d->share, -1, npages * sizeof(int));
+
+    return d;
+}
+
+void dedup_delete(struct dedup *d)
+{
+    free(d->hash);
+    free(d->indexed);
+    free(d->bucket);
+    free(d->chain);
+    free(d->head);
+    free(d->share);
+    free(d->next);
+    free(d->prev);
+    free(d);
+}
+
+static const char *frame_bytes(struct dedup *d, int frame)
+{
+    return &d->physmem[(size_t)frame * d->page_size];
+}
+
+// the indexed frame with hash "h" holding the same bytes as "data", or -1
+static int index_find(struct dedup *d, unsigned long long h, const char *data)
+{
+    for (int frame = d->bucket[h & (d->nbuckets - 1)]; frame >= 0; frame = d->chain[frame])
+    {
+        if (d->hash[frame] == h && page_equal(frame_bytes(d, frame), data, d->page_size))
+            return frame;
+    }
+    return -1;
+}
+
+int dedup_indexed(struct dedup *d, int frame)
+{
+    return d->indexed[frame];
+}
+
+int dedup_add(struct dedup *d, int frame)
+{
+    const char *data = frame_bytes(d, frame);
+    unsigned long long h = page_hash(data, d->page_size);
+    int match = index_find(d, h, data);
+
+    d->stats.scanned++;
+    if (match >= 0)
+        return match;
+
+    int *b = &d->bucket[h & (d->nbuckets - 1)];
+
+    d->hash[frame] = h;
+    d->indexed[frame] = 1;
+    d->chain[frame] = *b;
+    *b = frame;
+    return -1;
+}
+
+int dedup_lookup(struct dedup *d, const char *data)
+{
+    return index_find(d, page_hash(data, d->page_size), data);
+}
+
+void dedup_forget(struct dedup *d, int frame)
+{
+    if (!d->indexed[frame])
+        return;
+
+    int *p = &d->bucket[d->hash[frame] & (d->nbuckets - 1)];
+
+    while (*p != frame)
+        p = &d->chain[*p];
+    *p = d->chain[frame];
+    d->indexed[frame] = 0;
+}
+
+void dedup_merge(struct dedup *d, int page, int frame)
+{
+    if (d->head[frame] < 0)
+        d->stats.shared++;
+    else
+        d->prev[d->head[frame]] = page;
+
+    d->share[page] = frame;
+    d->next[page] = d->head[frame];
+    d->prev[page] = -1;
+    d->head[frame] = page;
+
+    d->stats.merged++;
+    if (++d->stats.sharing > d->stats.peak)
+        d->stats.peak = d->stats.sharing;
+}
+
+void dedup_unmerge(struct dedup *d, int page, int broken)
+{
+    int frame = d->share[page];
+
+    if (frame < 0)
+        return;
+
+    if (d->prev[page] >= 0)
+        d->next[d->prev[page]] = d->next[page];
+    else
+        d->head[frame] = d->next[page];
+    if (d->next[page] >= 0)
+        d->prev[d->next[page]] = d->prev[page];
+
+    if (d->head[frame] < 0)
+        d->stats.shared--;
+    d->share[page] = -1;
+    d->stats.sharing--;
+    if (broken)
+        d->stats.broken++;
+    else
+        d->stats.dropped++;
+}
+
+int dedup_frame(struct dedup *d, int page)
+{
+    return d->share[page];
+}
+
+int dedup_sharer(struct dedup *d, int frame)
+{
+    return d->head[frame];
+}
+
+struct dedup_stats dedup_get_stats(struct dedup *d)
+{
+    return d->stats;
+}
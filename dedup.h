@@ -0,0 +1,81 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/*
+Content-based page sharing, after Linux's KSM. Frames holding clean pages are
+hashed into an index, and a page whose frame turns out to hold the same bytes as
+a frame already indexed can be merged onto it: its own frame is freed, and it is
+mapped read-only to the indexed one. Any number of pages, from any address
+space, may share a frame this way; a write to one of them breaks its share.
+
+KSM only trusts pages whose checksum held still over a full scan, since it merges
+pages that are being written. Here only clean pages are indexed, which are
+write-protected, so their contents cannot change without a fault that takes
+them out again. A hash match is always confirmed by comparing the frames.
+
+The caller owns the frames, maps the pages and serializes every call; this
+module only keeps the index and the lists of pages merged onto each frame. The
+page owning a frame, the one in the frame table, is not on its list.
+*/
+
+struct dedup;
+
+struct dedup_stats
+{
+    long scanned;  // frames hashed
+    long merged;   // pages merged onto another frame
+    long broken;   // shares broken by a write to a merged page
+    long dropped;  // merged pages unmapped because their frame was evicted or written
+    int sharing;   // pages merged now, each of them a frame saved
+    int shared;    // frames with pages merged onto them now
+    int peak;      // most pages merged at once
+};
+
+/* Create the index for "nframes" frames of "page_size" bytes, at "physmem",
+ backing "npages" pages. Returns null on failure. */
+
+struct dedup *dedup_create(int npages, int nframes, int page_size, const char *physmem);
+
+/* Delete the index. */
+
+void dedup_delete(struct dedup *d);
+
+/* Return whether "frame" is in the index. */
+
+int dedup_indexed(struct dedup *d, int frame);
+
+/* Hash "frame" and return an indexed frame holding the same bytes, or add
+ "frame" to the index and return -1 if there is none. */
+
+int dedup_add(struct dedup *d, int frame);
+
+/* Return an indexed frame holding the same "page_size" bytes as "data", or -1. */
+
+int dedup_lookup(struct dedup *d, const char *data);
+
+/* Take "frame" out of the index, because its contents are about to change or its
+ page to leave. No page may be merged onto it any longer. */
+
+void dedup_forget(struct dedup *d, int frame);
+
+/* Record that "page" is merged onto the indexed "frame". */
+
+void dedup_merge(struct dedup *d, int page, int frame);
+
+/* Record that "page" is no longer merged: "broken" if a write to it is why. */
+
+void dedup_unmerge(struct dedup *d, int page, int broken);
+
+/* Return the frame "page" is merged onto, or -1. */
+
+int dedup_frame(struct dedup *d, int page);
+
+/* Return a page merged onto "frame", or -1 if there is none. */
+
+int dedup_sharer(struct dedup *d, int frame);
+
+/* Return the counters. */
+
+struct dedup_stats dedup_get_stats(struct dedup *d);
+
+#endif
@@ -3,7 +3,14 @@ Do not modify this file.
 Make all of your changes to main.c instead.
 */
 
+#define _GNU_SOURCE
+
+// linux/fs.h, pulled in by io_uring.h, defines a BLOCK_SIZE of its own
+#include <linux/io_uring.h>
+#undef BLOCK_SIZE
+
 #include "disk.h"
+#include "latency.h"
 
 #include <unistd.h>
 #include <stdio.h>
@@ -11,38 +18,513 @@ Make all of your changes to main.c instead.
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
-extern ssize_t pread(int __fd, void *__buf, size_t __nbytes, __off_t __offset);
-extern ssize_t pwrite(int __fd, const void *__buf, size_t __nbytes, __off_t __offset);
+#define DISK_RING_ENTRIES 64
+#define DISK_MAX_RUN 64
+#define DISK_THREADS 4
 
-struct disk
+// a run of requests with the same op on consecutive blocks, carried out as one
+// preadv or pwritev
+struct disk_io
+{
+    int op;
+    int block;
+    int count;
+    ssize_t result;
+    long start; // latency_now() at submission
+    struct disk_io *next;
+    struct disk_request *reqs[DISK_MAX_RUN];
+    struct iovec iov[DISK_MAX_RUN];
+    char *bounce[DISK_MAX_RUN]; // aligned copies of buffers the backend cannot take, or null
+};
+
+struct disk_ring
 {
     int fd;
+    void *sq_map;
+    void *cq_map;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned entries;
+};
+
+struct disk;
+
+// How a backend keeps the blocks. "transfer" moves "count" consecutive blocks
+// starting at "block" to or from the buffers of "iov", in the calling thread, and
+// returns the bytes moved or -errno; the synchronous calls, the thread pool and
+// DISK_ENGINE_SYNC go through it. Backends with "uring" set keep the blocks in
+// d->fd, where io_uring can reach them too.
+struct disk_backend_ops
+{
+    const char *name;
+    int uring;
+    int (*open)(struct disk *d, const char *filename);
+    int (*clone)(struct disk *c, struct disk *d); // share the blocks of "d"
+    void (*close)(struct disk *d);
+    ssize_t (*transfer)(struct disk *d, int op, int block, const struct iovec *iov, int count);
+};
+
+struct disk
+{
+    int fd; // -1 for the memory backends
     int block_size;
     int nblocks;
+
+    enum disk_backend backend;
+    const struct disk_backend_ops *ops;
+    int keep;      // open the file as it is rather than truncate it (disk_reopen)
+    int align;     // buffers must start at a multiple of this
+    char *map;     // DISK_BACKEND_MMAP and DISK_BACKEND_RAM: the blocks, shared with clones
+    int *map_refs; // handles sharing "map", this one included
+
+    struct disk_stats stats;
+    int write_end; // the block after the last write submitted, or -1
+
+    enum disk_engine engine;
+    int inflight; // merged runs submitted and not yet completed
+
+    // DISK_ENGINE_URING
+    struct disk_ring ring;
+
+    // DISK_ENGINE_THREADS: runs are queued on "todo" and moved to "finished"
+    pthread_t threads[DISK_THREADS];
+    int nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t completed;
+    struct disk_io *todo;
+    struct disk_io *todo_tail;
+    struct disk_io *finished;
+    int stopping;
+
+    // disk_submit's working space, allocated with the handle: room to sort a batch
+    // of "sorted_size" requests, and runs for a full ring on the "spare" list. A
+    // bigger batch grows "sorted"; runs beyond the pool are allocated and freed.
+    struct disk_request **sorted;
+    int sorted_size;
+    struct disk_io *pool;
+    struct disk_io *spare;
+};
+
+static int pool_setup(struct disk *d)
+{
+    d->sorted_size = DISK_RING_ENTRIES * DISK_MAX_RUN;
+    d->sorted = malloc(d->sorted_size * sizeof(*d->sorted));
+    d->pool = malloc(DISK_RING_ENTRIES * sizeof(*d->pool));
+    if (!d->sorted || !d->pool)
+    {
+        free(d->sorted);
+        free(d->pool);
+        return -1;
+    }
+
+    d->spare = 0;
+    for (int i = 0; i < DISK_RING_ENTRIES; i++)
+    {
+        d->pool[i].next = d->spare;
+        d->spare = &d->pool[i];
+    }
+    return 0;
+}
+
+static void pool_teardown(struct disk *d)
+{
+    free(d->sorted);
+    free(d->pool);
+}
+
+static struct disk_io *io_get(struct disk *d)
+{
+    struct disk_io *io = d->spare;
+
+    if (io)
+    {
+        d->spare = io->next;
+        return io;
+    }
+
+    io = malloc(sizeof(*io));
+    if (!io)
+    {
+        fprintf(stderr, "disk_submit: out of memory\n");
+        abort();
+    }
+    return io;
+}
+
+static void io_put(struct disk *d, struct disk_io *io)
+{
+    if (io >= d->pool && io < d->pool + DISK_RING_ENTRIES)
+    {
+        io->next = d->spare;
+        d->spare = io;
+    }
+    else
+    {
+        free(io);
+    }
+}
+
+static int ring_setup(struct disk_ring *r)
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    r->fd = syscall(__NR_io_uring_setup, DISK_RING_ENTRIES, &p);
+    if (r->fd < 0)
+        return -1;
+
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    r->sq_map = mmap(0, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->cq_map = mmap(0, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+
+    if (r->sq_map == MAP_FAILED || r->cq_map == MAP_FAILED || r->sqes == MAP_FAILED)
+    {
+        if (r->sq_map != MAP_FAILED)
+            munmap(r->sq_map, r->sq_map_size);
+        if (r->cq_map != MAP_FAILED)
+            munmap(r->cq_map, r->cq_map_size);
+        if (r->sqes != MAP_FAILED)
+            munmap(r->sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+        close(r->fd);
+        return -1;
+    }
+
+    r->sq_head = (unsigned *)((char *)r->sq_map + p.sq_off.head);
+    r->sq_tail = (unsigned *)((char *)r->sq_map + p.sq_off.tail);
+    r->sq_mask = (unsigned *)((char *)r->sq_map + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((char *)r->sq_map + p.sq_off.array);
+    r->cq_head = (unsigned *)((char *)r->cq_map + p.cq_off.head);
+    r->cq_tail = (unsigned *)((char *)r->cq_map + p.cq_off.tail);
+    r->cq_mask = (unsigned *)((char *)r->cq_map + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->cq_map + p.cq_off.cqes);
+    r->entries = p.sq_entries;
+
+    return 0;
+}
+
+static void ring_teardown(struct disk_ring *r)
+{
+    munmap(r->sqes, r->entries * sizeof(struct io_uring_sqe));
+    munmap(r->sq_map, r->sq_map_size);
+    munmap(r->cq_map, r->cq_map_size);
+    close(r->fd);
+}
+
+static void *disk_thread(void *arg)
+{
+    struct disk *d = arg;
+
+    pthread_mutex_lock(&d->lock);
+    for (;;)
+    {
+        while (!d->todo && !d->stopping)
+            pthread_cond_wait(&d->work, &d->lock);
+
+        if (!d->todo)
+            break;
+
+        struct disk_io *io = d->todo;
+        d->todo = io->next;
+        pthread_mutex_unlock(&d->lock);
+
+        io->result = d->ops->transfer(d, io->op, io->block, io->iov, io->count);
+
+        pthread_mutex_lock(&d->lock);
+        io->next = d->finished;
+        d->finished = io;
+        pthread_cond_signal(&d->completed);
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return 0;
+}
+
+static int threads_setup(struct disk *d)
+{
+    pthread_mutex_init(&d->lock, 0);
+    pthread_cond_init(&d->work, 0);
+    pthread_cond_init(&d->completed, 0);
+
+    for (d->nthreads = 0; d->nthreads < DISK_THREADS; d->nthreads++)
+    {
+        if (pthread_create(&d->threads[d->nthreads], 0, disk_thread, d) != 0)
+            break;
+    }
+
+    return d->nthreads > 0 ? 0 : -1;
+}
+
+static void threads_teardown(struct disk *d)
+{
+    pthread_mutex_lock(&d->lock);
+    d->stopping = 1;
+    pthread_cond_broadcast(&d->work);
+    pthread_mutex_unlock(&d->lock);
+
+    for (int i = 0; i < d->nthreads; i++)
+        pthread_join(d->threads[i], 0);
+
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->work);
+    pthread_cond_destroy(&d->completed);
+}
+
+/*
+Backends. DISK_BACKEND_FILE and DISK_BACKEND_DIRECT use one file, the second
+opened with O_DIRECT; DISK_BACKEND_MMAP maps it, and DISK_BACKEND_RAM keeps the
+blocks in anonymous memory with no file at all.
+*/
+
+// create the disk file, truncating it first so that every block reads as zeros,
+// or open it as an earlier run left it, only ever making it longer
+static int file_create(struct disk *d, const char *filename, int flags)
+{
+    off_t size = (off_t)d->nblocks * d->block_size;
+    struct stat st;
+
+    d->fd = open(filename, (d->keep ? 0 : O_CREAT | O_TRUNC) | O_RDWR | flags, 0777);
+    if (d->fd < 0)
+        return -1;
+
+    if (d->keep && fstat(d->fd, &st) == 0 && st.st_size >= size)
+        return 0;
+    if (ftruncate(d->fd, size) < 0)
+    {
+        close(d->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int file_open(struct disk *d, const char *filename)
+{
+    return file_create(d, filename, 0);
+}
+
+// O_DIRECT transfers need their buffers, offsets and lengths aligned; blocks are
+// multiples of BLOCK_SIZE, so only the buffers may not be
+static int direct_open(struct disk *d, const char *filename)
+{
+    d->align = BLOCK_SIZE;
+    return file_create(d, filename, O_DIRECT);
+}
+
+static int file_clone(struct disk *c, struct disk *d)
+{
+    c->fd = dup(d->fd);
+    return c->fd < 0 ? -1 : 0;
+}
+
+static void file_close(struct disk *d)
+{
+    close(d->fd);
+}
+
+static ssize_t file_transfer(struct disk *d, int op, int block, const struct iovec *iov, int count)
+{
+    off_t offset = (off_t)block * d->block_size;
+    ssize_t result = op == DISK_OP_READ ? preadv(d->fd, iov, count, offset) : pwritev(d->fd, iov, count, offset);
+
+    return result < 0 ? -errno : result;
+}
+
+static int mmap_open(struct disk *d, const char *filename)
+{
+    size_t size = (size_t)d->nblocks * d->block_size;
+
+    d->map_refs = malloc(sizeof(int));
+    if (!d->map_refs || file_create(d, filename, 0) < 0)
+    {
+        free(d->map_refs);
+        return -1;
+    }
+
+    d->map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, d->fd, 0);
+    close(d->fd);
+    d->fd = -1;
+    if (d->map == MAP_FAILED)
+    {
+        free(d->map_refs);
+        return -1;
+    }
+
+    *d->map_refs = 1;
+    return 0;
+}
+
+// the blocks start out as zeros, and are only given memory when written
+static int ram_open(struct disk *d, const char *filename)
+{
+    size_t size = (size_t)d->nblocks * d->block_size;
+
+    if (d->keep)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    d->map_refs = malloc(sizeof(int));
+    if (!d->map_refs)
+        return -1;
+
+    d->map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (d->map == MAP_FAILED)
+    {
+        free(d->map_refs);
+        return -1;
+    }
+
+    *d->map_refs = 1;
+    return 0;
+}
+
+static int memory_clone(struct disk *c, struct disk *d)
+{
+    c->map = d->map;
+    c->map_refs = d->map_refs;
+    ++*c->map_refs;
+    return 0;
+}
+
+// the last handle unmaps the blocks, writing a mapped file back first
+static void memory_close(struct disk *d)
+{
+    size_t size = (size_t)d->nblocks * d->block_size;
+
+    if (--*d->map_refs > 0)
+        return;
+
+    if (d->backend == DISK_BACKEND_MMAP)
+        msync(d->map, size, MS_SYNC);
+    munmap(d->map, size);
+    free(d->map_refs);
+}
+
+static ssize_t memory_transfer(struct disk *d, int op, int block, const struct iovec *iov, int count)
+{
+    char *start = d->map + (size_t)block * d->block_size;
+    char *p = start;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (op == DISK_OP_READ)
+            memcpy(iov[i].iov_base, p, iov[i].iov_len);
+        else
+            memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+
+    // start writing the blocks back to the file, without waiting for them
+    if (op == DISK_OP_WRITE && d->backend == DISK_BACKEND_MMAP && msync(start, p - start, MS_ASYNC) < 0)
+        return -errno;
+
+    return p - start;
+}
+
+static const struct disk_backend_ops backends[] = {
+    [DISK_BACKEND_FILE] = {"file", 1, file_open, file_clone, file_close, file_transfer},
+    [DISK_BACKEND_DIRECT] = {"direct", 1, direct_open, file_clone, file_close, file_transfer},
+    [DISK_BACKEND_MMAP] = {"mmap", 0, mmap_open, memory_clone, memory_close, memory_transfer},
+    [DISK_BACKEND_RAM] = {"ram", 0, ram_open, memory_clone, memory_close, memory_transfer},
 };
 
 struct disk *disk_open(const char *diskname, int nblocks)
+{
+    return disk_open_with_engine(diskname, nblocks, DISK_ENGINE_AUTO);
+}
+
+// set up the engine for batched requests; "engine" is a wish, d->engine the outcome.
+// Blocks in memory are copied faster in place than handed to another thread.
+static int engine_setup(struct disk *d, enum disk_engine engine)
+{
+    if (engine == DISK_ENGINE_AUTO && !d->ops->uring)
+        engine = DISK_ENGINE_SYNC;
+
+    if (engine == DISK_ENGINE_SYNC)
+        d->engine = DISK_ENGINE_SYNC;
+    else if (engine != DISK_ENGINE_THREADS && d->ops->uring && ring_setup(&d->ring) == 0)
+        d->engine = DISK_ENGINE_URING;
+    else if (engine != DISK_ENGINE_URING && threads_setup(d) == 0)
+        d->engine = DISK_ENGINE_THREADS;
+    else
+    {
+        if (!d->ops->uring)
+            errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct disk *disk_open_with_engine(const char *diskname, int nblocks, enum disk_engine engine)
+{
+    return disk_open_with_block_size(diskname, nblocks, BLOCK_SIZE, engine);
+}
+
+struct disk *disk_open_with_block_size(const char *diskname, int nblocks, int block_size, enum disk_engine engine)
+{
+    return disk_open_with_backend(diskname, nblocks, block_size, engine, DISK_BACKEND_FILE);
+}
+
+static struct disk *disk_create(const char *diskname, int nblocks, int block_size, enum disk_engine engine, enum disk_backend backend, int keep)
 {
     struct disk *d;
 
-    d = malloc(sizeof(*d));
+    if (block_size < BLOCK_SIZE || block_size % BLOCK_SIZE || backend < DISK_BACKEND_FILE || backend > DISK_BACKEND_RAM)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+
+    d = calloc(1, sizeof(*d));
     if (!d)
         return 0;
 
-    d->fd = open(diskname, O_CREAT | O_RDWR, 0777);
-    if (d->fd < 0)
+    d->fd = -1;
+    d->block_size = block_size;
+    d->nblocks = nblocks;
+    d->backend = backend;
+    d->ops = &backends[backend];
+    d->keep = keep;
+    d->align = 1;
+    d->write_end = -1;
+
+    if (pool_setup(d) < 0)
     {
         free(d);
         return 0;
     }
 
-    d->block_size = BLOCK_SIZE;
-    d->nblocks = nblocks;
+    if (d->ops->open(d, diskname) < 0)
+    {
+        pool_teardown(d);
+        free(d);
+        return 0;
+    }
 
-    if (ftruncate(d->fd, d->nblocks * d->block_size) < 0)
+    if (engine_setup(d, engine) < 0)
     {
-        close(d->fd);
+        d->ops->close(d);
+        pool_teardown(d);
         free(d);
         return 0;
     }
@@ -50,6 +532,123 @@ struct disk *disk_open(const char *diskname, int nblocks)
     return d;
 }
 
+struct disk *disk_open_with_backend(const char *diskname, int nblocks, int block_size, enum disk_engine engine, enum disk_backend backend)
+{
+    return disk_create(diskname, nblocks, block_size, engine, backend, 0);
+}
+
+struct disk *disk_reopen(const char *diskname, int nblocks, int block_size, enum disk_engine engine, enum disk_backend backend)
+{
+    return disk_create(diskname, nblocks, block_size, engine, backend, 1);
+}
+
+struct disk *disk_clone(struct disk *d)
+{
+    struct disk *c = calloc(1, sizeof(*c));
+
+    if (!c)
+        return 0;
+
+    c->fd = -1;
+    c->block_size = d->block_size;
+    c->nblocks = d->nblocks;
+    c->backend = d->backend;
+    c->ops = d->ops;
+    c->align = d->align;
+    c->write_end = -1;
+
+    if (pool_setup(c) < 0)
+    {
+        free(c);
+        return 0;
+    }
+
+    if (c->ops->clone(c, d) < 0)
+    {
+        pool_teardown(c);
+        free(c);
+        return 0;
+    }
+
+    if (engine_setup(c, d->engine) < 0)
+    {
+        c->ops->close(c);
+        pool_teardown(c);
+        free(c);
+        return 0;
+    }
+
+    return c;
+}
+
+enum disk_engine disk_get_engine(struct disk *d)
+{
+    return d->engine;
+}
+
+int disk_block_size(struct disk *d)
+{
+    return d->block_size;
+}
+
+enum disk_backend disk_get_backend(struct disk *d)
+{
+    return d->backend;
+}
+
+const char *disk_engine_name(enum disk_engine engine)
+{
+    switch (engine)
+    {
+    case DISK_ENGINE_URING:
+        return "io_uring";
+    case DISK_ENGINE_THREADS:
+        return "threaded";
+    case DISK_ENGINE_SYNC:
+        return "synchronous";
+    default:
+        return "auto";
+    }
+}
+
+const char *disk_backend_name(enum disk_backend backend)
+{
+    return backend >= DISK_BACKEND_FILE && backend <= DISK_BACKEND_RAM ? backends[backend].name : "unknown";
+}
+
+// an aligned buffer for one block, for a transfer whose own buffer is not aligned
+static char *bounce_alloc(struct disk *d)
+{
+    void *p;
+
+    if (posix_memalign(&p, d->align, d->block_size) != 0)
+    {
+        fprintf(stderr, "disk: out of memory\n");
+        abort();
+    }
+    return p;
+}
+
+// move one block in the calling thread, through an aligned copy if need be
+static ssize_t transfer_block(struct disk *d, int op, int block, char *data)
+{
+    struct iovec iov = {data, d->block_size};
+    ssize_t result;
+
+    if ((unsigned long)data % d->align == 0)
+        return d->ops->transfer(d, op, block, &iov, 1);
+
+    iov.iov_base = bounce_alloc(d);
+    if (op == DISK_OP_WRITE)
+        memcpy(iov.iov_base, data, d->block_size);
+    result = d->ops->transfer(d, op, block, &iov, 1);
+    if (op == DISK_OP_READ)
+        memcpy(data, iov.iov_base, d->block_size);
+    free(iov.iov_base);
+
+    return result;
+}
+
 void disk_write(struct disk *d, int block, const char *data)
 {
     if (block < 0 || block >= d->nblocks)
@@ -58,10 +657,17 @@ void disk_write(struct disk *d, int block, const char *data)
         abort();
     }
 
-    int actual = pwrite(d->fd, data, d->block_size, block * d->block_size);
+    d->stats.writes++;
+    d->stats.write_ops++;
+    d->stats.sequential_writes += block == d->write_end;
+    d->write_end = block + 1;
+
+    long start = latency_now();
+    ssize_t actual = transfer_block(d, DISK_OP_WRITE, block, (char *)data);
+    latency_record(LATENCY_DISK_WRITE, start);
     if (actual != d->block_size)
     {
-        fprintf(stderr, "disk_write: failed to write block #%d: %s\n", block, strerror(errno));
+        fprintf(stderr, "disk_write: failed to write block #%d: %s\n", block, actual < 0 ? strerror(-actual) : "short transfer");
         abort();
     }
 }
@@ -74,14 +680,299 @@ void disk_read(struct disk *d, int block, char *data)
         abort();
     }
 
-    int actual = pread(d->fd, data, d->block_size, block * d->block_size);
+    d->stats.reads++;
+    d->stats.read_ops++;
+
+    long start = latency_now();
+    ssize_t actual = transfer_block(d, DISK_OP_READ, block, data);
+    latency_record(LATENCY_DISK_READ, start);
     if (actual != d->block_size)
     {
-        fprintf(stderr, "disk_read: failed to read block #%d: %s\n", block, strerror(errno));
+        fprintf(stderr, "disk_read: failed to read block #%d: %s\n", block, actual < 0 ? strerror(-actual) : "short transfer");
         abort();
     }
 }
 
+// finish a merged run: check the transfer and call back every request in it
+static int complete_io(struct disk *d, struct disk_io *io)
+{
+    int count = io->count;
+
+    if (io->result != (ssize_t)count * d->block_size)
+    {
+        fprintf(stderr, "disk_%s: failed to transfer blocks #%d-%d: %s\n", io->op == DISK_OP_READ ? "read" : "write",
+                io->block, io->block + count - 1, io->result < 0 ? strerror(-io->result) : "short transfer");
+        abort();
+    }
+
+    latency_record(io->op == DISK_OP_READ ? LATENCY_DISK_READ : LATENCY_DISK_WRITE, io->start);
+
+    d->inflight--;
+    for (int i = 0; i < count; i++)
+    {
+        if (io->bounce[i])
+        {
+            if (io->op == DISK_OP_READ)
+                memcpy(io->reqs[i]->data, io->bounce[i], d->block_size);
+            free(io->bounce[i]);
+        }
+        if (io->reqs[i]->done)
+            io->reqs[i]->done(io->reqs[i]);
+    }
+    io_put(d, io);
+
+    return count;
+}
+
+static int ring_enter(struct disk_ring *r, unsigned to_submit, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+
+    do
+    {
+        ret = syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret;
+}
+
+static int ring_reap(struct disk *d)
+{
+    struct disk_ring *r = &d->ring;
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    int completed = 0;
+
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        struct disk_io *io = (struct disk_io *)(unsigned long)cqe->user_data;
+
+        io->result = cqe->res;
+        head++;
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+        completed += complete_io(d, io);
+    }
+
+    return completed;
+}
+
+static void ring_submit(struct disk *d, struct disk_io *io)
+{
+    struct disk_ring *r = &d->ring;
+    unsigned tail = *r->sq_tail;
+
+    // the ring is sized for the common case; make room when a batch overflows it
+    while (d->inflight >= r->entries)
+    {
+        ring_enter(r, 0, 1);
+        ring_reap(d);
+    }
+
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = io->op == DISK_OP_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = d->fd;
+    sqe->addr = (unsigned long)io->iov;
+    sqe->len = io->count;
+    sqe->off = (unsigned long long)io->block * d->block_size;
+    sqe->user_data = (unsigned long)io;
+
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    d->inflight++;
+
+    if (ring_enter(r, 1, 0) < 0)
+    {
+        fprintf(stderr, "disk_submit: io_uring_enter failed: %s\n", strerror(errno));
+        abort();
+    }
+}
+
+static void threads_submit(struct disk *d, struct disk_io *io)
+{
+    pthread_mutex_lock(&d->lock);
+    io->next = 0;
+    if (d->todo)
+        d->todo_tail->next = io;
+    else
+        d->todo = io;
+    d->todo_tail = io;
+    d->inflight++;
+    pthread_cond_signal(&d->work);
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int threads_reap(struct disk *d, int wait)
+{
+    int completed = 0;
+
+    pthread_mutex_lock(&d->lock);
+    while (wait && !d->finished && d->inflight > 0)
+        pthread_cond_wait(&d->completed, &d->lock);
+    struct disk_io *io = d->finished;
+    d->finished = 0;
+    pthread_mutex_unlock(&d->lock);
+
+    while (io)
+    {
+        struct disk_io *next = io->next;
+        completed += complete_io(d, io);
+        io = next;
+    }
+
+    return completed;
+}
+
+// DISK_ENGINE_SYNC: the run is carried out on submission and completed by the next poll
+static void sync_submit(struct disk *d, struct disk_io *io)
+{
+    io->result = d->ops->transfer(d, io->op, io->block, io->iov, io->count);
+    io->next = d->finished;
+    d->finished = io;
+    d->inflight++;
+}
+
+static int sync_reap(struct disk *d)
+{
+    struct disk_io *io = d->finished;
+    int completed = 0;
+
+    d->finished = 0;
+    while (io)
+    {
+        struct disk_io *next = io->next;
+        completed += complete_io(d, io);
+        io = next;
+    }
+
+    return completed;
+}
+
+static int compare_requests(const void *a, const void *b)
+{
+    const struct disk_request *x = *(struct disk_request *const *)a;
+    const struct disk_request *y = *(struct disk_request *const *)b;
+
+    if (x->op != y->op)
+        return x->op - y->op;
+    return x->block - y->block;
+}
+
+void disk_submit(struct disk *d, struct disk_request *reqs, int n)
+{
+    if (n <= 0)
+        return;
+
+    if (n > d->sorted_size)
+    {
+        struct disk_request **sorted = realloc(d->sorted, n * sizeof(*sorted));
+
+        if (!sorted)
+        {
+            fprintf(stderr, "disk_submit: out of memory\n");
+            abort();
+        }
+        d->sorted = sorted;
+        d->sorted_size = n;
+    }
+
+    struct disk_request **sorted = d->sorted;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (reqs[i].block < 0 || reqs[i].block >= d->nblocks)
+        {
+            fprintf(stderr, "disk_submit: invalid block #%d\n", reqs[i].block);
+            abort();
+        }
+        sorted[i] = &reqs[i];
+    }
+    qsort(sorted, n, sizeof(*sorted), compare_requests);
+
+    for (int i = 0; i < n;)
+    {
+        struct disk_io *io = io_get(d);
+
+        io->op = sorted[i]->op;
+        io->block = sorted[i]->block;
+        io->count = 0;
+
+        while (i < n && io->count < DISK_MAX_RUN && sorted[i]->op == io->op && sorted[i]->block == io->block + io->count)
+        {
+            char *data = sorted[i]->data;
+
+            io->bounce[io->count] = 0;
+            if ((unsigned long)data % d->align)
+            {
+                data = io->bounce[io->count] = bounce_alloc(d);
+                if (io->op == DISK_OP_WRITE)
+                    memcpy(data, sorted[i]->data, d->block_size);
+            }
+
+            io->reqs[io->count] = sorted[i];
+            io->iov[io->count].iov_base = data;
+            io->iov[io->count].iov_len = d->block_size;
+            io->count++;
+            i++;
+        }
+
+        if (io->op == DISK_OP_READ)
+        {
+            d->stats.reads += io->count;
+            d->stats.read_ops++;
+        }
+        else
+        {
+            d->stats.writes += io->count;
+            d->stats.write_ops++;
+            d->stats.sequential_writes += io->block == d->write_end;
+            d->write_end = io->block + io->count;
+        }
+
+        io->start = latency_now();
+        if (d->engine == DISK_ENGINE_URING)
+            ring_submit(d, io);
+        else if (d->engine == DISK_ENGINE_THREADS)
+            threads_submit(d, io);
+        else
+            sync_submit(d, io);
+    }
+}
+
+int disk_poll(struct disk *d, int wait)
+{
+    if (d->engine == DISK_ENGINE_THREADS)
+        return threads_reap(d, wait);
+    if (d->engine == DISK_ENGINE_SYNC)
+        return sync_reap(d);
+
+    int completed = ring_reap(d);
+
+    if (!completed && wait && d->inflight > 0)
+    {
+        ring_enter(&d->ring, 0, 1);
+        completed = ring_reap(d);
+    }
+
+    return completed;
+}
+
+void disk_wait(struct disk *d)
+{
+    while (d->inflight > 0)
+        disk_poll(d, 1);
+}
+
+struct disk_stats disk_get_stats(struct disk *d)
+{
+    return d->stats;
+}
+
 int disk_nblocks(struct disk *d)
 {
     return d->nblocks;
@@ -89,6 +980,14 @@ int disk_nblocks(struct disk *d)
 
 void disk_close(struct disk *d)
 {
-    close(d->fd);
+    disk_wait(d);
+
+    if (d->engine == DISK_ENGINE_URING)
+        ring_teardown(&d->ring);
+    else if (d->engine == DISK_ENGINE_THREADS)
+        threads_teardown(d);
+
+    d->ops->close(d);
+    pool_teardown(d);
     free(d);
 }
\ No newline at end of file
@@ -8,15 +8,159 @@ Make all of your changes to main.c instead.
 
 #define BLOCK_SIZE 4096
 
+struct disk;
+
+/*
+How batched requests are carried out.
+DISK_ENGINE_URING submits them to an io_uring.
+DISK_ENGINE_THREADS hands them to a small pool of threads doing preadv/pwritev.
+DISK_ENGINE_SYNC carries them out in the calling thread, during disk_submit.
+DISK_ENGINE_AUTO uses io_uring when the kernel allows it, and threads otherwise;
+with a backend that keeps the blocks in memory, it is DISK_ENGINE_SYNC.
+*/
+
+enum disk_engine
+{
+    DISK_ENGINE_AUTO,
+    DISK_ENGINE_URING,
+    DISK_ENGINE_THREADS,
+    DISK_ENGINE_SYNC
+};
+
+/*
+Where the blocks are kept.
+DISK_BACKEND_FILE is a file read and written through the page cache.
+DISK_BACKEND_DIRECT is the same file opened with O_DIRECT, so that every transfer
+goes to the device; buffers not aligned to BLOCK_SIZE are copied through aligned
+ones. Not every file system supports it.
+DISK_BACKEND_MMAP maps the file and copies blocks in and out with memcpy, starting
+an msync of every write and waiting for all of them on close.
+DISK_BACKEND_RAM keeps the blocks in memory, and ignores the file name.
+The memory backends cannot use io_uring.
+*/
+
+enum disk_backend
+{
+    DISK_BACKEND_FILE,
+    DISK_BACKEND_DIRECT,
+    DISK_BACKEND_MMAP,
+    DISK_BACKEND_RAM
+};
+
+#define DISK_OP_READ 0
+#define DISK_OP_WRITE 1
+
+/*
+One block read or write for disk_submit. "done" (which may be null) is called
+from disk_poll or disk_wait once the block has been transferred, or from
+disk_submit when it has to make room for more; "arg" is left for the caller.
+The request must stay valid until then, and "done" must not submit to the same
+disk, whose working space disk_submit is still using.
+*/
+
+struct disk_request
+{
+    int op;    // DISK_OP_READ or DISK_OP_WRITE
+    int block;
+    char *data;
+    void (*done)(struct disk_request *r);
+    void *arg;
+};
+
+/*
+Counters kept by the disk: blocks transferred, and the system calls (or io_uring
+submissions) that carried them. Merged runs move several blocks in one operation.
+Sequential writes are the write operations that started at the block following
+the last one written through the same handle.
+*/
+
+struct disk_stats
+{
+    int reads;
+    int writes;
+    int read_ops;
+    int write_ops;
+    int sequential_writes;
+};
+
 /*
 Create a new virtual disk in the file "filename", with the given number of blocks.
+Any previous contents of the file are discarded: every block reads as zeros.
 Returns a pointer to a new disk object, or null on failure.
 */
 
 struct disk *disk_open(const char *filename, int blocks);
 
 /*
-Write exactly BLOCK_SIZE bytes to a given block on the virtual disk.
+Like disk_open, but choose how batched requests are carried out.
+Returns null if the engine cannot be set up.
+*/
+
+struct disk *disk_open_with_engine(const char *filename, int blocks, enum disk_engine engine);
+
+/*
+Like disk_open_with_engine, but with blocks of "block_size" bytes, a multiple of
+BLOCK_SIZE, so that each block holds a whole page of a larger page size and is
+moved in one transfer. Every read and write then moves "block_size" bytes.
+Returns null with errno set to EINVAL if the size is not a multiple.
+*/
+
+struct disk *disk_open_with_block_size(const char *filename, int blocks, int block_size, enum disk_engine engine);
+
+/*
+Like disk_open_with_block_size, but choose where the blocks are kept: the other
+open calls use DISK_BACKEND_FILE. Returns null with errno set if the backend
+cannot be set up, or cannot be used with the engine.
+*/
+
+struct disk *disk_open_with_backend(const char *filename, int blocks, int block_size, enum disk_engine engine, enum disk_backend backend);
+
+/*
+Like disk_open_with_backend, but open the disk an earlier run left in the file
+"filename", keeping its contents, so that a warm restart can read back the pages
+it wrote. The file must exist; if it holds fewer than "blocks" blocks, it is
+extended with zeros. DISK_BACKEND_RAM keeps nothing between runs and cannot be reopened.
+Returns null with errno set on failure.
+*/
+
+struct disk *disk_reopen(const char *filename, int blocks, int block_size, enum disk_engine engine, enum disk_backend backend);
+
+/*
+Open another handle on the same virtual disk, with its own engine and counters,
+so that another thread can submit requests without sharing the first handle's.
+The handle uses the same backend and blocks. Returns null on failure.
+*/
+
+struct disk *disk_clone(struct disk *d);
+
+/*
+Return the engine carrying out batched requests, never DISK_ENGINE_AUTO.
+*/
+
+enum disk_engine disk_get_engine(struct disk *d);
+
+/*
+Return where the blocks are kept.
+*/
+
+enum disk_backend disk_get_backend(struct disk *d);
+
+/*
+Return the name of an engine or a backend, for reports.
+*/
+
+const char *disk_engine_name(enum disk_engine engine);
+const char *disk_backend_name(enum disk_backend backend);
+
+/*
+Return the size of the blocks, in bytes: BLOCK_SIZE unless the disk was opened
+with disk_open_with_block_size.
+*/
+
+int disk_block_size(struct disk *d);
+
+/*
+Write exactly one block to a given block on the virtual disk.
 "d" must be a pointer to a virtual disk, "block" is the block number,
 and "data" is a pointer to the data to write.
 */
@@ -24,13 +168,42 @@ and "data" is a pointer to the data to write.
 void disk_write(struct disk *d, int block, const char *data);
 
 /*
-Read exactly BLOCK_SIZE bytes from a given block on the virtual disk.
+Read exactly one block from a given block on the virtual disk.
 "d" must be a pointer to a virtual disk, "block" is the block number,
 and "data" is a pointer to where the data will be placed.
 */
 
 void disk_read(struct disk *d, int block, char *data);
 
+/*
+Start "n" block reads and writes without waiting for them. Runs of requests
+with the same op on consecutive blocks are merged into a single preadv/pwritev.
+Requests on the same block must not be in flight at the same time, since they
+may complete in any order.
+*/
+
+void disk_submit(struct disk *d, struct disk_request *reqs, int n);
+
+/*
+Complete the requests that have finished, calling their "done" callbacks.
+If "wait" is set and requests are in flight, block until at least one finishes.
+Returns the number of requests completed.
+*/
+
+int disk_poll(struct disk *d, int wait);
+
+/*
+Complete every request in flight.
+*/
+
+void disk_wait(struct disk *d);
+
+/*
+Return the counters of the virtual disk.
+*/
+
+struct disk_stats disk_get_stats(struct disk *d);
+
 /*
 Return the number of blocks in the virtual disk.
 */
@@ -0,0 +1,137 @@
+#include "frame_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct frame_table
+{
+    int nframes;
+    int npages;
+    struct frame_info *info;
+    int *page_frame;  // page -> frame, or -1
+    int *free_stack;  // free frames, top at free_stack[nfree - 1]
+    int nfree;
+};
+
+struct frame_table *frame_table_create(int nframes, int npages)
+{
+    struct frame_table *ft;
+    int i;
+
+    ft = malloc(sizeof(*ft));
+    if (!ft)
+        return 0;
+
+    ft->nframes = nframes;
+    ft->npages = npages;
+    ft->info = malloc(sizeof(struct frame_info) * nframes);
+    ft->page_frame = malloc(sizeof(int) * npages);
+    ft->free_stack = malloc(sizeof(int) * nframes);
+
+    if (!ft->info || !ft->page_frame || !ft->free_stack)
+    {
+        frame_table_delete(ft);
+        return 0;
+    }
+
+    for (i = 0; i < nframes; i++)
+    {
+        ft->info[i].page = -1;
+        ft->info[i].age = 0;
+        ft->info[i].flags = 0;
+        ft->info[i].pins = 0;
+        // push in reverse so that frames are handed out in ascending order
+        ft->free_stack[i] = nframes - 1 - i;
+    }
+    ft->nfree = nframes;
+
+    for (i = 0; i < npages; i++)
+        ft->page_frame[i] = -1;
+
+    return ft;
+}
+
+void frame_table_delete(struct frame_table *ft)
+{
+    free(ft->info);
+    free(ft->page_frame);
+    free(ft->free_stack);
+    free(ft);
+}
+
+int frame_table_alloc(struct frame_table *ft)
+{
+    if (ft->nfree == 0)
+        return -1;
+
+    return ft->free_stack[--ft->nfree];
+}
+
+void frame_table_map(struct frame_table *ft, int frame, int page)
+{
+    if (frame < 0 || frame >= ft->nframes || page < 0 || page >= ft->npages)
+    {
+        fprintf(stderr, "frame_table_map: illegal frame #%d or page #%d\n", frame, page);
+        abort();
+    }
+
+    if (ft->info[frame].page >= 0)
+        ft->page_frame[ft->info[frame].page] = -1;
+
+    ft->info[frame].page = page;
+    ft->info[frame].flags = 0;
+    ft->info[frame].pins = 0;
+    ft->page_frame[page] = frame;
+}
+
+void frame_table_unmap(struct frame_table *ft, int frame)
+{
+    struct frame_info *fi = &ft->info[frame];
+
+    if (fi->page >= 0)
+        ft->page_frame[fi->page] = -1;
+
+    fi->page = -1;
+    fi->flags = 0;
+    fi->pins = 0;
+}
+
+void frame_table_free(struct frame_table *ft, int frame)
+{
+    if (frame < 0 || frame >= ft->nframes)
+    {
+        fprintf(stderr, "frame_table_free: illegal frame #%d\n", frame);
+        abort();
+    }
+
+    frame_table_unmap(ft, frame);
+    ft->free_stack[ft->nfree++] = frame;
+}
+
+int frame_table_page(struct frame_table *ft, int frame)
+{
+    return ft->info[frame].page;
+}
+
+int frame_table_lookup(struct frame_table *ft, int page)
+{
+    if (page < 0 || page >= ft->npages)
+        return -1;
+
+    return ft->page_frame[page];
+}
+
+struct frame_info *frame_table_info(struct frame_table *ft, int frame)
+{
+    return &ft->info[frame];
+}
+
+int frame_table_nfree(struct frame_table *ft)
+{
+    return ft->nfree;
+}
+
+int frame_table_nframes(struct frame_table *ft)
+{
+    return ft->nframes;
+}
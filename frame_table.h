@@ -0,0 +1,71 @@
+#ifndef FRAME_TABLE_H
+#define FRAME_TABLE_H
+
+/*
+The frame table tracks which page lives in each physical frame, and which frame
+holds each page, so that both directions are O(1) lookups. Free frames are kept
+on a stack, so allocating and releasing a frame are O(1) as well.
+*/
+
+#define FRAME_DIRTY 0x1
+#define FRAME_REFERENCED 0x2
+#define FRAME_PREFETCHED 0x4 // brought in by readahead and not accessed yet
+
+struct frame_table;
+
+/* Per-frame metadata, packed so that a cache line covers several frames. */
+
+struct frame_info
+{
+    int page;             // resident page, or -1 if the frame is free
+    unsigned int age;     // fault count when the page was loaded or last referenced
+    unsigned short flags; // FRAME_DIRTY, FRAME_REFERENCED, FRAME_PREFETCHED
+    unsigned short pins;  // frames with pins > 0 must not be evicted
+};
+
+/* Create a frame table for "nframes" frames backing "npages" virtual pages.
+ All frames start out free. Returns null on failure. */
+
+struct frame_table *frame_table_create(int nframes, int npages);
+
+/* Delete a frame table. */
+
+void frame_table_delete(struct frame_table *ft);
+
+/* Take a frame off the free stack. Returns -1 if every frame is in use. */
+
+int frame_table_alloc(struct frame_table *ft);
+
+/* Record that "page" now lives in "frame". The frame's flags and pins are reset. */
+
+void frame_table_map(struct frame_table *ft, int frame, int page);
+
+/* Forget the page held in "frame" and push the frame back on the free stack. */
+
+void frame_table_free(struct frame_table *ft, int frame);
+
+/* Forget the page held in "frame" but keep the frame allocated, for reuse by a new page. */
+
+void frame_table_unmap(struct frame_table *ft, int frame);
+
+/* Return the page held in "frame", or -1 if the frame is free. */
+
+int frame_table_page(struct frame_table *ft, int frame);
+
+/* Return the frame holding "page", or -1 if the page is not resident. */
+
+int frame_table_lookup(struct frame_table *ft, int page);
+
+/* Return the metadata of a frame. */
+
+struct frame_info *frame_table_info(struct frame_table *ft, int frame);
+
+/* Return the number of free frames. */
+
+int frame_table_nfree(struct frame_table *ft);
+
+/* Return the total number of frames. */
+
+int frame_table_nframes(struct frame_table *ft);
+
+#endif
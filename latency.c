@@ -0,0 +1,120 @@
+#include "latency.h"
+
+#ifdef NO_LATENCY
+
+void latency_enable(void)
+{
+}
+
+void latency_print(FILE *f)
+{
+    fprintf(f, "Latency: compiled out (NO_LATENCY)\n");
+}
+
+#else
+
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+struct histogram
+{
+    long counts[LATENCY_BUCKETS];
+    long total;
+    long sum;
+    long max;
+};
+
+static const char *phase_names[LATENCY_PHASES] = {
+    "fault", "lock", "evict", "disk wait", "disk read", "disk write", "map",
+};
+
+static struct histogram histograms[LATENCY_PHASES];
+
+int latency_on;
+
+// values below LATENCY_SUB_BUCKETS have a bucket each; above, every power of
+// two [2^m, 2^(m+1)) is split into LATENCY_SUB_BUCKETS buckets
+static int bucket_of(unsigned long v)
+{
+    if (v < LATENCY_SUB_BUCKETS)
+        return v;
+
+    int m = 63 - __builtin_clzl(v);
+    int shift = m - LATENCY_SUB_BITS;
+
+    return (shift + 1) * LATENCY_SUB_BUCKETS + ((v >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+// the largest value that falls in bucket "b"
+static unsigned long bucket_top(int b)
+{
+    if (b < LATENCY_SUB_BUCKETS)
+        return b;
+
+    int shift = b / LATENCY_SUB_BUCKETS - 1;
+    unsigned long low = (unsigned long)(LATENCY_SUB_BUCKETS + b % LATENCY_SUB_BUCKETS) << shift;
+
+    return low + (1UL << shift) - 1;
+}
+
+void latency_enable(void)
+{
+    latency_on = 1;
+}
+
+void latency_add(enum latency_phase phase, long nanoseconds)
+{
+    struct histogram *h = &histograms[phase];
+    long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+
+    __atomic_fetch_add(&h->counts[bucket_of(nanoseconds)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, nanoseconds, __ATOMIC_RELAXED);
+    while (nanoseconds > max && !__atomic_compare_exchange_n(&h->max, &max, nanoseconds, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// the value at or below which a fraction "q" of the recorded values fall
+static unsigned long percentile(struct histogram *h, long total, double q)
+{
+    long rank = (long)(q * total + 0.999999);
+    long seen = 0;
+
+    if (rank < 1)
+        rank = 1;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += __atomic_load_n(&h->counts[b], __ATOMIC_RELAXED);
+        if (seen >= rank)
+        {
+            unsigned long top = bucket_top(b);
+            unsigned long max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+            return top < max ? top : max;
+        }
+    }
+    return __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+void latency_print(FILE *f)
+{
+    fprintf(f, "Latency (us): %-10s %10s %10s %10s %10s %10s %10s\n", "phase", "count", "p50", "p99", "p99.9", "max", "mean");
+    for (int p = 0; p < LATENCY_PHASES; p++)
+    {
+        struct histogram *h = &histograms[p];
+        long total = __atomic_load_n(&h->total, __ATOMIC_RELAXED);
+
+        if (!total)
+            continue;
+
+        fprintf(f, "Latency (us): %-10s %10ld %10.1f %10.1f %10.1f %10.1f %10.1f\n", phase_names[p], total,
+                percentile(h, total, 0.5) / 1e3, percentile(h, total, 0.99) / 1e3, percentile(h, total, 0.999) / 1e3,
+                __atomic_load_n(&h->max, __ATOMIC_RELAXED) / 1e3, (double)__atomic_load_n(&h->sum, __ATOMIC_RELAXED) / total / 1e3);
+    }
+    fflush(f);
+}
+
+#endif
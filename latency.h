@@ -0,0 +1,92 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <time.h>
+
+/*
+Latency histograms for the phases of a page fault.
+
+Each phase has a histogram with HDR-style log-linear buckets: every power of two
+of nanoseconds is split into LATENCY_SUB_BUCKETS equal buckets, so any value is
+recorded within 1/LATENCY_SUB_BUCKETS of its true value, from nanoseconds to
+minutes, in a fixed table of counters. Recording is a clock read and a relaxed
+atomic increment, safe from any thread.
+
+Nothing is recorded until latency_enable is called, and compiling with
+-DNO_LATENCY (make NO_LATENCY=1) removes the instrumentation altogether.
+
+Phases nest: a fault includes its wait for the lock, evicting includes the
+unmap of the victim, and waiting for the disk covers the disk operations
+submitted. Signal or userfaultfd delivery happens before the handler runs and
+carries no timestamp, so it shows only in the faults/sec of the program.
+*/
+
+enum latency_phase
+{
+    LATENCY_FAULT,      // the whole fault handler, lock wait included
+    LATENCY_LOCK,       // waiting for the lock shared with other handlers and the cleaner
+    LATENCY_EVICT,      // choosing a victim and evicting it
+    LATENCY_DISK_WAIT,  // a fault handler waiting for its batch of disk I/O
+    LATENCY_DISK_READ,  // one disk read operation, from submission to completion
+    LATENCY_DISK_WRITE, // one disk write operation, from submission to completion
+    LATENCY_MAP,        // one page table update: remap and mprotect, or a userfaultfd copy
+    LATENCY_PHASES
+};
+
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+
+#ifdef NO_LATENCY
+
+static inline long latency_now(void)
+{
+    return 0;
+}
+
+static inline void latency_record(enum latency_phase phase, long start)
+{
+}
+
+#else
+
+extern int latency_on;
+
+/* Return a timestamp in nanoseconds to pass to latency_record, or 0 while
+ recording is off. */
+
+static inline long latency_now(void)
+{
+    struct timespec ts;
+
+    if (!latency_on)
+        return 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* Add a value to the histogram of "phase". */
+
+void latency_add(enum latency_phase phase, long nanoseconds);
+
+/* Add the time since "start" (from latency_now) to the histogram of "phase".
+ Does nothing if "start" is 0. */
+
+static inline void latency_record(enum latency_phase phase, long start)
+{
+    if (start)
+        latency_add(phase, latency_now() - start);
+}
+
+#endif
+
+/* Start recording. */
+
+void latency_enable(void);
+
+/* Print the count, p50, p99, p99.9, max and mean of every phase that has been
+ recorded, in microseconds. Safe to call while recording goes on. */
+
+void latency_print(FILE *f);
+
+#endif
@@ -0,0 +1,228 @@
+#include "policy.h"
+
+#include <stdlib.h>
+
+/*
+LIRS, Low Inter-reference Recency Set (Jiang and Zhang, SIGMETRICS 2002).
+
+Pages with a short reuse distance (LIR) own almost all frames; the rest (1%, at
+least one frame) hold HIR pages, which are evicted first in FIFO order from the
+queue Q. The stack S orders pages by recency and also remembers non-resident HIR
+pages: a HIR page referenced again while still in S has a reuse distance shorter
+than the oldest LIR page, so it is promoted and the bottom LIR page is demoted.
+A scan produces only HIR pages and so cannot displace the LIR set.
+*/
+
+#define LIRS_NONE 0
+#define LIRS_LIR 1
+#define LIRS_HIR 2         // resident HIR page, on Q
+#define LIRS_NONRESIDENT 3 // non-resident HIR page still on S
+
+struct lirs_state
+{
+    unsigned char *type;
+    unsigned char *in_s;
+    int *s_next;
+    int *s_prev;
+    int *q_next;
+    int *q_prev;
+    struct page_list s; // head is the top of the stack
+    struct page_list q; // tail is the front of the queue
+    int nlir;
+    int max_lir;
+};
+
+static void lirs_destroy(struct policy *p)
+{
+    struct lirs_state *s = p->state;
+
+    free(s->type);
+    free(s->in_s);
+    free(s->s_next);
+    free(s->s_prev);
+    free(s->q_next);
+    free(s->q_prev);
+    free(s);
+}
+
+static int lirs_init(struct policy *p)
+{
+    struct lirs_state *s = calloc(1, sizeof(*s));
+    int hir_frames;
+
+    if (!s)
+        return -1;
+
+    s->type = calloc(p->npages, 1);
+    s->in_s = calloc(p->npages, 1);
+    s->s_next = malloc(sizeof(int) * p->npages);
+    s->s_prev = malloc(sizeof(int) * p->npages);
+    s->q_next = malloc(sizeof(int) * p->npages);
+    s->q_prev = malloc(sizeof(int) * p->npages);
+    p->state = s;
+
+    if (!s->type || !s->in_s || !s->s_next || !s->s_prev || !s->q_next || !s->q_prev)
+    {
+        lirs_destroy(p);
+        return -1;
+    }
+
+    page_list_init(&s->s);
+    page_list_init(&s->q);
+
+    // with a single frame there is no LIR set: every page is HIR, and Q is FIFO
+    hir_frames = p->nframes / 100 > 1 ? p->nframes / 100 : 1;
+    s->max_lir = p->nframes >= 2 ? p->nframes - hir_frames : 0;
+
+    return 0;
+}
+
+static void lirs_stack_remove(struct lirs_state *s, int page)
+{
+    page_list_remove(&s->s, s->s_next, s->s_prev, page);
+    s->in_s[page] = 0;
+}
+
+static void lirs_stack_top(struct lirs_state *s, int page)
+{
+    if (s->in_s[page])
+        page_list_remove(&s->s, s->s_next, s->s_prev, page);
+
+    page_list_push(&s->s, s->s_next, s->s_prev, page);
+    s->in_s[page] = 1;
+}
+
+// remove HIR pages from the bottom of S until a LIR page is at the bottom
+static void lirs_prune(struct lirs_state *s)
+{
+    while (s->s.tail >= 0 && s->type[s->s.tail] != LIRS_LIR)
+    {
+        int page = s->s.tail;
+
+        lirs_stack_remove(s, page);
+        if (s->type[page] == LIRS_NONRESIDENT)
+            s->type[page] = LIRS_NONE;
+    }
+}
+
+// demote LIR pages from the bottom of S to the end of Q until the LIR set fits
+static void lirs_demote(struct lirs_state *s)
+{
+    lirs_prune(s);
+
+    while (s->nlir > s->max_lir && s->s.tail >= 0)
+    {
+        int page = s->s.tail;
+
+        lirs_stack_remove(s, page);
+        s->type[page] = LIRS_HIR;
+        s->nlir--;
+        page_list_push(&s->q, s->q_next, s->q_prev, page);
+        lirs_prune(s);
+    }
+}
+
+static void lirs_on_access(struct policy *p, int page, int frame)
+{
+    struct lirs_state *s = p->state;
+
+    if (s->type[page] == LIRS_LIR)
+    {
+        int was_bottom = s->s.tail == page;
+
+        lirs_stack_top(s, page);
+        if (was_bottom)
+            lirs_prune(s);
+    }
+    else if (s->type[page] == LIRS_HIR)
+    {
+        page_list_remove(&s->q, s->q_next, s->q_prev, page);
+
+        if (s->in_s[page] && s->max_lir > 0)
+        {
+            s->type[page] = LIRS_LIR;
+            s->nlir++;
+            lirs_stack_top(s, page);
+            lirs_demote(s);
+        }
+        else
+        {
+            lirs_stack_top(s, page);
+            page_list_push(&s->q, s->q_next, s->q_prev, page);
+        }
+    }
+}
+
+static int lirs_choose_victim(struct policy *p, int page)
+{
+    struct lirs_state *s = p->state;
+    int victim = policy_list_victim(p, &s->q, s->q_prev);
+
+    // only LIR pages are resident (or all HIR ones are pinned): demote one
+    if (victim < 0 && s->nlir > 0)
+    {
+        int max_lir = s->max_lir;
+
+        s->max_lir = s->nlir - 1;
+        lirs_demote(s);
+        s->max_lir = max_lir;
+        victim = policy_list_victim(p, &s->q, s->q_prev);
+    }
+
+    return victim < 0 ? -1 : frame_table_lookup(p->ft, victim);
+}
+
+static void lirs_on_evict(struct policy *p, int page, int frame)
+{
+    struct lirs_state *s = p->state;
+
+    if (s->type[page] == LIRS_HIR)
+    {
+        page_list_remove(&s->q, s->q_next, s->q_prev, page);
+        s->type[page] = s->in_s[page] ? LIRS_NONRESIDENT : LIRS_NONE;
+    }
+    else if (s->type[page] == LIRS_LIR)
+    {
+        lirs_stack_remove(s, page);
+        s->type[page] = LIRS_NONE;
+        s->nlir--;
+        lirs_prune(s);
+    }
+}
+
+static void lirs_on_load(struct policy *p, int page, int frame)
+{
+    struct lirs_state *s = p->state;
+
+    if (s->nlir < s->max_lir)
+    {
+        // still filling the LIR set
+        s->type[page] = LIRS_LIR;
+        s->nlir++;
+        lirs_stack_top(s, page);
+    }
+    else if (s->type[page] == LIRS_NONRESIDENT && s->in_s[page] && s->max_lir > 0)
+    {
+        s->type[page] = LIRS_LIR;
+        s->nlir++;
+        lirs_stack_top(s, page);
+        lirs_demote(s);
+    }
+    else
+    {
+        s->type[page] = LIRS_HIR;
+        lirs_stack_top(s, page);
+        page_list_push(&s->q, s->q_next, s->q_prev, page);
+    }
+}
+
+const struct policy_ops lirs_policy_ops = {
+    .name = "lirs",
+    .sampled = 1,
+    .init = lirs_init,
+    .destroy = lirs_destroy,
+    .on_access = lirs_on_access,
+    .choose_victim = lirs_choose_victim,
+    .on_evict = lirs_on_evict,
+    .on_load = lirs_on_load,
+};
@@ -0,0 +1,163 @@
+#include "lz.h"
+
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+static unsigned lz_hash(const unsigned char *p)
+{
+    unsigned v;
+
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// write a length that did not fit in its 4-bit token field
+static unsigned char *lz_put_length(unsigned char *op, int n)
+{
+    while (n >= 255)
+    {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = n;
+    return op;
+}
+
+// emit literals [anchor, anchor + nlit) followed by a match, or by nothing if mlen == 0
+static unsigned char *lz_put_sequence(unsigned char *op, unsigned char *oend, const unsigned char *anchor, int nlit,
+                                      int offset, int mlen)
+{
+    // token, literal length bytes, literals, offset, match length bytes
+    if (op + 1 + nlit / 255 + 1 + nlit + 2 + mlen / 255 + 1 > oend)
+        return 0;
+
+    unsigned char *token = op++;
+    int mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+
+    *token = (nlit < 15 ? nlit : 15) << 4 | (mcode < 15 ? mcode : 15);
+    if (nlit >= 15)
+        op = lz_put_length(op, nlit - 15);
+    memcpy(op, anchor, nlit);
+    op += nlit;
+
+    if (mlen)
+    {
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        if (mcode >= 15)
+            op = lz_put_length(op, mcode - 15);
+    }
+
+    return op;
+}
+
+int lz_compress(const char *src, int len, char *dst, int max)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *end = in + len;
+    const unsigned char *anchor = in;
+    const unsigned char *ip = in;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *oend = op + max;
+    int table[1 << LZ_HASH_BITS]; // position + 1 of the last 4 bytes with each hash, 0 if none
+
+    memset(table, 0, sizeof(table));
+
+    while (ip + LZ_MIN_MATCH <= end)
+    {
+        unsigned h = lz_hash(ip);
+        const unsigned char *ref = in + table[h] - 1;
+        int seen = table[h];
+
+        table[h] = ip - in + 1;
+
+        if (!seen || ip - ref > LZ_MAX_OFFSET || memcmp(ref, ip, LZ_MIN_MATCH))
+        {
+            ip++;
+            continue;
+        }
+
+        int mlen = LZ_MIN_MATCH;
+        while (ip + mlen < end && ip[mlen] == ref[mlen])
+            mlen++;
+
+        op = lz_put_sequence(op, oend, anchor, ip - anchor, ip - ref, mlen);
+        if (!op)
+            return -1;
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    // the last sequence is literals only
+    op = lz_put_sequence(op, oend, anchor, end - anchor, 0, 0);
+    if (!op)
+        return -1;
+
+    return op - (unsigned char *)dst;
+}
+
+// read a length continued past its 4-bit token field
+static int lz_get_length(const unsigned char **ip, const unsigned char *iend, int n)
+{
+    unsigned char b;
+
+    do
+    {
+        if (*ip >= iend)
+            return -1;
+        b = *(*ip)++;
+        n += b;
+    } while (b == 255);
+
+    return n;
+}
+
+int lz_decompress(const char *src, int len, char *dst, int max)
+{
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + len;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *oend = op + max;
+
+    while (ip < iend)
+    {
+        int token = *ip++;
+        int nlit = token >> 4;
+
+        if (nlit == 15 && (nlit = lz_get_length(&ip, iend, nlit)) < 0)
+            return -1;
+        if (nlit > iend - ip || nlit > oend - op)
+            return -1;
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+
+        // the last sequence has no match
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        int offset = ip[0] | ip[1] << 8;
+        ip += 2;
+
+        int mlen = token & 15;
+        if (mlen == 15 && (mlen = lz_get_length(&ip, iend, mlen)) < 0)
+            return -1;
+        mlen += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > op - (unsigned char *)dst || mlen > oend - op)
+            return -1;
+
+        // the match may overlap the bytes it produces, so copy forwards byte by byte
+        const unsigned char *ref = op - offset;
+        while (mlen--)
+            *op++ = *ref++;
+    }
+
+    return op - (unsigned char *)dst;
+}
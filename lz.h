@@ -0,0 +1,22 @@
+#ifndef LZ_H
+#define LZ_H
+
+/*
+A small LZ77 compressor in the style of LZ4, for pages held in the compressed
+swap pool. Output is a sequence of tokens, each a run of literals followed by a
+match of at least 4 bytes up to 64 KiB back; lengths of 15 or more continue in
+extra bytes of 255. It favours speed over ratio: one hash probe per position
+and no lazy matching. The format is private to this program.
+*/
+
+/* Compress "len" bytes of "src" into "dst", which holds "max" bytes.
+ Returns the compressed size, or -1 if it would not fit in "max" bytes. */
+
+int lz_compress(const char *src, int len, char *dst, int max);
+
+/* Decompress "len" bytes of "src" into "dst", which holds "max" bytes.
+ Returns the decompressed size, or -1 if the input is corrupt or too big. */
+
+int lz_decompress(const char *src, int len, char *dst, int max);
+
+#endif
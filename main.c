@@ -14,282 +14,2635 @@ Group Members - Tarik Brown, Joseph Sweilem, Daraius Balsara, Bradley Budden
 #include "page_table.h"
 #include "disk.h"
 #include "program.h"
+#include "frame_table.h"
+#include "policy.h"
+#include "readahead.h"
+#include "zswap.h"
+#include "swap_log.h"
+#include "dedup.h"
+#include "page_ops.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "opt.h"
+#include "parallel.h"
+#include "latency.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
 
-struct page_table
+// globals
+struct frame_table *ft; // frame <-> page maps and per-frame metadata
+
+// address spaces: each program runs in a page table of its own, all of them over
+// the frames of the first. Pages are numbered across the spaces, one space after
+// another, and that number is also the page's disk block, so the frame table, the
+// policy, the disk and everything below them see one set of pages however many
+// spaces there are. Only page table entries are set per space.
+struct space
 {
-    int fd;
-    char *virtmem;
-    int npages;
-    char *physmem;
-    int nframes;
-    int *page_mapping;
-    int *page_bits;
-    page_fault_handler_t handler;
+    struct page_table *pt;
+    struct policy *policy; // its own with local replacement, otherwise shared by every space
+    const char *program;
+    int base;     // number of the space's first page
+    int quota;    // with local replacement, the most frames the space may hold
+    int resident; // frames it holds
+    int peak;
+
+    int page_faults;
+    int disk_reads;
+    int disk_writes;
+    int evictions;
+    int stolen; // evictions of its pages to make room for another space's
+    double seconds;
+    pthread_t thread;
 };
 
-// globals
-char *alg;             // page replacement policy
-int *frames;           // frame table for use in replacement logic
-int frame_counter = 0; // holds an index into our frame table
+struct space *spaces;
+int nspaces;
+int space_npages;
+int local_replacement; // -R local or -q: a fault evicts a page of its own space
+
+// reference sampling for policies that want it: every "sample_interval" faults,
+// pages mapped since the last sample are dropped to PROT_NONE so that their next
+// access re-faults and is reported to the policy
+int sample_interval = 16;
+int *sample_pending;
+int sample_npending;
+
+// readahead: prefetched pages are mapped readable, so reading them does not fault,
+// except the last page of each batch, which is left PROT_NONE as a marker: the
+// stream faulting on it has used the pages before it, and asks for the next batch
+struct readahead *ra; // null if readahead is off
+int readahead_max_window = -1; // -r; 0 turns readahead off, -1 leaves it to the policy
+int *readahead_pages;
+
+// disk I/O for the fault being handled. Victims are copied out of their frames
+// and the write-backs are submitted in one batch with the reads of the pages
+// brought in, so they overlap; the loaded frames stay pinned until it completes.
+struct pending_load
+{
+    int page;
+    int frame;
+    int bits;
+};
+
+// Every thread that handles faults batches its I/O in its own context, with its
+// own handle on the disk, and waits for it without holding vm_lock, so that
+// faults from several threads wait for the disk at the same time. Contexts are
+// made on a thread's first fault and kept on a list for the summary.
+struct io_context
+{
+    struct disk *disk;
+    struct disk_request *batch;
+    int *pages; // the page of each request: requests are queued by page, and given a block by flush_io
+    struct pending_load *loads;
+    char *bounce; // copies of the victims being written back
+    int *pins;    // frames written straight from memory, pinned until the batch completes
+    int nbatch;
+    int nloads;
+    int nwrites;
+    int npins;
+    int *free_frames; // frames taken off the frame table for this thread, pinned until used
+    int nfree;
+    // the thread's share of the summary's counts, added into them at exit
+    int demand_misses;
+    int soft_faults;
+    int write_misses;
+    int write_faults;
+    int busy_waits;
+    struct io_context *next;
+};
+
+__thread struct io_context *io; // the calling thread's
+struct io_context *io_contexts;
+int io_max; // most pages loaded (and victims written) per fault
+int io_batch_max;
+int io_inflight; // batches being waited for without vm_lock, the cleaner's included
+double io_seconds; // time fault handlers spent waiting for the disk, summed over threads
+
+// free frames a thread with company takes off the frame table at once
+#define FRAME_CACHE 8
+
+// pages with a read or write-back queued are busy: their frames are pinned, and a
+// fault on one waits for the I/O on one of the page_ready stripes, then retries,
+// so that two threads faulting on the same page read it once. Waiting for a frame
+// when every frame is pinned by I/O in flight is done on io_done.
+//
+// A write to a resident page mapped read-only is handled without vm_lock, under
+// the page's stripe of page_locks alone (see handle_write_fault). So a page's
+// entry, and the flags of its frame while it is mapped, only change with that
+// stripe held as well, and no thread holds two stripes at once. Merged pages are
+// left to vm_lock: with page sharing the fast path is off.
+#define PAGE_READY_STRIPES 64
+
+unsigned char *page_busy;
+pthread_cond_t page_ready[PAGE_READY_STRIPES];
+pthread_mutex_t page_locks[PAGE_READY_STRIPES];
 
-// summary variables
+// pages whose miss waited on io_done for a frame: the miss was counted, traced
+// and reported to the policy before the wait, so the retry must not do it again.
+// Cleared when the page is loaded.
+unsigned char *miss_reported;
+pthread_cond_t io_done = PTHREAD_COND_INITIALIZER;
+int busy_waits; // faults that waited for another thread's I/O on their page, summed at exit
+int nthreads;   // -T: run the parallel variant of the program on this many threads
+
+// write clustering: a dirty victim is written together with up to "cluster_max"
+// dirty resident pages on either side of it, which stay resident but are clean
+// afterwards, so that the run goes out as one vectored write
+int cluster_max;
+int cluster_writes; // neighbours written along with a victim
+
+// background write-back: when more than "cleaner_high" percent of the frames are
+// dirty, the cleaner writes out the least recently used dirty frames and downgrades
+// them to PROT_READ until no more than "cleaner_low" percent are, at most
+// "cleaner_rate" pages a second. The fault handler and the cleaner share vm_lock.
+pthread_mutex_t vm_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cleaner_wakeup = PTHREAD_COND_INITIALIZER;
+pthread_t cleaner_thread;
+struct disk *cleaner_disk; // the cleaner's own handle, so its I/O does not mix with the handler's
+struct disk_stats cleaner_stats;
+int cleaner_on;
+int cleaner_stop;
+int cleaner_high = 40;
+int cleaner_low = 20;
+int cleaner_rate = 10000;
+int dirty_frames;
+
+// compressed swap: dirty victims are compressed into a pool of "zswap_percent"
+// percent of physical memory before anything is written to disk
+struct zswap *zswap;
+int zswap_percent;
+
+// log-structured swap (-L): write-backs are appended to the log of swap_log.h
+// instead of going to the page's own block, so that every batch is written to
+// consecutive blocks, in page order. The compactor thread cleans segments in the
+// background; writes wait for it when the log runs out of room.
+struct swap_log *swap_log;
+int log_segment; // blocks per segment, 0 to write pages in place
+int log_spare = 25;
+pthread_t compactor_thread;
+pthread_cond_t compactor_wakeup = PTHREAD_COND_INITIALIZER;
+pthread_cond_t log_space = PTHREAD_COND_INITIALIZER;
+struct disk *compactor_disk;
+struct disk_stats compactor_stats;
+int compactor_stop;
+int log_waits; // writes that waited for the compactor to make room
+
+// zero pages: page_zero[page] is set while the disk block of the page is known to
+// be all zeros, so that loading it needs no read. A new disk is zero throughout,
+// and a dirty victim found to be all zeros is dropped rather than written.
+unsigned char *page_zero;
+int zero_fills;  // loads served by zero-filling the frame
+int zero_drops;  // write-backs skipped because the page was all zeros
+
+// page sharing (-K): on every miss the scanner hashes up to "dedup_scan" more
+// frames holding clean pages (see dedup.h). A page whose frame holds the same
+// bytes as one indexed before is merged onto it, mapped read-only, and its own
+// frame freed; a write to it copies the frame into one of its own again. Merged
+// pages are clean, so when the page owning their frame is evicted or written they
+// are only unmapped, to be read again when next used. With the log, merged pages
+// also hold the disk block of the page whose frame they share, and a dirty victim
+// with the bytes of an indexed frame is given that frame's block, unwritten.
+struct dedup *dedup;
+int dedup_scan; // 0 for no sharing
+int dedup_cursor;
+int dedup_skips; // write-backs skipped because the bytes were on disk already
+
+// fault tracing: every fault is appended to a binary trace, for replay in vmsim.
+// Hits on resident pages are only recorded with -H.
+struct trace_writer *trace;
+const char *trace_file;
+int trace_hits;
+
+// write intent: a fault the backend reports as a write maps the page writable at
+// once, where a miss would otherwise map it read-only and the write fault again.
+// -W turns it off, for comparison.
+int write_intent = 1;
+int write_misses; // misses mapped writable at once, summed at exit
+int write_faults; // writes to resident pages mapped read-only, summed at exit
+
+// snapshots: -S saves the resident pages when the run ends, and -U restores them
+// before the program starts, in a later run over the same disk (see snapshot.h)
+const char *snapshot_save;
+const char *snapshot_restore;
+int restored_pages; // the dirty ones included
+int restored_dirty;
+int restored_spills; // dirty pages written to disk for want of a frame
+double restore_seconds;
+struct disk_stats restore_stats;
+int saved_pages;
+int saved_dirty;
+long saved_bytes;
+double save_seconds;
+
+// opt: the reference string, recorded by a first pass of the program
+int *opt_pages;
+long opt_nrefs;
+
+// -l: fault latency histograms (see latency.h), printed at exit and on SIGUSR1
+int latency;
+sigset_t latency_signals;
+
+// summary variables. page_faults is also the clock frames are aged by, so it is
+// kept up to date, without vm_lock by the fast path; the counts only fault
+// handlers keep are kept per thread, in their I/O contexts, and summed at exit.
 int page_faults;
 int disk_reads;
 int disk_writes;
+int soft_faults; // re-faults on resident pages caught by reference sampling
+int demand_misses; // faults on pages that were not resident
+int evictions;
+int clean_evictions; // evictions that found the victim clean
+int cleaner_writes;  // pages written back by the cleaner
 
 struct disk *disk;
+const char *disk_file = "myvirtualdisk"; // -d, so that concurrent runs can each have their own
+enum disk_backend disk_backend = DISK_BACKEND_FILE; // -D: where the disk keeps its blocks
+
+// -p: the size of pages, frames and disk blocks. A page is always moved whole:
+// one fault maps it, and one disk transfer reads or writes it.
+int page_size = PAGE_SIZE;
+
+// the data of a frame in physical memory
+char *frame_data(struct page_table *pt, int frame)
+{
+    return &page_table_get_physmem(pt)[(size_t)frame * page_size];
+}
 
-// return the first avaialble frame to insert data into PT
-int check_frame_availibity(struct page_table *pt)
+// the address space "page" belongs to
+struct space *page_space(int page)
 {
-    for (int i = 0; i < pt->nframes; i++)
+    return &spaces[page / space_npages];
+}
+
+// set and get the page table entry of a page, in the address space it belongs to
+void space_set_entry(int page, int frame, int bits)
+{
+    struct space *s = page_space(page);
+
+    page_table_set_entry(s->pt, page - s->base, frame, bits);
+}
+
+void space_get_entry(int page, int *frame, int *bits)
+{
+    struct space *s = page_space(page);
+
+    page_table_get_entry(s->pt, page - s->base, frame, bits);
+}
+
+// take and let go of the stripe of page_locks covering "page"
+void lock_page(int page)
+{
+    pthread_mutex_lock(&page_locks[page % PAGE_READY_STRIPES]);
+}
+
+void unlock_page(int page)
+{
+    pthread_mutex_unlock(&page_locks[page % PAGE_READY_STRIPES]);
+}
+
+// clear the reference bit of a frame and drop its page to PROT_NONE, so that the
+// next access re-faults and sets the bit again
+void unreference_frame(void *arg, int frame)
+{
+    struct frame_info *fi = frame_table_info(ft, frame);
+    int page = fi->page;
+    int bits, mapped;
+
+    lock_page(page);
+    fi->flags &= ~FRAME_REFERENCED;
+    space_get_entry(page, &mapped, &bits);
+    if (bits)
+    {
+        space_set_entry(page, frame, 0);
+    }
+    unlock_page(page);
+}
+
+// drop the pages mapped since the last sample to PROT_NONE. Policies that manage
+// reference bits themselves only need it for pages not seen referenced yet.
+void sample_references(struct page_table *pt, struct policy *policy)
+{
+    for (int i = 0; i < sample_npending; i++)
     {
-        if (frames[i] == -1)
+        int frame = sample_pending[i];
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        if (fi->page >= 0 && !(policy->ops->refbits && (fi->flags & FRAME_REFERENCED)))
         {
-            // if available frame is found, set bit to used and return frame number
-            return i;
+            unreference_frame(pt, frame);
         }
     }
-    return -1;
+    sample_npending = 0;
 }
 
-// This policy brings in page p + 1 whenever we need to bring in page p. It is a basic implementation
-// of a prefetching algorithm.
-void custom_replacement_policy(struct page_table *pt, int page, int frame, int fetch_bits, int fetch_frame)
+// remember that "frame" is mapped accessible, so that the next sample drops it
+void sample_later(struct page_table *pt, struct policy *policy, int frame)
 {
-    // bring in next page, if there is only 1 frame, do not attempt to bring in surrounding pages
-    if (pt->nframes > 1)
+    if (!policy->ops->sampled)
     {
-        // if there is a p + 1th page, bring in the next page
-        if (page + 1 < pt->npages)
-        {
-            int stop_custom = 0;
-            // check if page + 1 is in physical memory already; if so, don't bring it in
-            for (int i = 0; i < pt->nframes; i++)
-            {
-                if (frames[i] == page + 1)
-                {
-                    stop_custom = 1;
-                }
-            }
-            if (!stop_custom)
-            {
-                if (frame + 1 >= pt->nframes)
-                {
-                    // if we are at the last frame, point to first frame in frame table and get it bits
-                    fetch_frame = 0;
-                    page_table_get_entry(pt, frames[fetch_frame], &fetch_frame, &fetch_bits);
-                }
-                else
-                {
-                    // if we are not at the last frame, point to next frame in frame table and get it bits
-                    fetch_frame = frame + 1;
-                    page_table_get_entry(pt, frames[fetch_frame], &fetch_frame, &fetch_bits);
-                }
+        return;
+    }
 
-                // if the extra page we are going to evict has its WRITE bit set, then write
-                // it back to disk before evicting it
-                if (fetch_bits == (PROT_READ | PROT_WRITE))
-                {
-                    disk_write(disk, frames[fetch_frame], &pt->physmem[(fetch_frame)*PAGE_SIZE]);
-                    disk_writes++;
-                    page_table_set_entry(pt, frames[fetch_frame], 0, 0);
-                }
-                else
-                {
-                    page_table_set_entry(pt, frames[fetch_frame], 0, 0);
-                }
-                // bring the p+1 page in from memory and update the frame table
-                disk_read(disk, page + 1, &pt->physmem[fetch_frame * PAGE_SIZE]);
-                disk_reads++;
+    if (sample_npending == page_table_get_nframes(pt))
+    {
+        sample_references(pt, policy);
+    }
+    sample_pending[sample_npending++] = frame;
+}
 
-                frames[fetch_frame] = page + 1;
+// the calling thread's I/O context, made on its first fault. The first one uses
+// the main disk handle, the others clones of it.
+struct io_context *io_context_get(void)
+{
+    if (io)
+    {
+        return io;
+    }
 
-                // update the p+1 PT entry to map to the frame that we placed it in
-                page_table_set_entry(pt, page + 1, fetch_frame, PROT_READ);
-            }
-        }
+    struct io_context *c = calloc(1, sizeof(*c));
+    if (!c || !(c->disk = io_contexts ? disk_clone(disk) : disk))
+    {
+        fprintf(stderr, "couldn't open disk for fault handler thread: %s\n", strerror(errno));
+        abort();
     }
+    c->batch = malloc(io_batch_max * sizeof(struct disk_request));
+    c->pins = malloc(io_batch_max * sizeof(int));
+    c->pages = malloc(io_batch_max * sizeof(int));
+    c->loads = malloc(io_max * sizeof(struct pending_load));
+    // aligned, so that a disk opened with O_DIRECT can write the copies as they are
+    c->bounce = aligned_alloc(BLOCK_SIZE, (size_t)io_max * page_size);
+    c->free_frames = malloc(FRAME_CACHE * sizeof(int));
+    if (!c->batch || !c->pins || !c->pages || !c->loads || !c->bounce || !c->free_frames)
+    {
+        fprintf(stderr, "couldn't allocate disk request batch\n");
+        abort();
+    }
+
+    c->next = io_contexts;
+    io_contexts = c;
+    return io = c;
 }
 
-void replace_page(struct page_table *pt, int page)
+void io_context_delete(struct io_context *c)
 {
-    // initialize bits and frame
-    int bits, frame;
-    int fetch_bits = 0;
-    int fetch_frame = 0;
-    // get page table entry that currently exists in our frame array
-    page_table_get_entry(pt, frames[frame_counter], &frame, &bits);
+    if (c->disk != disk)
+    {
+        disk_close(c->disk);
+    }
+    free(c->batch);
+    free(c->pins);
+    free(c->pages);
+    free(c->loads);
+    free(c->bounce);
+    free(c->free_frames);
+    free(c);
+}
 
-    if (frame_counter == frame)
-    { // check if frame counter matches frame to be replaced, otherwise no replace is needed
-        if (bits == (PROT_READ | PROT_WRITE))
-        { // if write permissions exist, write back to disk before resetting
-            disk_write(disk, frames[frame_counter], &pt->physmem[frame_counter * BLOCK_SIZE]);
-            disk_writes++;
-            page_table_set_entry(pt, frames[frame_counter], 0, 0);
-        }
-        else
-        { // if no write permissions exist, just reset the page
-            page_table_set_entry(pt, frames[frame_counter], 0, 0);
-        }
+// add the counts of every thread's I/O context into the summary's
+void sum_fault_counts(void)
+{
+    for (struct io_context *c = io_contexts; c; c = c->next)
+    {
+        demand_misses += c->demand_misses;
+        soft_faults += c->soft_faults;
+        write_misses += c->write_misses;
+        write_faults += c->write_faults;
+        busy_waits += c->busy_waits;
+    }
+}
 
-        // read the new page from the disk and set it in the page table
-        disk_read(disk, page, &pt->physmem[frame_counter * BLOCK_SIZE]);
-        disk_reads++;
+void page_done(int page)
+{
+    page_busy[page] = 0;
+    pthread_cond_broadcast(&page_ready[page % PAGE_READY_STRIPES]);
+}
 
-        page_table_set_entry(pt, page, frame, PROT_READ);
+static int compare_requests(const void *a, const void *b)
+{
+    return ((const struct disk_request *)a)->block - ((const struct disk_request *)b)->block;
+}
 
-        // update frame table with replaced page
-        frames[frame_counter] = page;
+// give the "n" requests queued by page their blocks on disk, keeping the pages in
+// "pages". With the log, the writes are moved to the front in page order and
+// appended, waiting for room if needed, and the reads go to wherever their pages
+// were last written. Called with vm_lock held; it may be let go while waiting.
+void place_requests(struct disk_request *reqs, int n, int *pages)
+{
+    int nwrites = 0;
 
-        if (!strcmp(alg, "custom"))
+    if (swap_log)
+    {
+        for (int i = 0; i < n; i++)
         {
-            custom_replacement_policy(pt, page, frame, fetch_bits, fetch_frame);
+            if (reqs[i].op == DISK_OP_WRITE)
+            {
+                struct disk_request r = reqs[i];
+
+                reqs[i] = reqs[nwrites];
+                reqs[nwrites++] = r;
+            }
         }
+        qsort(reqs, nwrites, sizeof(struct disk_request), compare_requests);
     }
-}
 
-void page_fault_handler(struct page_table *pt, int page)
-{
-    // initialize bits and frame
-    int bits, frame;
-    page_table_get_entry(pt, page, &frame, &bits);
-
-    // count number of page faults
-    page_faults++;
-    // if there is no PT mapping
-    if (bits == 0)
+    for (int i = 0; i < n; i++)
     {
-        // Find available frame
-        if ((frame = check_frame_availibity(pt)) < 0)
+        pages[i] = reqs[i].block;
+        if (i < nwrites)
         {
-            // int frame_to_replace
-            if (!strcmp(alg, "fifo") || !strcmp(alg, "custom"))
+            // frames pinned by this batch come free once it completes: faults that
+            // need them wait on io_done meanwhile, as they would for the disk
+            if (!swap_log_can_write(swap_log, 1))
             {
-                // fifo
-                replace_page(pt, page);
-                frame_counter++;
-                frame_counter %= pt->nframes;
+                log_waits++;
             }
-            else if (!strcmp(alg, "rand"))
+            while (!swap_log_can_write(swap_log, 1))
             {
-                frame_counter = rand() % pt->nframes;
-                replace_page(pt, page);
+                io_inflight++;
+                pthread_cond_signal(&compactor_wakeup);
+                pthread_cond_wait(&log_space, &vm_lock);
+                io_inflight--;
+                pthread_cond_broadcast(&io_done);
             }
+            reqs[i].block = swap_log_write(swap_log, pages[i]);
         }
-        else
-        { // If a free frame is found insert into page table
+        else if (swap_log)
+        {
+            reqs[i].block = swap_log_read(swap_log, pages[i]);
+        }
+    }
+
+    if (swap_log && swap_log_needs_cleaning(swap_log))
+    {
+        pthread_cond_signal(&compactor_wakeup);
+    }
+}
+
+// let go of the blocks of a batch placed with place_requests, once it completed
+void release_requests(struct disk_request *reqs, int n)
+{
+    if (!swap_log)
+    {
+        return;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        swap_log_release(swap_log, reqs[i].block);
+    }
+    pthread_cond_broadcast(&log_space);
+    if (swap_log_needs_cleaning(swap_log))
+    {
+        pthread_cond_signal(&compactor_wakeup);
+    }
+}
+
+// submit the batched disk I/O, wait for it, then map the pages that were read.
+// With "unlock", vm_lock is let go while waiting: the frames involved are pinned
+// and their pages busy, so no other fault touches them in the meantime.
+void flush_io(struct page_table *pt, struct policy *policy, int unlock)
+{
+    struct timespec start, end;
+    long wait_start;
+
+    place_requests(io->batch, io->nbatch, io->pages);
+    if (unlock)
+    {
+        io_inflight++;
+        pthread_mutex_unlock(&vm_lock);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    wait_start = latency_now();
+    disk_submit(io->disk, io->batch, io->nbatch);
+    disk_wait(io->disk);
+    latency_record(LATENCY_DISK_WAIT, wait_start);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (unlock)
+    {
+        pthread_mutex_lock(&vm_lock);
+        io_inflight--;
+        pthread_cond_broadcast(&io_done);
+    }
+    io_seconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    release_requests(io->batch, io->nbatch);
+
+    for (int i = 0; i < io->npins; i++)
+    {
+        frame_table_info(ft, io->pins[i])->pins--;
+    }
 
-            disk_read(disk, page, &pt->physmem[frame * BLOCK_SIZE]);
-            disk_reads++;
+    for (int i = 0; i < io->nbatch; i++)
+    {
+        if (io->batch[i].op == DISK_OP_WRITE)
+        {
+            page_done(io->pages[i]);
+        }
+    }
 
-            page_table_set_entry(pt, page, frame, PROT_READ);
+    for (int i = 0; i < io->nloads; i++)
+    {
+        struct pending_load *l = &io->loads[i];
 
-            // update frame table with page for replacement policies
-            frames[frame] = page;
+        frame_table_info(ft, l->frame)->pins--;
+        lock_page(l->page);
+        space_set_entry(l->page, l->frame, l->bits);
+        unlock_page(l->page);
+        page_done(l->page);
+        if (l->bits)
+        {
+            sample_later(pt, policy, l->frame);
         }
     }
-    else
+
+    io->nbatch = 0;
+    io->nloads = 0;
+    io->nwrites = 0;
+    io->npins = 0;
+}
+
+// queue a disk request, flushing first if the batch is full
+void queue_io(struct page_table *pt, struct policy *policy, int op, int block, char *data)
+{
+    if (io->nbatch == io_batch_max)
+    {
+        flush_io(pt, policy, 0);
+    }
+
+    if (op == DISK_OP_WRITE)
     {
-        page_table_set_entry(pt, page, frame, (PROT_READ | PROT_WRITE));
+        page_zero[block] = 0;
+        page_busy[block] = 1;
     }
+
+    struct disk_request *r = &io->batch[io->nbatch++];
+    r->op = op;
+    r->block = block;
+    r->data = data;
+    r->done = 0;
 }
 
-int main(int argc, char *argv[])
+// mark a dirty frame clean, write-protecting its page so that the next write is
+// noticed. The caller writes the frame out.
+void clean_frame(struct page_table *pt, int frame)
 {
-    if (argc != 5)
+    struct frame_info *fi = frame_table_info(ft, frame);
+    int page = fi->page;
+    int bits, mapped;
+
+    lock_page(page);
+    space_get_entry(page, &mapped, &bits);
+    if (bits & PROT_WRITE)
     {
-        printf("use: virtmem <npages> <nframes> <rand|fifo|custom> <alpha|beta|gamma|delta>\n");
-        return 1;
+        space_set_entry(page, frame, PROT_READ);
     }
+    fi->flags &= ~FRAME_DIRTY;
+    unlock_page(page);
+    __atomic_sub_fetch(&dirty_frames, 1, __ATOMIC_RELAXED);
+}
 
-    int npages = atoi(argv[1]);
-    int nframes = atoi(argv[2]);
-    alg = argv[3];
-    const char *program = argv[4];
+// queue the write-back of the dirty resident pages next to "page" in its address
+// space, going in direction "step" (1 or -1), until a page is not resident, clean
+// or pinned
+void cluster_writes_from(struct page_table *pt, struct policy *policy, int page, int step)
+{
+    struct space *s = page_space(page);
 
-    // check that npages and nframes are positive
-    if (npages < 1)
+    for (int i = 1; i <= cluster_max; i++)
     {
-        printf("npages must be an integer and >= 1\n");
-        exit(1);
+        int neighbour = page + i * step;
+
+        if (neighbour < s->base || neighbour >= s->base + space_npages)
+        {
+            break;
+        }
+
+        int frame = frame_table_lookup(ft, neighbour);
+        if (frame < 0)
+        {
+            break;
+        }
+
+        struct frame_info *fi = frame_table_info(ft, frame);
+        if (!(fi->flags & FRAME_DIRTY) || fi->pins)
+        {
+            break;
+        }
+
+        clean_frame(pt, frame);
+        fi->pins++;
+        io->pins[io->npins++] = frame;
+        queue_io(pt, policy, DISK_OP_WRITE, neighbour, frame_data(pt, frame));
+        disk_writes++;
+        s->disk_writes++;
+        cluster_writes++;
     }
-    if (nframes < 1)
+}
+
+// queue the write of a copy of "data" to "page" on disk
+void queue_writeback(struct page_table *pt, struct policy *policy, int page, const char *data)
+{
+    if (io->nwrites == io_max)
     {
-        printf("nframes must be an integer and >= 1\n");
-        exit(1);
+        flush_io(pt, policy, 0);
     }
+    char *copy = &io->bounce[(size_t)io->nwrites++ * page_size];
+    // with O_DIRECT only the disk reads the copy, from memory, so it need not take
+    // up the cache; the other backends read it at once, through the cache
+    if (disk_backend == DISK_BACKEND_DIRECT)
+    {
+        page_copy(copy, data, page_size);
+    }
+    else
+    {
+        memcpy(copy, data, page_size);
+    }
+    queue_io(pt, policy, DISK_OP_WRITE, page, copy);
+    disk_writes++;
+    page_space(page)->disk_writes++;
+}
 
-    // check that alg is a valid replacement policy
-    if (strcmp(alg, "fifo") && strcmp(alg, "rand") && strcmp(alg, "custom"))
+// a page pushed out of the compressed pool goes to disk
+void spill_page(void *arg, int page, const char *data)
+{
+    struct page_table *pt = arg;
+    struct space *s = page_table_get_private(pt);
+
+    queue_writeback(pt, s->policy, page, data);
+}
+
+// unmap the pages merged onto "frame" and take it out of the index, before its
+// page leaves it or writes to it
+void unshare_frame(int frame)
+{
+    int page;
+
+    while ((page = dedup_sharer(dedup, frame)) >= 0)
     {
-        printf("unknown replacement policy: %s\n", argv[3]);
-        exit(1);
+        space_set_entry(page, 0, 0);
+        dedup_unmerge(dedup, page, 0);
     }
+    dedup_forget(dedup, frame);
+}
 
-    // Pre-allocation of frame table needed for page_fault_handler logic
-    frames = (int *)malloc(nframes * sizeof(int));
-    if (!frames)
+// merge the page in "frame" onto "onto", which holds the same bytes, and free "frame"
+void merge_page(int frame, int onto)
+{
+    int page = frame_table_page(ft, frame);
+    int owner = frame_table_page(ft, onto);
+    struct space *s = page_space(page);
+
+    space_set_entry(page, onto, PROT_READ);
+    dedup_merge(dedup, page, onto);
+
+    // both pages are clean, so their copies on disk hold the same bytes too
+    if (swap_log && !page_zero[page])
     {
-        printf("couldn't create frame table\n");
+        if (page_zero[owner])
+        {
+            page_zero[page] = 1;
+            swap_log_discard(swap_log, page);
+        }
+        else
+        {
+            swap_log_share(swap_log, page, owner);
+        }
     }
-    // initialize frame table values
-    for (int i = 0; i < nframes; i++)
+
+    s->resident--;
+    policy_on_evict(s->policy, page, frame);
+    frame_table_free(ft, frame);
+}
+
+// hash the next "dedup_scan" frames round the frame table, merging the pages of
+// those that match a frame indexed before. Only clean pages with no I/O pending
+// are taken: their frames hold what the page does, and are write-protected.
+void dedup_frames(void)
+{
+    int nframes = frame_table_nframes(ft);
+
+    for (int i = 0; i < dedup_scan; i++)
     {
-        frames[i] = -1;
+        int frame = dedup_cursor;
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        dedup_cursor = (dedup_cursor + 1) % nframes;
+        if (fi->page < 0 || fi->pins || (fi->flags & (FRAME_DIRTY | FRAME_PREFETCHED)) || page_busy[fi->page] ||
+            dedup_indexed(dedup, frame))
+        {
+            continue;
+        }
+
+        int onto = dedup_add(dedup, frame);
+        if (onto >= 0)
+        {
+            merge_page(frame, onto);
+        }
     }
+}
 
-    disk = disk_open("myvirtualdisk", npages);
+// evict the page held in "frame": unmap it first so the frame holds its final
+// contents, then queue its write-back if it was dirty. The frame stays allocated.
+void evict_frame(struct page_table *pt, struct policy *policy, int frame)
+{
+    struct frame_info *fi = frame_table_info(ft, frame);
+    int victim = fi->page;
+    struct space *s = page_space(victim);
+    int match;
 
-    if (!disk)
+    if (dedup)
     {
-        fprintf(stderr, "couldn't create virtual disk: %s\n", strerror(errno));
-        return 1;
+        unshare_frame(frame);
+    }
+    // once unmapped the fast path leaves the frame alone, so its flags hold from here
+    lock_page(victim);
+    space_set_entry(victim, 0, 0);
+    unlock_page(victim);
+    evictions++;
+    s->evictions++;
+    s->resident--;
+    if (!(fi->flags & FRAME_DIRTY))
+    {
+        clean_evictions++;
     }
+    else
+    {
+        char *data = frame_data(pt, frame);
 
-    struct page_table *pt = page_table_create(npages, nframes, page_fault_handler);
+        __atomic_sub_fetch(&dirty_frames, 1, __ATOMIC_RELAXED);
+        if (page_is_zero(data, page_size))
+        {
+            page_zero[victim] = 1;
+            zero_drops++;
+            if (swap_log)
+            {
+                swap_log_discard(swap_log, victim);
+            }
+        }
+        else if (dedup && swap_log && (match = dedup_lookup(dedup, data)) >= 0 &&
+                 swap_log_share(swap_log, victim, frame_table_page(ft, match)) == 0)
+        {
+            // the same bytes are on disk already, in the block of the clean page in "match"
+            page_zero[victim] = 0;
+            dedup_skips++;
+        }
+        else if (zswap && zswap_store(zswap, victim, data) == 0)
+        {
+            // the page only leaves the pool dirty, so its copy on disk is dead
+            if (swap_log)
+            {
+                swap_log_discard(swap_log, victim);
+            }
+        }
+        else
+        {
+            queue_writeback(pt, policy, victim, data);
 
-    if (!pt)
+            if (cluster_max > 0)
+            {
+                cluster_writes_from(pt, policy, victim, -1);
+                cluster_writes_from(pt, policy, victim, 1);
+            }
+        }
+    }
+    if (fi->flags & FRAME_PREFETCHED)
     {
-        fprintf(stderr, "couldn't create page table: %s\n", strerror(errno));
-        return 1;
+        readahead_on_waste(ra, victim);
     }
+    policy_on_evict(s->policy, victim, frame);
+    frame_table_unmap(ft, frame);
+}
+
+// queue the read of "page" into "frame"; it is mapped with "bits" by flush_io
+void load_page(struct page_table *pt, struct policy *policy, int page, int frame, int bits)
+{
+    miss_reported[page] = 0;
 
-    char *virtmem = page_table_get_virtmem(pt);
+    // a write-back of this very page may still be queued: it must land first
+    for (int i = 0; i < io->nbatch; i++)
+    {
+        if (io->batch[i].op == DISK_OP_WRITE && io->batch[i].block == page)
+        {
+            flush_io(pt, policy, 0);
+            break;
+        }
+    }
 
-    // run the chosen program
-    if (!strcmp(program, "alpha"))
+    if (io->nloads == io_max)
     {
-        alpha_program(virtmem, npages * PAGE_SIZE);
+        flush_io(pt, policy, 0);
     }
-    else if (!strcmp(program, "beta"))
+
+    // a page taken from the compressed pool is newer than its copy on disk
+    char *data = frame_data(pt, frame);
+    int dirty = zswap && zswap_load(zswap, page, data) == 0;
+    if (!dirty && page_zero[page])
     {
-        beta_program(virtmem, npages * PAGE_SIZE);
+        memset(data, 0, page_size);
+        zero_fills++;
     }
-    else if (!strcmp(program, "gamma"))
+    else if (!dirty)
     {
-        gamma_program(virtmem, npages * PAGE_SIZE);
+        queue_io(pt, policy, DISK_OP_READ, page, data);
+        disk_reads++;
+        page_space(page)->disk_reads++;
     }
-    else if (!strcmp(program, "delta"))
+    io->loads[io->nloads++] = (struct pending_load){page, frame, bits};
+    page_busy[page] = 1;
+
+    frame_table_map(ft, frame, page);
+    frame_table_info(ft, frame)->age = page_faults;
+    frame_table_info(ft, frame)->pins++;
+    struct space *s = page_space(page);
+    if (++s->resident > s->peak)
     {
-        delta_program(virtmem, npages * PAGE_SIZE);
+        s->peak = s->resident;
     }
-    else
+    if (dirty)
     {
-        fprintf(stderr, "unknown program: %s\n", argv[4]);
-        return 1;
+        frame_table_info(ft, frame)->flags |= FRAME_DIRTY;
+        __atomic_add_fetch(&dirty_frames, 1, __ATOMIC_RELAXED);
     }
 
-    printf("Summary: Page Faults - %d | Disk Reads - %d | Disk Writes - %d \n", page_faults, disk_reads, disk_writes);
-    free(frames);
-    page_table_delete(pt);
+    policy_on_load(policy, page, frame);
+}
+
+// the policy's victim for a fault on "page". With local replacement the space's
+// policy only knows the space's pages, but policies that sweep the frames would
+// find the others too: every frame not holding a page of the space is pinned while
+// the policy chooses.
+int choose_victim(struct policy *policy, int page)
+{
+    if (!local_replacement)
+    {
+        return policy_choose_victim(policy, page);
+    }
+
+    struct space *s = page_space(page);
+    int nframes = frame_table_nframes(ft);
+
+    for (int frame = 0; frame < nframes; frame++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        if (fi->page < 0 || page_space(fi->page) != s)
+        {
+            fi->pins++;
+        }
+    }
+    int victim = policy_choose_victim(policy, page);
+    for (int frame = 0; frame < nframes; frame++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        if (fi->page < 0 || page_space(fi->page) != s)
+        {
+            fi->pins--;
+        }
+    }
+    return victim;
+}
+
+// take a free frame for the calling thread. With several handler threads each
+// takes free frames off the frame table FRAME_CACHE at a time, into a cache of its
+// own, pinned so that no policy sweeping the frames picks one as a victim. Once
+// the frame table is out, a thread with an empty cache takes a frame from another
+// thread's before any is evicted. Returns -1 if no frame is free.
+int alloc_frame(void)
+{
+    if (io->nfree == 0)
+    {
+        int n = nthreads > 1 ? FRAME_CACHE : 1;
+
+        if (n > frame_table_nfree(ft))
+        {
+            n = frame_table_nfree(ft);
+        }
+        // handed out last first, so in the order the frame table gives them
+        for (int i = n - 1; i >= 0; i--)
+        {
+            io->free_frames[i] = frame_table_alloc(ft);
+            frame_table_info(ft, io->free_frames[i])->pins++;
+        }
+        io->nfree = n;
+    }
+    for (struct io_context *c = io_contexts; c && io->nfree == 0; c = c->next)
+    {
+        if (c->nfree > 0)
+        {
+            io->free_frames[io->nfree++] = c->free_frames[--c->nfree];
+        }
+    }
+    if (io->nfree == 0)
+    {
+        return -1;
+    }
+
+    int frame = io->free_frames[--io->nfree];
+    frame_table_info(ft, frame)->pins--;
+    return frame;
+}
+
+// find a frame for a page that is about to be loaded: a free one if there is
+// one, and the space is under its quota with local replacement, otherwise the
+// policy's victim, evicted. Returns -1 if every frame it may take is pinned.
+int get_frame(struct page_table *pt, struct policy *policy, int page)
+{
+    struct space *s = page_space(page);
+    int frame = local_replacement && s->resident >= s->quota ? -1 : alloc_frame();
+
+    if (frame < 0)
+    {
+        long start = latency_now();
+
+        frame = choose_victim(policy, page);
+        if (frame >= 0)
+        {
+            if (page_space(frame_table_page(ft, frame)) != s)
+            {
+                page_space(frame_table_page(ft, frame))->stolen++;
+            }
+            evict_frame(pt, policy, frame);
+        }
+        latency_record(LATENCY_EVICT, start);
+    }
+    return frame;
+}
+
+// bring in the pages asked for by readahead, keeping "frame" (the page that was
+// just accessed) pinned so that prefetching cannot evict it. Readahead runs over
+// the pages of every space, so pages of other spaces are left out.
+void prefetch_pages(struct page_table *pt, struct policy *policy, int frame, int count)
+{
+    struct frame_info *fi = frame_table_info(ft, frame);
+    struct space *s = page_space(fi->page);
+    int n = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int page = readahead_pages[i];
+
+        if (page_space(page) == s && frame_table_lookup(ft, page) < 0 && !page_busy[page] &&
+            !(dedup && dedup_frame(dedup, page) >= 0))
+        {
+            readahead_pages[n++] = page;
+        }
+    }
+
+    fi->pins++;
+    for (int i = 0; i < n; i++)
+    {
+        int page = readahead_pages[i];
+
+        policy_on_fault(policy, page);
+        int fetch_frame = get_frame(pt, policy, page);
+        if (fetch_frame < 0)
+        {
+            break;
+        }
+
+        load_page(pt, policy, page, fetch_frame, i == n - 1 ? 0 : PROT_READ);
+        frame_table_info(ft, fetch_frame)->flags |= FRAME_PREFETCHED;
+        readahead_issued(ra, page);
+    }
+    fi->pins--;
+}
+
+// the stream has reached the prefetched "page": the prefetched pages before it
+// along the run, still mapped readable, were read on the way without faulting
+void credit_prefetched(int page)
+{
+    struct space *s = page_space(page);
+    int stride = readahead_stride(ra);
+
+    for (int p = page - stride; stride != 0 && p >= 0 && p < nspaces * space_npages && page_space(p) == s; p -= stride)
+    {
+        int frame = frame_table_lookup(ft, p);
+        int mapped, bits;
+
+        if (frame < 0 || !(frame_table_info(ft, frame)->flags & FRAME_PREFETCHED))
+        {
+            break;
+        }
+        space_get_entry(p, &mapped, &bits);
+        if (bits == 0)
+        {
+            break;
+        }
+
+        struct frame_info *fi = frame_table_info(ft, frame);
+        lock_page(p);
+        fi->flags = (fi->flags & ~FRAME_PREFETCHED) | FRAME_REFERENCED;
+        unlock_page(p);
+        fi->age = page_faults;
+        readahead_used(ra, p);
+    }
+}
+
+// the page in "frame" is being written: it can no longer be shared, and counts
+// towards the cleaner's high-water mark. Called with the page's stripe held.
+void mark_dirty(int frame)
+{
+    struct frame_info *fi = frame_table_info(ft, frame);
+
+    if (!(fi->flags & FRAME_DIRTY))
+    {
+        if (dedup)
+        {
+            unshare_frame(frame);
+        }
+        int dirty = __atomic_add_fetch(&dirty_frames, 1, __ATOMIC_RELAXED);
+        if (cleaner_on && dirty * 100 > cleaner_high * frame_table_nframes(ft))
+        {
+            pthread_cond_signal(&cleaner_wakeup);
+        }
+    }
+    fi->flags |= FRAME_DIRTY | FRAME_REFERENCED;
+}
+
+// a write to a page merged onto "shared": copy the frame into one of the page's
+// own, as for a miss that needs no read
+void break_share(struct page_table *pt, struct policy *policy, int page, int shared)
+{
+    struct space *s = page_space(page);
+
+    if (!miss_reported[page])
+    {
+        if (trace)
+        {
+            trace_write(trace, page, TRACE_WRITE);
+        }
+        policy_on_fault(policy, page);
+    }
+
+    // the shared frame must not be the one evicted to make room for the copy
+    frame_table_info(ft, shared)->pins++;
+    int frame = get_frame(pt, policy, page);
+    frame_table_info(ft, shared)->pins--;
+    if (frame < 0 && io_inflight > 0)
+    {
+        miss_reported[page] = 1;
+        pthread_cond_wait(&io_done, &vm_lock);
+        return;
+    }
+    miss_reported[page] = 0;
+    if (frame < 0)
+    {
+        fprintf(stderr, "%s: no frame can be evicted for page #%d\n", policy->ops->name, page);
+        abort();
+    }
+
+    dedup_unmerge(dedup, page, 1);
+    memcpy(frame_data(pt, frame), frame_data(pt, shared), page_size);
+    frame_table_map(ft, frame, page);
+
+    struct frame_info *fi = frame_table_info(ft, frame);
+    fi->flags = FRAME_DIRTY | FRAME_REFERENCED;
+    fi->age = page_faults;
+    int dirty = __atomic_add_fetch(&dirty_frames, 1, __ATOMIC_RELAXED);
+    if (cleaner_on && dirty * 100 > cleaner_high * frame_table_nframes(ft))
+    {
+        pthread_cond_signal(&cleaner_wakeup);
+    }
+    if (++s->resident > s->peak)
+    {
+        s->peak = s->resident;
+    }
+    policy_on_load(policy, page, frame);
+    space_set_entry(page, frame, PROT_READ | PROT_WRITE);
+    sample_later(pt, policy, frame);
+
+    // the victim evicted for the copy may have a write-back queued
+    flush_io(pt, policy, 1);
+}
+
+void handle_fault(struct page_table *pt, int page, enum page_table_access access)
+{
+    struct space *space = page_table_get_private(pt);
+    struct policy *policy = space->policy;
+    int write = write_intent && access == PAGE_TABLE_ACCESS_WRITE;
+
+    // count number of page faults
+    __atomic_add_fetch(&page_faults, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&space->page_faults, 1, __ATOMIC_RELAXED);
+    page += space->base;
+
+    // another thread is reading the page in, or writing it back: wait for that
+    // and let the access retry
+    if (page_busy[page])
+    {
+        io->busy_waits++;
+        while (page_busy[page])
+        {
+            pthread_cond_wait(&page_ready[page % PAGE_READY_STRIPES], &vm_lock);
+        }
+        return;
+    }
+
+    if (policy->ops->sampled && page_faults % sample_interval == 0)
+    {
+        sample_references(pt, policy);
+    }
+
+    int frame = frame_table_lookup(ft, page);
+    int bits, mapped;
+    space_get_entry(page, &mapped, &bits);
+
+    // merged pages are mapped read-only, so any fault on one is a write
+    if (frame < 0 && dedup && dedup_frame(dedup, page) >= 0)
+    {
+        break_share(pt, policy, page, dedup_frame(dedup, page));
+    }
+    // if the page is not resident
+    else if (frame < 0)
+    {
+        if (!miss_reported[page])
+        {
+            io->demand_misses++;
+            if (trace)
+            {
+                trace_write(trace, page, write ? TRACE_WRITE : TRACE_READ);
+            }
+            if (dedup)
+            {
+                dedup_frames();
+            }
+            policy_on_fault(policy, page);
+        }
+
+        // take a free frame, or evict the policy's victim. Frames pinned by I/O in
+        // flight elsewhere (another thread's, or the cleaner's) come free when it
+        // completes, and the access then retries, without reporting the miss again.
+        if ((frame = get_frame(pt, policy, page)) < 0 && io_inflight > 0)
+        {
+            miss_reported[page] = 1;
+            pthread_cond_wait(&io_done, &vm_lock);
+            return;
+        }
+        if (frame < 0)
+        {
+            fprintf(stderr, "%s: no frame can be evicted for page #%d\n", policy->ops->name, page);
+            abort();
+        }
+
+        // read the new page from the disk and set it in the page table, writable
+        // at once if it is being written
+        if (write)
+        {
+            load_page(pt, policy, page, frame, PROT_READ | PROT_WRITE);
+            lock_page(page);
+            mark_dirty(frame);
+            unlock_page(page);
+            io->write_misses++;
+        }
+        else
+        {
+            load_page(pt, policy, page, frame, PROT_READ);
+        }
+
+        if (ra)
+        {
+            prefetch_pages(pt, policy, frame, readahead_on_miss(ra, page, readahead_pages, readahead_max_window));
+        }
+        flush_io(pt, policy, 1);
+    }
+    else if ((frame_table_info(ft, frame)->flags & FRAME_PREFETCHED) && (bits == 0 || access != PAGE_TABLE_ACCESS_READ))
+    {
+        // first use seen of a page brought in by readahead: the marker at the end of
+        // a batch, a page dropped by reference sampling, or a write to a readable
+        // one. Not a miss, and not a re-reference either, since the policy has only
+        // just seen it loaded.
+        struct frame_info *fi = frame_table_info(ft, frame);
+        int writing = write || bits != 0;
+
+        if (trace && (trace_hits || writing))
+        {
+            trace_write(trace, page, writing ? TRACE_WRITE : TRACE_HIT);
+        }
+        lock_page(page);
+        fi->flags = (fi->flags & ~FRAME_PREFETCHED) | FRAME_REFERENCED;
+        fi->age = page_faults;
+        if (writing)
+        {
+            mark_dirty(frame);
+        }
+        space_set_entry(page, frame, writing ? PROT_READ | PROT_WRITE : PROT_READ);
+        unlock_page(page);
+        if (bits == 0)
+        {
+            sample_later(pt, policy, frame);
+        }
+
+        credit_prefetched(page);
+        prefetch_pages(pt, policy, frame, readahead_on_hit(ra, page, readahead_pages, readahead_max_window));
+        flush_io(pt, policy, 1);
+    }
+    else if (bits == 0)
+    {
+        // access to a resident page dropped to PROT_NONE by reference sampling
+        struct frame_info *fi = frame_table_info(ft, frame);
+        int first_write = write && !(fi->flags & FRAME_DIRTY);
+
+        io->soft_faults++;
+        if (trace && (trace_hits || first_write))
+        {
+            trace_write(trace, page, first_write ? TRACE_WRITE : TRACE_HIT);
+        }
+        lock_page(page);
+        if (write)
+        {
+            mark_dirty(frame);
+        }
+        fi->flags |= FRAME_REFERENCED;
+        fi->age = page_faults;
+        space_set_entry(page, frame, fi->flags & FRAME_DIRTY ? PROT_READ | PROT_WRITE : PROT_READ);
+        unlock_page(page);
+
+        policy_on_access(policy, page, frame);
+        sample_later(pt, policy, frame);
+    }
+    else if (access == PAGE_TABLE_ACCESS_READ)
+    {
+        // a read of a page another thread mapped while this one waited for the
+        // lock: nothing to do but let it retry
+    }
+    else
+    {
+        // write to a resident read-only page: grant write access and remember it is
+        // dirty. Most of these are taken by handle_write_fault before vm_lock.
+        io->write_faults++;
+        if (trace)
+        {
+            trace_write(trace, page, TRACE_WRITE);
+        }
+        lock_page(page);
+        mark_dirty(frame);
+        space_set_entry(page, frame, (PROT_READ | PROT_WRITE));
+        unlock_page(page);
+    }
+}
+
+// the fast path: a write to a resident page mapped read-only needs no frame, no
+// I/O and no policy, only the page's entry and its frame's flags, so it is handled
+// under the page's stripe of page_locks, without vm_lock, and faults of other
+// threads go on meanwhile. Off with page sharing, tracing and sampled policies,
+// which need vm_lock for it. Returns 0, having done nothing, when the fault is
+// anything else, or the thread has yet to fault under vm_lock to get its context.
+int handle_write_fault(struct page_table *pt, int page, enum page_table_access access)
+{
+    struct space *space = page_table_get_private(pt);
+    int frame, bits;
+
+    if (!io || access != PAGE_TABLE_ACCESS_WRITE || dedup || trace || space->policy->ops->sampled)
+    {
+        return 0;
+    }
+
+    page += space->base;
+    lock_page(page);
+    space_get_entry(page, &frame, &bits);
+    // a page being prefetched is first reported to readahead, under vm_lock
+    if (bits != PROT_READ || (frame_table_info(ft, frame)->flags & FRAME_PREFETCHED))
+    {
+        unlock_page(page);
+        return 0;
+    }
+
+    __atomic_add_fetch(&page_faults, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&space->page_faults, 1, __ATOMIC_RELAXED);
+    io->write_faults++;
+    mark_dirty(frame);
+    space_set_entry(page, frame, PROT_READ | PROT_WRITE);
+    unlock_page(page);
+    return 1;
+}
+
+void page_fault_handler(struct page_table *pt, int page, enum page_table_access access)
+{
+    long start = latency_now();
+
+    if (handle_write_fault(pt, page, access))
+    {
+        latency_record(LATENCY_FAULT, start);
+        return;
+    }
+
+    pthread_mutex_lock(&vm_lock);
+    latency_record(LATENCY_LOCK, start);
+    io_context_get();
+    handle_fault(pt, page, access);
+    pthread_mutex_unlock(&vm_lock);
+    latency_record(LATENCY_FAULT, start);
+}
+
+// print the latency histograms on SIGUSR1, which every other thread blocks
+void *latency_reporter(void *arg)
+{
+    int sig;
+
+    while (sigwait(&latency_signals, &sig) == 0)
+    {
+        latency_print(stderr);
+    }
+    return 0;
+}
+
+// whether frame "a" was used more recently than frame "b"; frames of the same age
+// are ordered by number
+int frame_younger(int a, int b)
+{
+    unsigned int age_a = frame_table_info(ft, a)->age;
+    unsigned int age_b = frame_table_info(ft, b)->age;
+
+    return age_a != age_b ? age_a > age_b : a > b;
+}
+
+// restore the heap of "n" frames, youngest on top, after "frames[i]" got older
+void age_heap_down(int *frames, int n, int i)
+{
+    for (;;)
+    {
+        int top = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+
+        if (left < n && frame_younger(frames[left], frames[top]))
+        {
+            top = left;
+        }
+        if (right < n && frame_younger(frames[right], frames[top]))
+        {
+            top = right;
+        }
+        if (top == i)
+        {
+            return;
+        }
+
+        int frame = frames[i];
+        frames[i] = frames[top];
+        frames[top] = frame;
+        i = top;
+    }
+}
+
+// restore the heap after "frames[i]" was added at its end
+void age_heap_up(int *frames, int i)
+{
+    while (i > 0 && frame_younger(frames[i], frames[(i - 1) / 2]))
+    {
+        int frame = frames[i];
+        frames[i] = frames[(i - 1) / 2];
+        frames[(i - 1) / 2] = frame;
+        i = (i - 1) / 2;
+    }
+}
+
+// pick up to "max" unpinned dirty frames, least recently used first, write-protect
+// them and mark them clean. All-zero pages need no write; the others are moved to
+// the front of "frames", their number stored in "nwrite", and stay pinned until
+// their write-back completes, so that the policy cannot evict (and the handler
+// re-read) a page still being written. Returns the number of frames cleaned.
+int cleaner_pick(struct page_table *pt, int *frames, int max, int *nwrite)
+{
+    int nframes = frame_table_nframes(ft);
+    int count = 0;
+
+    // one pass over the frames, keeping the "max" oldest in a heap with the
+    // youngest of them on top, then sorting those oldest first
+    for (int frame = 0; frame < nframes; frame++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        if (!(fi->flags & FRAME_DIRTY) || fi->pins)
+        {
+            continue;
+        }
+
+        if (count < max)
+        {
+            frames[count++] = frame;
+            age_heap_up(frames, count - 1);
+        }
+        else if (count > 0 && frame_younger(frames[0], frame))
+        {
+            frames[0] = frame;
+            age_heap_down(frames, count, 0);
+        }
+    }
+    for (int n = count - 1; n > 0; n--)
+    {
+        int youngest = frames[0];
+
+        frames[0] = frames[n];
+        frames[n] = youngest;
+        age_heap_down(frames, n, 0);
+    }
+
+    *nwrite = 0;
+    for (int i = 0; i < count; i++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frames[i]);
+
+        clean_frame(pt, frames[i]);
+        if (page_is_zero(frame_data(pt, frames[i]), page_size))
+        {
+            page_zero[fi->page] = 1;
+            zero_drops++;
+            if (swap_log)
+            {
+                swap_log_discard(swap_log, fi->page);
+            }
+            continue;
+        }
+        page_zero[fi->page] = 0;
+        fi->pins++;
+        frames[(*nwrite)++] = frames[i];
+    }
+
+    return count;
+}
+
+void *cleaner_main(void *arg)
+{
+    struct page_table *pt = arg;
+    int nframes = frame_table_nframes(ft);
+    int batch = nframes / 8 > 0 ? nframes / 8 : 1;
+    int *frames = malloc(batch * sizeof(int));
+    struct disk_request *reqs = malloc(batch * sizeof(struct disk_request));
+    int *pages = malloc(batch * sizeof(int));
+
+    if (!frames || !reqs || !pages)
+    {
+        fprintf(stderr, "cleaner: out of memory\n");
+        abort();
+    }
+
+    pthread_mutex_lock(&vm_lock);
+    while (!cleaner_stop)
+    {
+        if (dirty_frames * 100 <= cleaner_high * nframes)
+        {
+            pthread_cond_wait(&cleaner_wakeup, &vm_lock);
+            continue;
+        }
+
+        while (!cleaner_stop && dirty_frames * 100 > cleaner_low * nframes)
+        {
+            int nwrite;
+            if (cleaner_pick(pt, frames, batch, &nwrite) == 0)
+            {
+                // the dirty frames are all pinned by faults' I/O in flight: wait for
+                // some to come free rather than spin holding the lock they need
+                pthread_cond_wait(io_inflight > 0 ? &io_done : &cleaner_wakeup, &vm_lock);
+                break;
+            }
+
+            for (int i = 0; i < nwrite; i++)
+            {
+                reqs[i].op = DISK_OP_WRITE;
+                reqs[i].block = frame_table_page(ft, frames[i]);
+                reqs[i].data = frame_data(pt, frames[i]);
+                reqs[i].done = 0;
+            }
+            place_requests(reqs, nwrite, pages);
+            io_inflight++;
+            pthread_mutex_unlock(&vm_lock);
+
+            // a write fault may re-dirty a page mid-write; it is then simply written again later
+            disk_submit(cleaner_disk, reqs, nwrite);
+            disk_wait(cleaner_disk);
+
+            struct timespec pause = {0, (long)nwrite * 1000000000L / cleaner_rate};
+            pause.tv_sec = pause.tv_nsec / 1000000000L;
+            pause.tv_nsec %= 1000000000L;
+
+            pthread_mutex_lock(&vm_lock);
+            release_requests(reqs, nwrite);
+            for (int i = 0; i < nwrite; i++)
+            {
+                frame_table_info(ft, frames[i])->pins--;
+                page_space(pages[i])->disk_writes++;
+            }
+            io_inflight--;
+            pthread_cond_broadcast(&io_done);
+            cleaner_writes += nwrite;
+            disk_writes += nwrite;
+
+            pthread_mutex_unlock(&vm_lock);
+            nanosleep(&pause, 0);
+            pthread_mutex_lock(&vm_lock);
+        }
+    }
+    pthread_mutex_unlock(&vm_lock);
+
+    free(frames);
+    free(reqs);
+    free(pages);
+    return 0;
+}
+
+// clean the log's segments while it is short of free ones: read the live blocks
+// of the segment chosen, in disk order, and write them out together
+void *compactor_main(void *arg)
+{
+    int max = swap_log_segment_blocks(swap_log);
+    int *pages = malloc(max * sizeof(int));
+    int *from = malloc(max * sizeof(int));
+    int *to = malloc(max * sizeof(int));
+    struct disk_request *reqs = malloc(max * sizeof(struct disk_request));
+    char *data = aligned_alloc(BLOCK_SIZE, (size_t)max * page_size);
+
+    if (!pages || !from || !to || !reqs || !data)
+    {
+        fprintf(stderr, "compactor: out of memory\n");
+        abort();
+    }
+
+    pthread_mutex_lock(&vm_lock);
+    while (!compactor_stop)
+    {
+        int count;
+
+        // without a segment to clean, wait for blocks to go stale or reads to finish
+        if (!swap_log_needs_cleaning(swap_log) || (count = swap_log_clean_start(swap_log, pages, from, to)) < 0)
+        {
+            pthread_cond_wait(&compactor_wakeup, &vm_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&vm_lock);
+
+        for (int i = 0; i < count; i++)
+        {
+            reqs[i] = (struct disk_request){DISK_OP_READ, from[i], &data[(size_t)i * page_size], 0, 0};
+        }
+        qsort(reqs, count, sizeof(struct disk_request), compare_requests);
+        disk_submit(compactor_disk, reqs, count);
+        disk_wait(compactor_disk);
+
+        for (int i = 0; i < count; i++)
+        {
+            reqs[i] = (struct disk_request){DISK_OP_WRITE, to[i], &data[(size_t)i * page_size], 0, 0};
+        }
+        disk_submit(compactor_disk, reqs, count);
+        disk_wait(compactor_disk);
+
+        pthread_mutex_lock(&vm_lock);
+        swap_log_clean_done(swap_log, to, count);
+        pthread_cond_broadcast(&log_space);
+    }
+    pthread_mutex_unlock(&vm_lock);
+
+    free(pages);
+    free(from);
+    free(to);
+    free(reqs);
+    free(data);
+    return 0;
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// restore the snapshot in "snapshot_restore" into the free frames, the pages used
+// most recently first while there is room. Dirty pages come with the snapshot, and
+// those left over are written to their disk blocks; the clean ones are read back
+// from the disk in a single batch, which the disk sorts and merges into runs. The
+// policies are then told of the pages as loads, the oldest first, and the pages
+// are mapped. Returns -1 on failure.
+int restore_snapshot(struct page_table *pt, int npages)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct snapshot_reader *r = snapshot_reader_open(snapshot_restore, npages, page_size, page_zero);
+    if (!r)
+    {
+        fprintf(stderr, "couldn't restore snapshot %s: %s\n", snapshot_restore,
+                errno == EINVAL ? "it is of another number of pages or page size" : strerror(errno));
+        return -1;
+    }
+
+    int nframes = frame_table_nframes(ft);
+    struct disk_request *reqs = malloc(nframes * sizeof(struct disk_request));
+    int *frames = malloc(nframes * sizeof(int));
+    char *spill = aligned_alloc(page_size, page_size);
+    struct disk *d = disk_clone(disk);
+    int nreqs = 0;
+    int result = -1;
+
+    if (!reqs || !frames || !spill || !d)
+    {
+        fprintf(stderr, "couldn't restore snapshot %s: %s\n", snapshot_restore, strerror(errno));
+        goto done;
+    }
+
+    for (;;)
+    {
+        int frame = frame_table_nfree(ft) > 0 ? frame_table_alloc(ft) : -1;
+        char *data = frame < 0 ? spill : frame_data(pt, frame);
+        int page, flags;
+
+        result = snapshot_read(r, &page, &flags, data);
+        if (result <= 0)
+        {
+            if (frame >= 0)
+            {
+                frame_table_free(ft, frame);
+            }
+            break;
+        }
+
+        struct space *s = page_space(page);
+        if (frame < 0 || frame_table_lookup(ft, page) >= 0 || (local_replacement && s->resident == s->quota))
+        {
+            // no room for it: its disk block must be brought up to date
+            if (flags & FRAME_DIRTY)
+            {
+                disk_write(d, page, data);
+                page_zero[page] = 0;
+                restored_spills++;
+            }
+            if (frame >= 0)
+            {
+                frame_table_free(ft, frame);
+            }
+            continue;
+        }
+
+        frame_table_map(ft, frame, page);
+        frame_table_info(ft, frame)->flags = flags & (FRAME_DIRTY | FRAME_REFERENCED);
+        if (flags & FRAME_DIRTY)
+        {
+            dirty_frames++;
+            restored_dirty++;
+        }
+        else if (page_zero[page])
+        {
+            memset(frame_data(pt, frame), 0, page_size);
+        }
+        else
+        {
+            reqs[nreqs++] = (struct disk_request){DISK_OP_READ, page, frame_data(pt, frame), 0, 0};
+        }
+        if (++s->resident > s->peak)
+        {
+            s->peak = s->resident;
+        }
+        frames[restored_pages++] = frame;
+    }
+    if (result < 0)
+    {
+        fprintf(stderr, "couldn't restore snapshot %s: it is corrupt\n", snapshot_restore);
+        goto done;
+    }
+
+    disk_submit(d, reqs, nreqs);
+    disk_wait(d);
+    restore_stats = disk_get_stats(d);
+
+    for (int i = restored_pages - 1; i >= 0; i--)
+    {
+        struct frame_info *fi = frame_table_info(ft, frames[i]);
+        struct policy *policy = page_space(fi->page)->policy;
+
+        policy_on_fault(policy, fi->page);
+        policy_on_load(policy, fi->page, frames[i]);
+        space_set_entry(fi->page, frames[i], fi->flags & FRAME_DIRTY ? PROT_READ | PROT_WRITE : PROT_READ);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    restore_seconds = elapsed_seconds(&start, &end);
+
+done:
+    snapshot_reader_close(r);
+    if (d)
+    {
+        disk_close(d);
+    }
+    free(reqs);
+    free(frames);
+    free(spill);
+    return result < 0 ? -1 : 0;
+}
+
+static int compare_frame_age(const void *a, const void *b)
+{
+    unsigned int age_a = frame_table_info(ft, *(const int *)a)->age;
+    unsigned int age_b = frame_table_info(ft, *(const int *)b)->age;
+
+    return age_a < age_b ? 1 : age_a > age_b ? -1 : 0;
+}
+
+// save the resident pages to "snapshot_save", used most recently first, leaving out
+// pages readahead brought in that were never used. With the userfaultfd backend the
+// live copy of a writable page is in virtual memory, so writable pages are
+// write-protected first, which copies them back into their frames.
+int save_snapshot(struct page_table *pt, int npages)
+{
+    int nframes = frame_table_nframes(ft);
+    int *frames = malloc(nframes * sizeof(int));
+    struct snapshot_writer *w = 0;
+    struct timespec start, end;
+    int count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&vm_lock);
+    for (int frame = 0; frames && frame < nframes; frame++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frame);
+
+        if (fi->page >= 0 && !(fi->flags & FRAME_PREFETCHED))
+        {
+            frames[count++] = frame;
+        }
+    }
+    qsort(frames, count, sizeof(int), compare_frame_age);
+
+    if (frames)
+    {
+        w = snapshot_writer_create(snapshot_save, npages, page_size, count, page_zero);
+    }
+    for (int i = 0; w && i < count; i++)
+    {
+        struct frame_info *fi = frame_table_info(ft, frames[i]);
+        int frame, bits;
+
+        space_get_entry(fi->page, &frame, &bits);
+        if (bits & PROT_WRITE)
+        {
+            space_set_entry(fi->page, frames[i], PROT_READ);
+        }
+        snapshot_write(w, fi->page, fi->flags & (FRAME_DIRTY | FRAME_REFERENCED), frame_data(pt, frames[i]));
+        saved_dirty += (fi->flags & FRAME_DIRTY) != 0;
+    }
+    pthread_mutex_unlock(&vm_lock);
+
+    if (w)
+    {
+        saved_bytes = snapshot_writer_bytes(w);
+        saved_pages = count;
+    }
+    free(frames);
+    if (!w || snapshot_writer_close(w) < 0)
+    {
+        fprintf(stderr, "couldn't save snapshot %s: %s\n", snapshot_save, strerror(errno));
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    save_seconds = elapsed_seconds(&start, &end);
+    return 0;
+}
+
+// run the program of a space. Programs running side by side run their parallel
+// variants, on one thread each without -T: the programs draw from lrand48, whose
+// stream they would otherwise share.
+void *space_main(void *arg)
+{
+    struct space *s = arg;
+    char *virtmem = page_table_get_virtmem(s->pt);
+    size_t length = (size_t)space_npages * page_size;
+    int threads = nthreads ? nthreads : nspaces > 1;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!strcmp(s->program, "alpha"))
+    {
+        threads ? alpha_program_parallel(virtmem, length, threads) : alpha_program(virtmem, length);
+    }
+    else if (!strcmp(s->program, "beta"))
+    {
+        threads ? beta_program_parallel(virtmem, length, threads) : beta_program(virtmem, length);
+    }
+    else if (!strcmp(s->program, "gamma"))
+    {
+        threads ? gamma_program_parallel(virtmem, length, threads) : gamma_program(virtmem, length);
+    }
+    else
+    {
+        threads ? delta_program_parallel(virtmem, length, threads) : delta_program(virtmem, length);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    s->seconds = elapsed_seconds(&start, &end);
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("use: virtmem [-b sigsegv|uffd] [-i uring|threads|sync] [-D file|direct|mmap|ram] [-d diskfile] [-p page-size] [-s sample-interval] [-r readahead-window] [-w high[:low[:rate]]] [-c cluster] [-z pool-percent] [-L segment[:spare-percent]] [-K scan-frames] [-W] [-S snapshot] [-U snapshot] [-t tracefile [-H]] [-T nthreads] [-l] [-R global|local] [-q quota,...] <npages> <nframes> <%s> <alpha|beta|gamma|delta>[,...]\n", policy_names());
+}
+
+int main(int argc, char *argv[])
+{
+    enum page_table_backend backend = PAGE_TABLE_BACKEND_SIGSEGV;
+    enum disk_engine engine = DISK_ENGINE_AUTO;
+    char *quotas = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:i:D:d:p:s:r:w:c:z:L:K:WS:U:t:HT:lR:q:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            if (!strcmp(optarg, "sigsegv"))
+            {
+                backend = PAGE_TABLE_BACKEND_SIGSEGV;
+            }
+            else if (!strcmp(optarg, "uffd"))
+            {
+                backend = PAGE_TABLE_BACKEND_USERFAULTFD;
+            }
+            else
+            {
+                printf("unknown fault backend: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'i':
+            if (!strcmp(optarg, "uring"))
+            {
+                engine = DISK_ENGINE_URING;
+            }
+            else if (!strcmp(optarg, "threads"))
+            {
+                engine = DISK_ENGINE_THREADS;
+            }
+            else if (!strcmp(optarg, "sync"))
+            {
+                engine = DISK_ENGINE_SYNC;
+            }
+            else
+            {
+                printf("unknown disk engine: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'D':
+            if (!strcmp(optarg, "file"))
+            {
+                disk_backend = DISK_BACKEND_FILE;
+            }
+            else if (!strcmp(optarg, "direct"))
+            {
+                disk_backend = DISK_BACKEND_DIRECT;
+            }
+            else if (!strcmp(optarg, "mmap"))
+            {
+                disk_backend = DISK_BACKEND_MMAP;
+            }
+            else if (!strcmp(optarg, "ram"))
+            {
+                disk_backend = DISK_BACKEND_RAM;
+            }
+            else
+            {
+                printf("unknown disk backend: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'd':
+            disk_file = optarg;
+            break;
+        case 'p':
+        {
+            char *unit;
+
+            page_size = strtol(optarg, &unit, 10);
+            if (*unit == 'k' || *unit == 'K')
+            {
+                page_size <<= 10;
+            }
+            else if (*unit == 'm' || *unit == 'M')
+            {
+                page_size <<= 20;
+            }
+            if (page_size < PAGE_SIZE || page_size > PAGE_SIZE_MAX || (page_size & (page_size - 1)))
+            {
+                printf("page size must be a power of two from %d to %d bytes (e.g. 64k or 2m)\n", PAGE_SIZE, PAGE_SIZE_MAX);
+                exit(1);
+            }
+            break;
+        }
+        case 's':
+            sample_interval = atoi(optarg);
+            if (sample_interval < 1)
+            {
+                printf("sample interval must be an integer and >= 1\n");
+                exit(1);
+            }
+            break;
+        case 'r':
+            readahead_max_window = atoi(optarg);
+            if (readahead_max_window < 0)
+            {
+                printf("readahead window must be an integer and >= 0\n");
+                exit(1);
+            }
+            break;
+        case 'c':
+            cluster_max = atoi(optarg);
+            if (cluster_max < 0)
+            {
+                printf("cluster size must be an integer and >= 0\n");
+                exit(1);
+            }
+            break;
+        case 'z':
+            zswap_percent = atoi(optarg);
+            if (zswap_percent < 0)
+            {
+                printf("compressed pool size must be an integer and >= 0\n");
+                exit(1);
+            }
+            break;
+        case 'L':
+            sscanf(optarg, "%d:%d", &log_segment, &log_spare);
+            if (log_segment < 1 || log_spare < 0)
+            {
+                printf("log segments must be >= 1 blocks, with spare space >= 0 percent\n");
+                exit(1);
+            }
+            break;
+        case 'K':
+            dedup_scan = atoi(optarg);
+            if (dedup_scan < 1)
+            {
+                printf("frames scanned for sharing must be an integer and >= 1\n");
+                exit(1);
+            }
+            break;
+        case 'W':
+            write_intent = 0;
+            break;
+        case 'S':
+            snapshot_save = optarg;
+            break;
+        case 'U':
+            snapshot_restore = optarg;
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'H':
+            trace_hits = 1;
+            break;
+        case 'l':
+            latency = 1;
+            break;
+        case 'R':
+            if (!strcmp(optarg, "global"))
+            {
+                local_replacement = 0;
+            }
+            else if (!strcmp(optarg, "local"))
+            {
+                local_replacement = 1;
+            }
+            else
+            {
+                printf("unknown replacement scope: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'q':
+            quotas = optarg;
+            local_replacement = 1;
+            break;
+        case 'T':
+            nthreads = atoi(optarg);
+            if (nthreads < 1)
+            {
+                printf("thread count must be an integer and >= 1\n");
+                exit(1);
+            }
+            break;
+        case 'w':
+            cleaner_on = 1;
+            cleaner_low = -1;
+            sscanf(optarg, "%d:%d:%d", &cleaner_high, &cleaner_low, &cleaner_rate);
+            if (cleaner_low < 0)
+            {
+                cleaner_low = cleaner_high / 2;
+            }
+            if (cleaner_high < 0 || cleaner_high > 100 || cleaner_low > cleaner_high || cleaner_rate < 1)
+            {
+                printf("write-back watermarks must satisfy 0 <= low <= high <= 100, and rate >= 1\n");
+                exit(1);
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 4)
+    {
+        usage();
+        return 1;
+    }
+    argv += optind - 1;
+
+    int npages = atoi(argv[1]);
+    int nframes = atoi(argv[2]);
+    const char *alg = argv[3];
+
+    // check that npages and nframes are positive
+    if (npages < 1)
+    {
+        printf("npages must be an integer and >= 1\n");
+        exit(1);
+    }
+    if (nframes < 1)
+    {
+        printf("nframes must be an integer and >= 1\n");
+        exit(1);
+    }
+    // check that alg is a valid replacement policy
+    if (!policy_lookup(alg))
+    {
+        printf("unknown replacement policy: %s\n", argv[3]);
+        exit(1);
+    }
+
+    // one address space of "npages" pages for each program, sharing the frames
+    nspaces = 1;
+    for (char *c = argv[4]; *c; c++)
+    {
+        nspaces += *c == ',';
+    }
+    spaces = calloc(nspaces, sizeof(struct space));
+    if (!spaces)
+    {
+        printf("couldn't allocate address spaces\n");
+        return 1;
+    }
+    space_npages = npages;
+    for (int i = 0; i < nspaces; i++)
+    {
+        spaces[i].program = strtok(i ? 0 : argv[4], ",");
+        spaces[i].base = i * npages;
+        if (!spaces[i].program || (strcmp(spaces[i].program, "alpha") && strcmp(spaces[i].program, "beta") &&
+                                   strcmp(spaces[i].program, "gamma") && strcmp(spaces[i].program, "delta")))
+        {
+            fprintf(stderr, "unknown program: %s\n", spaces[i].program ? spaces[i].program : "");
+            return 1;
+        }
+    }
+    // pages are numbered across the spaces, and their numbers are ints
+    if ((long)npages * nspaces > INT_MAX)
+    {
+        printf("the programs' pages must number fewer than 2^31 in all\n");
+        exit(1);
+    }
+    int total_pages = npages * nspaces;
+
+    // local replacement splits the frames evenly unless given a quota for each space
+    if (local_replacement)
+    {
+        char *q = quotas;
+        int total = 0;
+
+        for (int i = 0; i < nspaces; i++)
+        {
+            spaces[i].quota = nframes / nspaces + (i < nframes % nspaces);
+            if (q)
+            {
+                spaces[i].quota = strtol(q, &q, 10);
+                if (*q != (i < nspaces - 1 ? ',' : 0))
+                {
+                    spaces[i].quota = 0;
+                }
+                q++;
+            }
+            if (spaces[i].quota < 1)
+            {
+                printf("quotas must be one integer >= 1 for each of the %d programs\n", nspaces);
+                exit(1);
+            }
+            total += spaces[i].quota;
+        }
+        if (total > nframes)
+        {
+            printf("quotas add up to %d frames, more than the %d there are\n", total, nframes);
+            exit(1);
+        }
+    }
+
+    if (nspaces > 1 && !strcmp(alg, "opt"))
+    {
+        printf("opt runs one program at a time: its reference string is recorded by running it alone\n");
+        exit(1);
+    }
+
+    // a snapshot leaves the clean pages on disk, and knows nothing of the log's
+    // placement or the compressed pool
+    if ((snapshot_save || snapshot_restore) && disk_backend == DISK_BACKEND_RAM)
+    {
+        printf("snapshots need a disk kept in a file, not in memory\n");
+        exit(1);
+    }
+    if ((snapshot_save || snapshot_restore) && (log_segment > 0 || zswap_percent > 0))
+    {
+        printf("snapshots cannot be taken with the swap log or the compressed pool\n");
+        exit(1);
+    }
+    if (snapshot_restore && !strcmp(alg, "opt"))
+    {
+        printf("opt cannot restore a snapshot: its reference string is recorded from a cold start\n");
+        exit(1);
+    }
+
+    // the signal is blocked before any thread starts, so that only the reporter takes it
+    if (latency)
+    {
+        pthread_t reporter;
+
+        sigemptyset(&latency_signals);
+        sigaddset(&latency_signals, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &latency_signals, 0);
+        if (pthread_create(&reporter, 0, latency_reporter, 0) != 0)
+        {
+            fprintf(stderr, "couldn't start latency reporter: %s\n", strerror(errno));
+            return 1;
+        }
+        pthread_detach(reporter);
+        latency_enable();
+    }
+
+    // opt must know the program's references before it runs. A child process makes
+    // a first pass with two frames under fifo, tracing every fault; we wait for it
+    // and run the program again under opt.
+    if (!strcmp(alg, "opt"))
+    {
+        char opt_trace[64];
+        int status, trace_npages;
+
+        snprintf(opt_trace, sizeof(opt_trace), "/tmp/virtmem-opt-%d.trace", (int)getpid());
+        fflush(stdout);
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            if (!freopen("/dev/null", "w", stdout))
+            {
+                _exit(1);
+            }
+            alg = "fifo";
+            nframes = 2;
+            trace_file = opt_trace;
+            trace_hits = 0;
+            readahead_max_window = 0;
+            cleaner_on = 0;
+            zswap_percent = 0;
+            cluster_max = 0;
+            log_segment = 0;
+            dedup_scan = 0;
+            snapshot_save = 0;
+        }
+        else
+        {
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+                (opt_nrefs = trace_load(opt_trace, &trace_npages, &opt_pages, 0)) < 0)
+            {
+                fprintf(stderr, "couldn't record the reference string for opt\n");
+                unlink(opt_trace);
+                return 1;
+            }
+            unlink(opt_trace);
+
+            // readahead would report faults ahead of the references opt follows
+            readahead_max_window = 0;
+        }
+    }
+
+    // Pre-allocation of frame table needed for page_fault_handler logic
+    ft = frame_table_create(nframes, total_pages);
+    if (!ft)
+    {
+        printf("couldn't create frame table\n");
+        return 1;
+    }
+
+    // with the log, pages are written wherever it puts them, in a larger disk
+    if (log_segment > 0)
+    {
+        swap_log = swap_log_create(total_pages, log_segment, log_spare);
+        if (!swap_log)
+        {
+            printf("couldn't create swap log\n");
+            return 1;
+        }
+    }
+
+    // a restored snapshot needs the blocks the run that saved it wrote
+    if (snapshot_restore)
+    {
+        disk = disk_reopen(disk_file, total_pages, page_size, engine, disk_backend);
+    }
+    else
+    {
+        disk = disk_open_with_backend(disk_file, swap_log ? swap_log_nblocks(swap_log) : total_pages, page_size, engine, disk_backend);
+    }
+
+    if (!disk)
+    {
+        fprintf(stderr, "couldn't %s virtual disk: %s\n", snapshot_restore ? "reopen" : "create", strerror(errno));
+        return 1;
+    }
+
+    for (int i = 0; i < nspaces; i++)
+    {
+        spaces[i].pt = i ? page_table_create_shared(spaces[0].pt, npages, page_fault_handler)
+                         : page_table_create_with_page_size(npages, nframes, page_size, page_fault_handler, backend);
+        if (!spaces[i].pt)
+        {
+            fprintf(stderr, "couldn't create page table: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+    struct page_table *pt = spaces[0].pt;
+
+    // the fault handler finds its space, and the policy, through the page table.
+    // With local replacement every space has a policy of its own, over its quota.
+    sample_pending = malloc(nframes * sizeof(int));
+    for (int i = 0; i < nspaces; i++)
+    {
+        struct space *s = &spaces[i];
+
+        if (local_replacement)
+        {
+            s->policy = policy_create_with_quota(alg, ft, total_pages, s->quota, unreference_frame, 0);
+        }
+        else
+        {
+            s->policy = i ? spaces[0].policy : policy_create(alg, ft, total_pages, unreference_frame, 0);
+        }
+        if (!s->policy || !sample_pending || (opt_pages && opt_set_references(s->policy, opt_pages, opt_nrefs, 1) < 0))
+        {
+            printf("couldn't create %s policy\n", alg);
+            return 1;
+        }
+        page_table_set_private(s->pt, s);
+    }
+    struct policy *policy = spaces[0].policy;
+
+    page_zero = malloc(total_pages);
+    if (!page_zero)
+    {
+        printf("couldn't allocate zero page map\n");
+        return 1;
+    }
+    memset(page_zero, 1, total_pages);
+
+    if (dedup_scan > 0)
+    {
+        dedup = dedup_create(total_pages, nframes, page_size, page_table_get_physmem(pt));
+        if (!dedup)
+        {
+            printf("couldn't create page sharing index\n");
+            return 1;
+        }
+    }
+
+    // readahead is on if asked for, or by default with policies built around it.
+    // Prefetched pages waiting to be used may take at most a quarter of memory.
+    if (readahead_max_window < 0)
+    {
+        readahead_max_window = policy->ops->readahead ? 32 : 0;
+    }
+    if (readahead_max_window > 0)
+    {
+        ra = readahead_create(total_pages, readahead_max_window, nframes / 4);
+        readahead_pages = malloc(readahead_max_window * sizeof(int));
+        if (!ra || !readahead_pages)
+        {
+            printf("couldn't create readahead engine\n");
+            return 1;
+        }
+    }
+
+    // each page loaded may evict a victim, written along with its clustered neighbours
+    io_max = 1 + readahead_max_window;
+    io_batch_max = io_max * (2 + 2 * cluster_max);
+    page_busy = calloc(total_pages, 1);
+    miss_reported = calloc(total_pages, 1);
+    if (!page_busy || !miss_reported)
+    {
+        printf("couldn't allocate busy page map\n");
+        return 1;
+    }
+    for (int i = 0; i < PAGE_READY_STRIPES; i++)
+    {
+        pthread_cond_init(&page_ready[i], 0);
+        pthread_mutex_init(&page_locks[i], 0);
+    }
+
+    // with the userfaultfd backend, as many handler threads as program threads
+    for (int i = 0; i < nspaces; i++)
+    {
+        if (nthreads > 1 && page_table_add_fault_threads(spaces[i].pt, nthreads - 1) < 0)
+        {
+            fprintf(stderr, "couldn't start fault handler threads: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    if (zswap_percent > 0)
+    {
+        zswap = zswap_create(total_pages, page_size, (long)nframes * page_size * zswap_percent / 100, spill_page, pt);
+        if (!zswap)
+        {
+            printf("couldn't create compressed pool\n");
+            return 1;
+        }
+    }
+
+    if (trace_file)
+    {
+        trace = trace_writer_create(trace_file, total_pages);
+        if (!trace)
+        {
+            fprintf(stderr, "couldn't create trace file %s: %s\n", trace_file, strerror(errno));
+            return 1;
+        }
+    }
+
+    if (snapshot_restore && restore_snapshot(pt, total_pages) < 0)
+    {
+        return 1;
+    }
+
+    // the cleaner pins frames while it writes them, so it needs a few to spare
+    if (cleaner_on && nframes < 4)
+    {
+        printf("write-back daemon needs at least 4 frames, disabled\n");
+        cleaner_on = 0;
+    }
+    if (cleaner_on)
+    {
+        cleaner_disk = disk_clone(disk);
+        if (!cleaner_disk || pthread_create(&cleaner_thread, 0, cleaner_main, pt) != 0)
+        {
+            fprintf(stderr, "couldn't start write-back daemon: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    if (swap_log)
+    {
+        compactor_disk = disk_clone(disk);
+        if (!compactor_disk || pthread_create(&compactor_thread, 0, compactor_main, 0) != 0)
+        {
+            fprintf(stderr, "couldn't start log compactor: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // run the chosen program, or several side by side, each on a thread of its own
+    if (nspaces == 1)
+    {
+        space_main(&spaces[0]);
+    }
+    else
+    {
+        for (int i = 0; i < nspaces; i++)
+        {
+            if (pthread_create(&spaces[i].thread, 0, space_main, &spaces[i]) != 0)
+            {
+                fprintf(stderr, "couldn't start program %s: %s\n", spaces[i].program, strerror(errno));
+                return 1;
+            }
+        }
+        for (int i = 0; i < nspaces; i++)
+        {
+            pthread_join(spaces[i].thread, 0);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = elapsed_seconds(&start, &end);
+
+    if (cleaner_on)
+    {
+        pthread_mutex_lock(&vm_lock);
+        cleaner_stop = 1;
+        pthread_cond_signal(&cleaner_wakeup);
+        pthread_mutex_unlock(&vm_lock);
+        pthread_join(cleaner_thread, 0);
+        cleaner_stats = disk_get_stats(cleaner_disk);
+        disk_close(cleaner_disk);
+    }
+    if (swap_log)
+    {
+        pthread_mutex_lock(&vm_lock);
+        compactor_stop = 1;
+        pthread_cond_signal(&compactor_wakeup);
+        pthread_mutex_unlock(&vm_lock);
+        pthread_join(compactor_thread, 0);
+        compactor_stats = disk_get_stats(compactor_disk);
+        disk_close(compactor_disk);
+    }
+
+    if (snapshot_save && save_snapshot(pt, total_pages) < 0)
+    {
+        return 1;
+    }
+
+    // with the userfaultfd backend the handler thread may still be finishing the
+    // last fault; deleting the page table waits for it
+    enum page_table_memory memory = page_table_get_memory(pt);
+    for (int i = 0; i < nspaces; i++)
+    {
+        page_table_delete(spaces[i].pt);
+    }
+
+    sum_fault_counts();
+    printf("Summary: Page Faults - %d | Disk Reads - %d | Disk Writes - %d \n", page_faults, disk_reads, disk_writes);
+    printf("Timing: %.6f s | %.0f faults/sec | %s disk I/O", seconds, seconds > 0 ? page_faults / seconds : 0.0,
+           disk_engine_name(disk_get_engine(disk)));
+    if (disk_backend != DISK_BACKEND_FILE)
+    {
+        printf(" | %s disk", disk_backend_name(disk_backend));
+    }
+    printf("\n");
+    if (policy->ops->sampled)
+    {
+        printf("Reference sampling: every %d faults | %d re-faults\n", sample_interval, soft_faults);
+    }
+    struct disk_stats ds = cleaner_stats;
+    ds.reads += compactor_stats.reads;
+    ds.read_ops += compactor_stats.read_ops;
+    ds.writes += compactor_stats.writes;
+    ds.write_ops += compactor_stats.write_ops;
+    ds.sequential_writes += compactor_stats.sequential_writes;
+    for (struct io_context *c = io_contexts; c; c = c->next)
+    {
+        struct disk_stats cs = disk_get_stats(c->disk);
+
+        ds.reads += cs.reads;
+        ds.read_ops += cs.read_ops;
+        ds.writes += cs.writes;
+        ds.write_ops += cs.write_ops;
+        ds.sequential_writes += cs.sequential_writes;
+    }
+    if (page_size != PAGE_SIZE)
+    {
+        printf("Pages: %d KiB | %s physical memory | %.1f MiB virtual, %.1f MiB physical\n", page_size / 1024,
+               memory == PAGE_TABLE_MEMORY_HUGETLB ? "hugetlbfs" : memory == PAGE_TABLE_MEMORY_THP ? "transparent huge page" : "normal",
+               (double)total_pages * page_size / (1 << 20), (double)nframes * page_size / (1 << 20));
+    }
+    if (nspaces > 1 || local_replacement)
+    {
+        printf("Address spaces: %d of %d pages sharing %d frames | %s replacement\n", nspaces, npages, nframes,
+               local_replacement ? "local" : "global");
+        for (int i = 0; i < nspaces; i++)
+        {
+            struct space *s = &spaces[i];
+
+            printf("Space %d: %s | held %d frames at most", i, s->program, s->peak);
+            if (local_replacement)
+            {
+                printf(" of %d", s->quota);
+            }
+            printf(" | Page Faults - %d | Disk Reads - %d | Disk Writes - %d | %d evicted, %d for other spaces | %.6f s\n",
+                   s->page_faults, s->disk_reads, s->disk_writes, s->evictions, s->stolen, s->seconds);
+        }
+    }
+    if (nthreads)
+    {
+        int handlers = 0;
+
+        for (struct io_context *c = io_contexts; c; c = c->next)
+        {
+            handlers++;
+        }
+        printf("Threads: %d program threads | %d handling faults | %d faults waited for another thread's I/O\n",
+               nthreads, handlers, busy_waits);
+    }
+    printf("Zero pages: %d reads skipped | %d writes skipped\n", zero_fills, zero_drops);
+    printf("Write faults: %d misses mapped writable at once | %d writes to read-only pages%s\n", write_misses, write_faults,
+           write_intent ? "" : " | write intent ignored");
+    printf("Disk I/O: %d reads in %d ops | %d writes in %d ops, %d sequential | %.6f s waiting in faults\n",
+           ds.reads, ds.read_ops, ds.writes, ds.write_ops, ds.sequential_writes, io_seconds);
+    if (cluster_max > 0)
+    {
+        printf("Write clustering: up to %d pages either side | %d neighbours written with victims\n", cluster_max, cluster_writes);
+    }
+    if (zswap)
+    {
+        struct zswap_stats zs = zswap_get_stats(zswap);
+
+        printf("Compressed swap: %d%% of memory | %d pages stored, %d rejected, %d spilled | ratio %.1f:1 | %d of %d page-ins served (%.1f%%)\n",
+               zswap_percent, zs.stores, zs.rejects, zs.spills,
+               zs.stored_out ? (double)zs.stored_in / zs.stored_out : 0.0, zs.hits, zs.hits + zs.misses,
+               zs.hits + zs.misses ? 100.0 * zs.hits / (zs.hits + zs.misses) : 0.0);
+        zswap_delete(zswap);
+    }
+    if (dedup)
+    {
+        struct dedup_stats st = dedup_get_stats(dedup);
+
+        printf("Page sharing: %d frames scanned per miss | %ld hashed, %ld pages merged | %d pages on %d frames now, %d frames saved at most | %ld shares broken by writes, %ld unmapped",
+               dedup_scan, st.scanned, st.merged, st.sharing, st.shared, st.peak, st.broken, st.dropped);
+        if (swap_log)
+        {
+            printf(" | %ld disk blocks shared, %d write-backs skipped", swap_log_get_stats(swap_log).shares, dedup_skips);
+        }
+        printf("\n");
+        dedup_delete(dedup);
+    }
+    if (swap_log)
+    {
+        struct swap_log_stats ls = swap_log_get_stats(swap_log);
+
+        printf("Swap log: %d segments of %d blocks, %d free | %ld pages appended, %ld moved cleaning %d segments | write amplification %.2f | %d writes waited for room\n",
+               ls.segments, log_segment, ls.free, ls.writes, ls.moves, ls.cleaned,
+               ls.writes ? (double)(ls.writes + ls.moves) / ls.writes : 1.0, log_waits);
+        swap_log_delete(swap_log);
+    }
+    if (cleaner_on)
+    {
+        printf("Write-back: %d-%d%% dirty, %d pages/sec | %d pages cleaned | %d of %d evictions found a clean frame (%.1f%%)\n",
+               cleaner_low, cleaner_high, cleaner_rate, cleaner_writes, clean_evictions, evictions,
+               evictions ? 100.0 * clean_evictions / evictions : 0.0);
+    }
+    if (opt_pages)
+    {
+        printf("Optimal: reference string of %ld pages recorded by a first pass with 2 frames\n", opt_nrefs);
+    }
+    if (snapshot_restore)
+    {
+        printf("Warm start: %d pages restored from %s, %d dirty | %d read in %d ops | %d dirty pages without a frame written | %.6f s\n",
+               restored_pages, snapshot_restore, restored_dirty, restore_stats.reads, restore_stats.read_ops, restored_spills, restore_seconds);
+    }
+    if (snapshot_save)
+    {
+        printf("Snapshot: %d pages saved to %s, %d dirty | %.1f KiB | %.6f s\n", saved_pages, snapshot_save, saved_dirty,
+               saved_bytes / 1024.0, save_seconds);
+    }
+    if (trace)
+    {
+        long count = trace_writer_count(trace);
+
+        if (trace_writer_close(trace) < 0)
+        {
+            fprintf(stderr, "couldn't write trace file %s\n", trace_file);
+        }
+        printf("Trace: %ld references%s written to %s\n", count, trace_hits ? ", hits included," : "", trace_file);
+    }
+    if (ra)
+    {
+        struct readahead_stats st = readahead_get_stats(ra);
+
+        printf("Readahead: window %d | issued %d | hits %d | wasted %d | accuracy %.1f%% | coverage %.1f%%\n",
+               readahead_window(ra), st.issued, st.hits, st.wasted,
+               st.issued ? 100.0 * st.hits / st.issued : 0.0,
+               st.hits + demand_misses ? 100.0 * st.hits / (st.hits + demand_misses) : 0.0);
+        readahead_delete(ra);
+        free(readahead_pages);
+    }
+    if (latency)
+    {
+        latency_print(stdout);
+    }
+    for (int i = 0; i < nspaces; i++)
+    {
+        if (local_replacement || i == 0)
+        {
+            policy_delete(spaces[i].policy);
+        }
+    }
+    free(opt_pages);
+    free(sample_pending);
+    free(page_zero);
+    while (io_contexts)
+    {
+        struct io_context *next = io_contexts->next;
+
+        io_context_delete(io_contexts);
+        io_contexts = next;
+    }
+    free(page_busy);
+    free(miss_reported);
+    frame_table_delete(ft);
     disk_close(disk);
+    free(spaces);
 
     return 0;
 }
\ No newline at end of file
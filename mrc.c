@@ -0,0 +1,195 @@
+#include "mrc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SHARDS_MODULUS (1 << 24)
+
+struct mrc
+{
+    int npages;
+    double rate;
+    unsigned int threshold; // pages whose hash is below this are sampled
+
+    long references;
+    long sampled;   // references to sampled pages
+    long cold;      // first references to sampled pages
+    long *hist;     // hist[d]: sampled references at (scaled) stack distance d, up to npages
+    long *tail;     // tail[c]: sampled references at distance greater than c, rebuilt on demand
+    int tail_valid;
+    int max_distance;
+
+    // Fenwick tree over time: slot t is marked while it holds the latest
+    // reference to some page. Time is renumbered when the tree fills up.
+    int *tree;
+    int *owner; // page whose latest reference is in slot t, or -1
+    long *last; // slot of the latest reference to each page, or -1
+    long size;
+    long now;
+};
+
+static unsigned int page_hash(int page)
+{
+    unsigned int x = page;
+
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static void tree_add(struct mrc *m, long t, int v)
+{
+    for (t++; t <= m->size; t += t & -t)
+        m->tree[t] += v;
+}
+
+// marks in slots 0..t
+static long tree_sum(struct mrc *m, long t)
+{
+    long sum = 0;
+
+    for (t++; t > 0; t -= t & -t)
+        sum += m->tree[t];
+    return sum;
+}
+
+// pack the marked slots at the front, keeping their order
+static void compact(struct mrc *m)
+{
+    long k = 0;
+
+    for (long t = 0; t < m->now; t++)
+    {
+        int page = m->owner[t];
+
+        if (page >= 0)
+        {
+            m->owner[k] = page;
+            m->last[page] = k++;
+        }
+    }
+    for (long t = k; t < m->now; t++)
+        m->owner[t] = -1;
+
+    memset(m->tree, 0, (m->size + 1) * sizeof(int));
+    for (long t = 0; t < k; t++)
+        tree_add(m, t, 1);
+    m->now = k;
+}
+
+struct mrc *mrc_create(int npages, double rate)
+{
+    struct mrc *m = calloc(1, sizeof(*m));
+
+    if (!m)
+        return 0;
+
+    m->npages = npages;
+    m->rate = rate > 0 && rate < 1 ? rate : 1;
+    m->threshold = m->rate * SHARDS_MODULUS;
+
+    // at most npages slots are marked, so compacting always frees at least half
+    m->size = 2 * (long)npages + 64;
+    m->hist = calloc(npages + 2, sizeof(long));
+    m->tail = calloc(npages + 2, sizeof(long));
+    m->tree = calloc(m->size + 1, sizeof(int));
+    m->owner = malloc(m->size * sizeof(int));
+    m->last = malloc(npages * sizeof(long));
+    if (!m->hist || !m->tail || !m->tree || !m->owner || !m->last)
+    {
+        mrc_delete(m);
+        return 0;
+    }
+
+    memset(m->owner, -1, m->size * sizeof(int));
+    memset(m->last, -1, npages * sizeof(long));
+
+    return m;
+}
+
+void mrc_delete(struct mrc *m)
+{
+    free(m->hist);
+    free(m->tail);
+    free(m->tree);
+    free(m->owner);
+    free(m->last);
+    free(m);
+}
+
+void mrc_access(struct mrc *m, int page)
+{
+    m->references++;
+    if (m->rate < 1 && page_hash(page) % SHARDS_MODULUS >= m->threshold)
+        return;
+
+    m->sampled++;
+    m->tail_valid = 0;
+    if (m->now == m->size)
+        compact(m);
+
+    long prev = m->last[page];
+
+    if (prev >= 0)
+    {
+        // distinct pages referenced after the previous reference, and the page itself
+        long d = tree_sum(m, m->now - 1) - tree_sum(m, prev) + 1;
+
+        // no distance exceeds npages; a scaled one may, by sampling error
+        if (m->rate < 1)
+            d = d / m->rate;
+        if (d > m->npages)
+            d = m->npages;
+        if (d > m->max_distance)
+            m->max_distance = d;
+
+        m->hist[d]++;
+        tree_add(m, prev, -1);
+        m->owner[prev] = -1;
+    }
+    else
+    {
+        m->cold++;
+    }
+
+    tree_add(m, m->now, 1);
+    m->owner[m->now] = page;
+    m->last[page] = m->now++;
+}
+
+long mrc_references(struct mrc *m)
+{
+    return m->references;
+}
+
+long mrc_misses(struct mrc *m, int nframes)
+{
+    if (!m->sampled)
+        return 0;
+
+    if (!m->tail_valid)
+    {
+        m->tail[m->npages + 1] = 0;
+        for (int d = m->npages; d >= 0; d--)
+            m->tail[d] = m->tail[d + 1] + m->hist[d + 1];
+        m->tail_valid = 1;
+    }
+
+    if (nframes < 0)
+        nframes = 0;
+    if (nframes > m->npages)
+        nframes = m->npages;
+
+    long misses = m->cold + m->tail[nframes];
+
+    // scale the sampled miss ratio up to the whole stream
+    return (double)misses * m->references / m->sampled + 0.5;
+}
+
+int mrc_max_distance(struct mrc *m)
+{
+    return m->max_distance;
+}
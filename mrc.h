@@ -0,0 +1,52 @@
+#ifndef MRC_H
+#define MRC_H
+
+/*
+Miss ratio curves in one pass over a reference stream.
+
+The LRU stack distance of a reference is the number of distinct pages used
+since the previous reference to the same page, counting the page itself. LRU
+with c frames misses exactly the references whose distance is greater than c,
+plus the first reference to every page, so a histogram of stack distances gives
+the misses at every frame count at once (Mattson et al., 1970).
+
+Distances are counted with a Fenwick tree over time, where only the latest
+reference to each page is marked: the distance is the number of marks after the
+page's previous reference. Each reference costs O(log n).
+
+For large address spaces the stream can be sampled with SHARDS (Waldspurger et
+al., FAST 2015): only pages whose hash falls under "rate" are tracked, and their
+distances are scaled up by 1/rate. Memory and time then shrink with the rate, at
+the cost of some accuracy in the estimate.
+*/
+
+struct mrc;
+
+/* Create a curve for a stream over "npages" pages, sampling a fraction "rate"
+ of the pages (1 tracks every page). Returns null on failure. */
+
+struct mrc *mrc_create(int npages, double rate);
+
+/* Delete a curve. */
+
+void mrc_delete(struct mrc *m);
+
+/* Add a reference to "page" to the stream. */
+
+void mrc_access(struct mrc *m, int page);
+
+/* Return the number of references seen. */
+
+long mrc_references(struct mrc *m);
+
+/* Return the number of misses LRU would take over the stream with "nframes"
+ frames. With sampling this is an estimate. */
+
+long mrc_misses(struct mrc *m, int nframes);
+
+/* Return the largest stack distance seen: beyond this many frames only first
+ references miss. */
+
+int mrc_max_distance(struct mrc *m);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+Throughput of the page kernels.
+
+opsbench first checks every kernel set the CPU runs against the scalar one, on
+pages with a difference at the edges of every vector width, and at unaligned
+addresses; any disagreement is reported and makes it exit with status 1. It then
+times each kernel over "npages" pages of PAGE_SIZE bytes, going round them for
+about a fifth of a second, and reports gigabytes of page processed per second.
+A few pages stay in the cache, and thousands do not, so the two show the
+kernels' speed and the memory's.
+
+The zero test and the comparison time the slow case, where every byte is
+read: an all-zero page, and two equal pages. The copy writes to page-aligned
+destinations, so it bypasses the cache with every set but the scalar one.
+*/
+
+#include "page_ops.h"
+#include "page_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// each kernel is timed for about this long
+#define BENCH_SECONDS 0.2
+
+// a different byte is placed at each of these offsets into a page, and at its end
+static const int check_offsets[] = {0, 1, 7, 8, 15, 16, 31, 32, 63, 64, 255, 256, 2048};
+
+#define NOFFSETS (int)(sizeof(check_offsets) / sizeof(check_offsets[0]))
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void fill_random(char *data, long size)
+{
+    for (long i = 0; i < size; i++)
+    {
+        data[i] = lrand48();
+    }
+}
+
+// check the kernel set in use against the scalar one; returns the number of failures
+static int check_kernels(const char *name, char *a, char *b, char *out)
+{
+    int failures = 0;
+
+    // "a" and "b" hold two pages and a little more, so that a page can start unaligned
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        char *pa = a + shift;
+        char *pb = b + shift;
+
+        memset(pa, 0, PAGE_SIZE);
+        failures += !page_is_zero(pa, PAGE_SIZE);
+        for (int i = 0; i <= NOFFSETS; i++)
+        {
+            int at = i < NOFFSETS ? check_offsets[i] : PAGE_SIZE - 1;
+
+            pa[at] = 1;
+            failures += page_is_zero(pa, PAGE_SIZE);
+            pa[at] = 0;
+        }
+
+        fill_random(pa, PAGE_SIZE);
+        memcpy(pb, pa, PAGE_SIZE);
+        failures += !page_equal(pa, pb, PAGE_SIZE);
+        for (int i = 0; i <= NOFFSETS; i++)
+        {
+            int at = i < NOFFSETS ? check_offsets[i] : PAGE_SIZE - 1;
+            unsigned long long before = page_hash(pa, PAGE_SIZE);
+
+            pb[at] ^= 0x80;
+            failures += page_equal(pa, pb, PAGE_SIZE);
+            failures += page_hash(pb, PAGE_SIZE) == before;
+
+            page_ops_select("scalar");
+            unsigned long long expected = page_hash(pb, PAGE_SIZE);
+            page_ops_select(name);
+            failures += page_hash(pb, PAGE_SIZE) != expected;
+            pb[at] ^= 0x80;
+        }
+
+        // the destination aligned, and not
+        page_copy(out, pa, PAGE_SIZE);
+        failures += memcmp(out, pa, PAGE_SIZE) != 0;
+        page_copy(out + shift + 8, pa, PAGE_SIZE);
+        failures += memcmp(out + shift + 8, pa, PAGE_SIZE) != 0;
+    }
+    return failures;
+}
+
+static void usage(void)
+{
+    printf("use: opsbench [-k %s] [npages]\n", page_ops_names());
+}
+
+int main(int argc, char *argv[])
+{
+    const char *only = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'k':
+            only = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    int npages = optind < argc ? atoi(argv[optind]) : 16;
+    if (npages < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    long size = (long)npages * PAGE_SIZE;
+    char *a = aligned_alloc(PAGE_SIZE, 2 * PAGE_SIZE);
+    char *b = aligned_alloc(PAGE_SIZE, 2 * PAGE_SIZE);
+    char *out = aligned_alloc(PAGE_SIZE, 2 * PAGE_SIZE);
+    char *zero = aligned_alloc(PAGE_SIZE, size);
+    char *src = aligned_alloc(PAGE_SIZE, size);
+    char *copy = aligned_alloc(PAGE_SIZE, size);
+    char *dst = aligned_alloc(PAGE_SIZE, size);
+    if (!a || !b || !out || !zero || !src || !copy || !dst)
+    {
+        printf("couldn't allocate %d pages\n", npages);
+        return 1;
+    }
+
+    srand48(1);
+    memset(zero, 0, size);
+    fill_random(src, size);
+    memcpy(copy, src, size);
+    memset(dst, 0, size);
+
+    char names[64];
+    int failed = 0;
+
+    strcpy(names, page_ops_names());
+    for (char *name = strtok(names, "|"); name; name = strtok(0, "|"))
+    {
+        if (only && strcmp(only, name))
+        {
+            continue;
+        }
+        page_ops_select(name);
+
+        int failures = check_kernels(name, a, b, out);
+        if (failures)
+        {
+            printf("Kernels: %s | %d checks failed\n", name, failures);
+            failed = 1;
+            continue;
+        }
+
+        // go round the pages until the time is up, checking the clock once a round
+        double gbs[4];
+        volatile unsigned long long sink = 0;
+
+        for (int kernel = 0; kernel < 4; kernel++)
+        {
+            struct timespec start, end;
+            long bytes = 0;
+            double seconds;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            do
+            {
+                for (long i = 0; i < size; i += PAGE_SIZE)
+                {
+                    switch (kernel)
+                    {
+                    case 0:
+                        sink += page_is_zero(zero + i, PAGE_SIZE);
+                        break;
+                    case 1:
+                        sink += page_hash(src + i, PAGE_SIZE);
+                        break;
+                    case 2:
+                        sink += page_equal(src + i, copy + i, PAGE_SIZE);
+                        break;
+                    default:
+                        page_copy(dst + i, src + i, PAGE_SIZE);
+                        break;
+                    }
+                }
+                bytes += size;
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                seconds = elapsed_seconds(&start, &end);
+            } while (seconds < BENCH_SECONDS);
+
+            gbs[kernel] = bytes / seconds / 1e9;
+        }
+        (void)sink;
+
+        printf("Kernels: %s | %d pages of %d bytes | zero %.1f GB/s | hash %.1f GB/s | equal %.1f GB/s | copy %.1f GB/s\n",
+               name, npages, PAGE_SIZE, gbs[0], gbs[1], gbs[2], gbs[3]);
+    }
+
+    if (only && page_ops_select(only) < 0)
+    {
+        printf("unknown kernel set, or not supported here: %s\n", only);
+        return 1;
+    }
+
+    free(a);
+    free(b);
+    free(out);
+    free(zero);
+    free(src);
+    free(copy);
+    free(dst);
+    return failed;
+}
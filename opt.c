@@ -0,0 +1,323 @@
+#include "opt.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BITS_LEVELS_MAX 8 // 64^8 positions
+
+/*
+A set of positions kept as a tree of 64-bit words: bit i of a word at level
+L + 1 is set if word i at level L is not zero. Finding the next or previous
+position set takes one step per level.
+*/
+
+struct bit_tree
+{
+    int nlevels;
+    long nwords[BITS_LEVELS_MAX];
+    uint64_t *words[BITS_LEVELS_MAX];
+};
+
+static int bits_init(struct bit_tree *b, long size)
+{
+    b->nlevels = 0;
+    do
+    {
+        size = (size + 63) / 64;
+        b->words[b->nlevels] = calloc(size, sizeof(uint64_t));
+        b->nwords[b->nlevels] = size;
+        if (!b->words[b->nlevels++])
+            return -1;
+    } while (size > 1 && b->nlevels < BITS_LEVELS_MAX);
+
+    return 0;
+}
+
+static void bits_free(struct bit_tree *b)
+{
+    for (int l = 0; l < b->nlevels; l++)
+        free(b->words[l]);
+    b->nlevels = 0;
+}
+
+static void bits_set(struct bit_tree *b, long i)
+{
+    for (int l = 0; l < b->nlevels; l++)
+    {
+        uint64_t *w = &b->words[l][i >> 6];
+        int was_empty = *w == 0;
+
+        *w |= (uint64_t)1 << (i & 63);
+        if (!was_empty)
+            break;
+        i >>= 6;
+    }
+}
+
+static void bits_clear(struct bit_tree *b, long i)
+{
+    for (int l = 0; l < b->nlevels; l++)
+    {
+        uint64_t *w = &b->words[l][i >> 6];
+
+        *w &= ~((uint64_t)1 << (i & 63));
+        if (*w)
+            break;
+        i >>= 6;
+    }
+}
+
+// the lowest position set at or after "i", or -1
+static long bits_next(struct bit_tree *b, long i)
+{
+    int l = 0;
+
+    for (;;)
+    {
+        if (l == b->nlevels || (i >> 6) >= b->nwords[l])
+            return -1;
+
+        uint64_t w = b->words[l][i >> 6] & (~(uint64_t)0 << (i & 63));
+        if (w)
+        {
+            i = (i & ~63L) + __builtin_ctzll(w);
+            break;
+        }
+        i = (i >> 6) + 1;
+        l++;
+    }
+    while (l-- > 0)
+        i = (i << 6) + __builtin_ctzll(b->words[l][i]);
+
+    return i;
+}
+
+// the highest position set at or before "i", or -1
+static long bits_prev(struct bit_tree *b, long i)
+{
+    int l = 0;
+
+    for (;;)
+    {
+        if (l == b->nlevels || i < 0)
+            return -1;
+
+        uint64_t w = b->words[l][i >> 6] & (~(uint64_t)0 >> (63 - (i & 63)));
+        if (w)
+        {
+            i = (i & ~63L) + 63 - __builtin_clzll(w);
+            break;
+        }
+        i = (i >> 6) - 1;
+        l++;
+    }
+    while (l-- > 0)
+        i = (i << 6) + 63 - __builtin_clzll(b->words[l][i]);
+
+    return i;
+}
+
+struct opt_state
+{
+    const int *pages; // the reference string
+    long n;
+    long *next;     // next[i]: index of the next reference to pages[i] after i, or n
+    long *upcoming; // per page: its first reference not known to be behind the cursor
+    long *key;      // per resident page: the position it is filed under, or -1
+    long cursor;    // index of the current reference
+    int *held;      // with a partial string, per reference: the page the recording run held beside it
+    struct bit_tree resident;
+};
+
+static void opt_destroy(struct policy *p)
+{
+    struct opt_state *s = p->state;
+
+    if (!s)
+        return;
+
+    bits_free(&s->resident);
+    free(s->next);
+    free(s->held);
+    free(s->upcoming);
+    free(s->key);
+    free(s);
+}
+
+static int opt_init(struct policy *p)
+{
+    struct opt_state *s = calloc(1, sizeof(*s));
+
+    if (!s)
+        return -1;
+    p->state = s;
+
+    s->upcoming = calloc(p->npages, sizeof(long));
+    s->key = malloc(p->npages * sizeof(long));
+    if (!s->upcoming || !s->key || bits_init(&s->resident, p->npages) < 0)
+    {
+        opt_destroy(p);
+        return -1;
+    }
+
+    for (int page = 0; page < p->npages; page++)
+        s->key[page] = -1;
+
+    return 0;
+}
+
+int opt_set_references(struct policy *p, const int *pages, long n, int partial)
+{
+    struct opt_state *s = p->state;
+
+    if (p->ops != &opt_policy_ops)
+        return -1;
+
+    long *next = malloc((n > 0 ? n : 1) * sizeof(long));
+    int *held = partial ? malloc((n > 0 ? n : 1) * sizeof(int)) : 0;
+    struct bit_tree resident = {0};
+
+    if (!next || (partial && !held) || bits_init(&resident, n + p->npages) < 0)
+    {
+        bits_free(&resident);
+        free(next);
+        free(held);
+        return -1;
+    }
+
+    // replay the recording run, fifo over two frames: a reference to a page it
+    // did not hold loads it in place of the one loaded first
+    int older = -1, younger = -1;
+
+    for (long i = 0; partial && i < n; i++)
+    {
+        if (pages[i] != older && pages[i] != younger)
+        {
+            older = younger;
+            younger = pages[i];
+        }
+        held[i] = pages[i] == younger ? older : younger;
+    }
+
+    // one pass backwards links every reference to the next one to the same page
+    for (int page = 0; page < p->npages; page++)
+        s->upcoming[page] = n;
+    for (long i = n - 1; i >= 0; i--)
+    {
+        next[i] = s->upcoming[pages[i]];
+        s->upcoming[pages[i]] = i;
+    }
+
+    bits_free(&s->resident);
+    free(s->next);
+    free(s->held);
+    s->resident = resident;
+    s->next = next;
+    s->held = held;
+    s->pages = pages;
+    s->n = n;
+    s->cursor = 0;
+
+    return 0;
+}
+
+// the position "page" is filed under: its next reference, or a slot of its own
+// past the end of the string if it is never used again
+static long opt_next_use(struct opt_state *s, int page)
+{
+    while (s->upcoming[page] < s->cursor)
+        s->upcoming[page] = s->next[s->upcoming[page]];
+
+    return s->upcoming[page] < s->n ? s->upcoming[page] : s->n + page;
+}
+
+// move the cursor to the next reference to "page", the one being made now.
+// If the string has none left (the run went off the recorded path), stay put.
+static void opt_advance(struct opt_state *s, int page)
+{
+    long pos = opt_next_use(s, page);
+
+    if (pos < s->n)
+    {
+        s->cursor = pos;
+        s->upcoming[page] = s->next[pos];
+    }
+}
+
+static void opt_file(struct opt_state *s, int page)
+{
+    s->key[page] = opt_next_use(s, page);
+    bits_set(&s->resident, s->key[page]);
+}
+
+static void opt_on_fault(struct policy *p, int page)
+{
+    opt_advance(p->state, page);
+}
+
+static void opt_on_access(struct policy *p, int page, int frame)
+{
+    struct opt_state *s = p->state;
+
+    opt_advance(s, page);
+    if (s->key[page] >= 0)
+    {
+        bits_clear(&s->resident, s->key[page]);
+        opt_file(s, page);
+    }
+}
+
+static int opt_choose_victim(struct policy *p, int page)
+{
+    struct opt_state *s = p->state;
+    long k;
+
+    // pages referenced since they were filed sit below the cursor: refile them
+    while ((k = bits_next(&s->resident, 0)) >= 0 && k < s->cursor)
+    {
+        bits_clear(&s->resident, k);
+        opt_file(s, s->pages[k]);
+    }
+
+    // the references the string leaves out are to the page the recording run held
+    // beside the current one: keep it unless nothing else can go, and they hit
+    int keep = s->held ? s->held[s->cursor] : -1;
+    int kept = -1;
+
+    for (k = bits_prev(&s->resident, s->n + p->npages - 1); k >= 0; k = bits_prev(&s->resident, k - 1))
+    {
+        int victim = k < s->n ? s->pages[k] : k - s->n;
+        int frame = frame_table_lookup(p->ft, victim);
+
+        if (frame_table_info(p->ft, frame)->pins)
+            continue;
+        if (victim != keep)
+            return frame;
+        kept = frame;
+    }
+    return kept;
+}
+
+static void opt_on_evict(struct policy *p, int page, int frame)
+{
+    struct opt_state *s = p->state;
+
+    bits_clear(&s->resident, s->key[page]);
+    s->key[page] = -1;
+}
+
+static void opt_on_load(struct policy *p, int page, int frame)
+{
+    opt_file(p->state, page);
+}
+
+const struct policy_ops opt_policy_ops = {
+    .name = "opt",
+    .init = opt_init,
+    .destroy = opt_destroy,
+    .on_fault = opt_on_fault,
+    .on_access = opt_on_access,
+    .choose_victim = opt_choose_victim,
+    .on_evict = opt_on_evict,
+    .on_load = opt_on_load,
+};
@@ -0,0 +1,37 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include "policy.h"
+
+/*
+OPT, Belady's optimal (MIN) replacement: evict the page whose next use is
+furthest in the future. It needs the whole reference string up front, so it
+only runs over a recorded trace: offline in vmsim, or in virtmem after a first
+pass has recorded the program's references.
+
+Every page has a next-use position: the index of its next reference at or after
+the current one, or a position past the end of the string for pages never used
+again. The positions of the resident pages are kept in a 64-ary bit tree, so
+the victim is the highest position set, found in O(log n). The policy follows
+the string through on_fault and on_access: each report moves the current
+position to the next reference of that page. References that are not reported
+(hits virtmem never sees) leave stale positions behind; those are the lowest
+ones in the tree and are brought up to date before a victim is chosen, so each
+reference costs O(log n) once, whether it is reported or not.
+*/
+
+/* Give the OPT policy "p" the reference string "pages[0..n-1]". The array is
+ used in place and must outlive the policy. Call it before any page is loaded.
+ Without a reference string OPT evicts the highest page number.
+
+ A string recorded by a fifo run with two frames leaves out the references to
+ the two pages it held, since those hit. Replaying such a string in a live run,
+ set "partial": at every miss, the page the recording run held beside the one
+ missing is kept while any other page can be evicted. The live run then holds
+ what the recording run did, the references missing from the string hit, and
+ every miss it reports is in the string.
+ Returns 0, or -1 if "p" is not an OPT policy or memory runs out. */
+
+int opt_set_references(struct policy *p, const int *pages, long n, int partial);
+
+#endif
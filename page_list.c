@@ -0,0 +1,48 @@
+#include "page_list.h"
+
+void page_list_init(struct page_list *l)
+{
+    l->head = -1;
+    l->tail = -1;
+    l->size = 0;
+}
+
+void page_list_push(struct page_list *l, int *next, int *prev, int page)
+{
+    prev[page] = -1;
+    next[page] = l->head;
+
+    if (l->head >= 0)
+        prev[l->head] = page;
+    else
+        l->tail = page;
+
+    l->head = page;
+    l->size++;
+}
+
+void page_list_remove(struct page_list *l, int *next, int *prev, int page)
+{
+    if (prev[page] >= 0)
+        next[prev[page]] = next[page];
+    else
+        l->head = next[page];
+
+    if (next[page] >= 0)
+        prev[next[page]] = prev[page];
+    else
+        l->tail = prev[page];
+
+    next[page] = prev[page] = -1;
+    l->size--;
+}
+
+int page_list_pop(struct page_list *l, int *next, int *prev)
+{
+    int page = l->tail;
+
+    if (page >= 0)
+        page_list_remove(l, next, prev, page);
+
+    return page;
+}
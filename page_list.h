@@ -0,0 +1,34 @@
+#ifndef PAGE_LIST_H
+#define PAGE_LIST_H
+
+/*
+Intrusive doubly linked lists of page numbers, used by the replacement policies.
+The links live in caller-owned "next" and "prev" arrays indexed by page, so a page
+can be on at most one list per pair of arrays. The head is the most recently
+inserted end of the list.
+*/
+
+struct page_list
+{
+    int head;
+    int tail;
+    int size;
+};
+
+/* Make a list empty. */
+
+void page_list_init(struct page_list *l);
+
+/* Insert "page" at the head of the list. */
+
+void page_list_push(struct page_list *l, int *next, int *prev, int page);
+
+/* Unlink "page", which must be on the list. */
+
+void page_list_remove(struct page_list *l, int *next, int *prev, int page);
+
+/* Unlink and return the page at the tail of the list, or -1 if it is empty. */
+
+int page_list_pop(struct page_list *l, int *next, int *prev);
+
+#endif
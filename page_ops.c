@@ -0,0 +1,459 @@
+#include "page_ops.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+Every kernel walks the page in steps of 256 bytes, and the zero and equality
+tests only check for a difference once a step, to exit early on data without
+paying for a branch on every load.
+
+The hash treats the page as 64-byte stripes of eight 64-bit words, w[0..7],
+folded into eight accumulators as in XXH3:
+
+    k = w[j] ^ secret[j]
+    acc[j] += lo32(k) * hi32(k) + w[j ^ 1]
+
+A 32 x 32 -> 64 bit multiply is one instruction in each of SSE2, AVX2 and
+AVX-512, and the swapped word stays within a 128-bit lane, so every set computes
+the same accumulators. They are then mixed into one hash.
+*/
+
+#define STEP_BYTES 256
+#define STRIPE_WORDS 8
+
+struct page_kernels
+{
+    const char *name;
+    int (*is_zero)(const char *data, long size);
+    unsigned long long (*hash)(const char *data, long size);
+    int (*equal)(const char *a, const char *b, long size);
+    void (*copy)(char *dst, const char *src, long size);
+};
+
+static const unsigned long long hash_secret[STRIPE_WORDS] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+// the finalizer of MurmurHash3, which spreads every input bit over the output
+static unsigned long long hash_mix(unsigned long long h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static unsigned long long hash_finish(const unsigned long long *acc, long size)
+{
+    unsigned long long h = size;
+
+    for (int j = 0; j < STRIPE_WORDS; j++)
+        h = hash_mix(h ^ acc[j]);
+
+    return h;
+}
+
+// an unaligned load, so that any buffer will do
+static uint64_t load64(const char *p)
+{
+    uint64_t w;
+
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/*
+scalar: 64-bit words, for any CPU.
+*/
+
+static int scalar_is_zero(const char *data, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        uint64_t acc = 0;
+
+        for (int j = 0; j < STEP_BYTES; j += 8)
+            acc |= load64(data + i + j);
+
+        if (acc)
+            return 0;
+    }
+    return 1;
+}
+
+static unsigned long long scalar_hash(const char *data, long size)
+{
+    unsigned long long acc[STRIPE_WORDS] = {0};
+
+    for (long i = 0; i < size; i += STRIPE_WORDS * 8)
+    {
+        for (int j = 0; j < STRIPE_WORDS; j++)
+        {
+            uint64_t k = load64(data + i + j * 8) ^ hash_secret[j];
+
+            acc[j] += (k & 0xffffffff) * (k >> 32) + load64(data + i + (j ^ 1) * 8);
+        }
+    }
+    return hash_finish(acc, size);
+}
+
+static int scalar_equal(const char *a, const char *b, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        uint64_t acc = 0;
+
+        for (int j = 0; j < STEP_BYTES; j += 8)
+            acc |= load64(a + i + j) ^ load64(b + i + j);
+
+        if (acc)
+            return 0;
+    }
+    return 1;
+}
+
+static void scalar_copy(char *dst, const char *src, long size)
+{
+    memcpy(dst, src, size);
+}
+
+static const struct page_kernels scalar_kernels = {
+    "scalar", scalar_is_zero, scalar_hash, scalar_equal, scalar_copy,
+};
+
+#if defined(__x86_64__)
+
+/*
+sse2: 16-byte vectors, on every x86-64 CPU.
+*/
+
+static int sse2_is_zero(const char *data, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m128i acc = _mm_setzero_si128();
+
+        for (int j = 0; j < STEP_BYTES; j += 16)
+            acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(data + i + j)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff)
+            return 0;
+    }
+    return 1;
+}
+
+static unsigned long long sse2_hash(const char *data, long size)
+{
+    __m128i acc[STRIPE_WORDS / 2], secret[STRIPE_WORDS / 2];
+    unsigned long long out[STRIPE_WORDS];
+
+    for (int j = 0; j < STRIPE_WORDS / 2; j++)
+    {
+        acc[j] = _mm_setzero_si128();
+        secret[j] = _mm_loadu_si128((const __m128i *)&hash_secret[j * 2]);
+    }
+    for (long i = 0; i < size; i += STRIPE_WORDS * 8)
+    {
+        for (int j = 0; j < STRIPE_WORDS / 2; j++)
+        {
+            __m128i w = _mm_loadu_si128((const __m128i *)(data + i + j * 16));
+            __m128i k = _mm_xor_si128(w, secret[j]);
+            __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+
+            acc[j] = _mm_add_epi64(acc[j], _mm_add_epi64(product, _mm_shuffle_epi32(w, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+    }
+    for (int j = 0; j < STRIPE_WORDS / 2; j++)
+        _mm_storeu_si128((__m128i *)&out[j * 2], acc[j]);
+
+    return hash_finish(out, size);
+}
+
+static int sse2_equal(const char *a, const char *b, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m128i acc = _mm_setzero_si128();
+
+        for (int j = 0; j < STEP_BYTES; j += 16)
+            acc = _mm_or_si128(acc, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + j)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i + j))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xffff)
+            return 0;
+    }
+    return 1;
+}
+
+static void sse2_copy(char *dst, const char *src, long size)
+{
+    if ((uintptr_t)dst % 64)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+    for (long i = 0; i < size; i += 64)
+    {
+        for (int j = 0; j < 64; j += 16)
+            _mm_stream_si128((__m128i *)(dst + i + j), _mm_loadu_si128((const __m128i *)(src + i + j)));
+    }
+    _mm_sfence();
+}
+
+static const struct page_kernels sse2_kernels = {
+    "sse2", sse2_is_zero, sse2_hash, sse2_equal, sse2_copy,
+};
+
+/*
+avx2: 32-byte vectors.
+*/
+
+__attribute__((target("avx2"))) static int avx2_is_zero(const char *data, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int j = 0; j < STEP_BYTES; j += 32)
+            acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i *)(data + i + j)));
+
+        if (!_mm256_testz_si256(acc, acc))
+            return 0;
+    }
+    return 1;
+}
+
+__attribute__((target("avx2"))) static unsigned long long avx2_hash(const char *data, long size)
+{
+    __m256i acc[STRIPE_WORDS / 4], secret[STRIPE_WORDS / 4];
+    unsigned long long out[STRIPE_WORDS];
+
+    for (int j = 0; j < STRIPE_WORDS / 4; j++)
+    {
+        acc[j] = _mm256_setzero_si256();
+        secret[j] = _mm256_loadu_si256((const __m256i *)&hash_secret[j * 4]);
+    }
+    for (long i = 0; i < size; i += STRIPE_WORDS * 8)
+    {
+        for (int j = 0; j < STRIPE_WORDS / 4; j++)
+        {
+            __m256i w = _mm256_loadu_si256((const __m256i *)(data + i + j * 32));
+            __m256i k = _mm256_xor_si256(w, secret[j]);
+            __m256i product = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+
+            acc[j] = _mm256_add_epi64(acc[j], _mm256_add_epi64(product, _mm256_shuffle_epi32(w, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+    }
+    for (int j = 0; j < STRIPE_WORDS / 4; j++)
+        _mm256_storeu_si256((__m256i *)&out[j * 4], acc[j]);
+
+    return hash_finish(out, size);
+}
+
+__attribute__((target("avx2"))) static int avx2_equal(const char *a, const char *b, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int j = 0; j < STEP_BYTES; j += 32)
+            acc = _mm256_or_si256(acc, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i + j)),
+                                                        _mm256_loadu_si256((const __m256i *)(b + i + j))));
+
+        if (!_mm256_testz_si256(acc, acc))
+            return 0;
+    }
+    return 1;
+}
+
+__attribute__((target("avx2"))) static void avx2_copy(char *dst, const char *src, long size)
+{
+    if ((uintptr_t)dst % 64)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+    for (long i = 0; i < size; i += 64)
+    {
+        _mm256_stream_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+        _mm256_stream_si256((__m256i *)(dst + i + 32), _mm256_loadu_si256((const __m256i *)(src + i + 32)));
+    }
+    _mm_sfence();
+}
+
+static const struct page_kernels avx2_kernels = {
+    "avx2", avx2_is_zero, avx2_hash, avx2_equal, avx2_copy,
+};
+
+/*
+avx512: 64-byte vectors, with AVX-512F alone.
+*/
+
+__attribute__((target("avx512f"))) static int avx512_is_zero(const char *data, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m512i acc = _mm512_setzero_si512();
+
+        for (int j = 0; j < STEP_BYTES; j += 64)
+            acc = _mm512_or_si512(acc, _mm512_loadu_si512(data + i + j));
+
+        if (_mm512_test_epi64_mask(acc, acc))
+            return 0;
+    }
+    return 1;
+}
+
+__attribute__((target("avx512f"))) static unsigned long long avx512_hash(const char *data, long size)
+{
+    __m512i acc = _mm512_setzero_si512();
+    __m512i secret = _mm512_loadu_si512(hash_secret);
+    unsigned long long out[STRIPE_WORDS];
+
+    for (long i = 0; i < size; i += STRIPE_WORDS * 8)
+    {
+        __m512i w = _mm512_loadu_si512(data + i);
+        __m512i k = _mm512_xor_si512(w, secret);
+        __m512i product = _mm512_mul_epu32(k, _mm512_srli_epi64(k, 32));
+
+        acc = _mm512_add_epi64(acc, _mm512_add_epi64(product, _mm512_shuffle_epi32(w, _MM_PERM_BADC)));
+    }
+    _mm512_storeu_si512(out, acc);
+
+    return hash_finish(out, size);
+}
+
+__attribute__((target("avx512f"))) static int avx512_equal(const char *a, const char *b, long size)
+{
+    for (long i = 0; i < size; i += STEP_BYTES)
+    {
+        __m512i acc = _mm512_setzero_si512();
+
+        for (int j = 0; j < STEP_BYTES; j += 64)
+            acc = _mm512_or_si512(acc, _mm512_xor_si512(_mm512_loadu_si512(a + i + j), _mm512_loadu_si512(b + i + j)));
+
+        if (_mm512_test_epi64_mask(acc, acc))
+            return 0;
+    }
+    return 1;
+}
+
+__attribute__((target("avx512f"))) static void avx512_copy(char *dst, const char *src, long size)
+{
+    if ((uintptr_t)dst % 64)
+    {
+        memcpy(dst, src, size);
+        return;
+    }
+    for (long i = 0; i < size; i += 64)
+        _mm512_stream_si512((__m512i *)(dst + i), _mm512_loadu_si512(src + i));
+    _mm_sfence();
+}
+
+static const struct page_kernels avx512_kernels = {
+    "avx512", avx512_is_zero, avx512_hash, avx512_equal, avx512_copy,
+};
+
+#endif
+
+// every set, narrowest first
+static const struct page_kernels *all_kernels[] = {
+    &scalar_kernels,
+#if defined(__x86_64__)
+    &sse2_kernels,
+    &avx2_kernels,
+    &avx512_kernels,
+#endif
+};
+
+#define NKERNELS (int)(sizeof(all_kernels) / sizeof(all_kernels[0]))
+
+static int kernels_supported(const struct page_kernels *k)
+{
+#if defined(__x86_64__)
+    if (k == &avx2_kernels)
+        return __builtin_cpu_supports("avx2");
+    if (k == &avx512_kernels)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    return 1;
+}
+
+static const struct page_kernels *kernels = &scalar_kernels;
+
+// pick the widest set before main runs, so that no thread sees the choice made
+__attribute__((constructor)) static void page_ops_init(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+#endif
+    for (int i = 0; i < NKERNELS; i++)
+    {
+        if (kernels_supported(all_kernels[i]))
+            kernels = all_kernels[i];
+    }
+}
+
+int page_is_zero(const char *data, long size)
+{
+    return kernels->is_zero(data, size);
+}
+
+unsigned long long page_hash(const char *data, long size)
+{
+    return kernels->hash(data, size);
+}
+
+int page_equal(const char *a, const char *b, long size)
+{
+    return kernels->equal(a, b, size);
+}
+
+void page_copy(char *dst, const char *src, long size)
+{
+    kernels->copy(dst, src, size);
+}
+
+const char *page_ops_names(void)
+{
+    static char names[64];
+
+    if (!names[0])
+    {
+        for (int i = 0; i < NKERNELS; i++)
+        {
+            if (!kernels_supported(all_kernels[i]))
+                continue;
+            if (names[0])
+                strcat(names, "|");
+            strcat(names, all_kernels[i]->name);
+        }
+    }
+    return names;
+}
+
+int page_ops_select(const char *name)
+{
+    for (int i = 0; i < NKERNELS; i++)
+    {
+        if (!strcmp(all_kernels[i]->name, name) && kernels_supported(all_kernels[i]))
+        {
+            kernels = all_kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *page_ops_selected(void)
+{
+    return kernels->name;
+}
@@ -0,0 +1,47 @@
+#ifndef PAGE_OPS_H
+#define PAGE_OPS_H
+
+/*
+Whole-page operations on blocks of memory the size of a page: frames in
+physmem, or copies of them. Sizes are multiples of PAGE_SIZE.
+
+Every operation comes in a set of kernels per instruction set: scalar, and SSE2,
+AVX2 and AVX-512 on x86-64. The widest set the CPU runs is chosen when the
+program starts. All sets give the same results, hashes included, so the set in
+use may change at any time.
+*/
+
+/* Return 1 if every byte of the "size" bytes at "data" is zero. */
+
+int page_is_zero(const char *data, long size);
+
+/* Return a 64-bit hash of the "size" bytes at "data". Equal hashes do not prove
+ the bytes equal, so compare them as well. */
+
+unsigned long long page_hash(const char *data, long size);
+
+/* Return 1 if the "size" bytes at "a" and at "b" are equal. */
+
+int page_equal(const char *a, const char *b, long size);
+
+/* Copy "size" bytes from "src" to "dst", which must not overlap. The copy
+ bypasses the cache when "dst" is aligned to 64 bytes, so use it for copies not
+ read again soon, such as pages on their way to disk. */
+
+void page_copy(char *dst, const char *src, long size);
+
+/* Return the names of the kernel sets this CPU runs, separated by "|", from the
+ narrowest to the widest. */
+
+const char *page_ops_names(void);
+
+/* Use the kernel set called "name" from now on. Returns -1 if there is no such
+ set, or the CPU does not run it. */
+
+int page_ops_select(const char *name);
+
+/* Return the name of the kernel set in use. */
+
+const char *page_ops_selected(void);
+
+#endif
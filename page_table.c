@@ -8,13 +8,45 @@ Make all of your changes to main.c instead.
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
 #include <limits.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
 #include <ucontext.h>
+#include <linux/userfaultfd.h>
 
 #include "page_table.h"
+#include "page_ops.h"
+#include "latency.h"
+
+/*
+Entries are packed into 64 bits: the frame in the high half and the protection
+bits in the low half, a page with none of them being absent. Whether a page is
+dirty or referenced is up to the fault handler. Entries are kept in a
+three-level radix tree indexed by page number, whose middle and leaf tables are
+only allocated when an entry under them is first set, so that a large virtual
+memory used sparsely costs table space only around the pages it touches. The
+root is allocated whole, one pointer for every PT_MIDDLE_PAGES pages.
+*/
+
+typedef uint64_t pte_t;
+
+#define PTE_PROT (PROT_READ | PROT_WRITE | PROT_EXEC)
+#define PTE_FRAME_SHIFT 32
+
+#define PT_LEVEL_BITS 9
+#define PT_LEVEL_SIZE (1 << PT_LEVEL_BITS) // entries in a leaf table, and leaf tables under a middle one
+#define PT_LEVEL_MASK (PT_LEVEL_SIZE - 1)
+#define PT_MIDDLE_PAGES (PT_LEVEL_SIZE * PT_LEVEL_SIZE)
 
 struct page_table
 {
@@ -23,12 +55,39 @@ struct page_table
     int npages;
     char *physmem;
     int nframes;
-    int *page_mapping;
-    int *page_bits;
+    int page_size;
+    enum page_table_memory memory;
+    pte_t ***root;
+    int nroot;
+    size_t table_bytes;
     page_fault_handler_t handler;
+    void *private;
+
+    enum page_table_backend backend;
+    int uffd;
+    int stop_pipe[2];
+    pthread_t *fault_threads;
+    int nfault_threads;
+
+    int *physmem_refs; // page tables sharing the physical memory, this one included
+    struct page_table *next;
 };
 
-struct page_table *the_page_table = 0;
+// every page table, so that a fault can be traced to the one whose virtual memory it hit
+static struct page_table *page_tables;
+
+// the access behind a SIGSEGV: on x86 the page fault error code has bit 1 set for
+// a write, while other architectures would need their fault status registers
+static enum page_table_access fault_access(void *context)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    ucontext_t *uc = context;
+
+    return uc->uc_mcontext.gregs[REG_ERR] & 2 ? PAGE_TABLE_ACCESS_WRITE : PAGE_TABLE_ACCESS_READ;
+#else
+    return PAGE_TABLE_ACCESS_UNKNOWN;
+#endif
+}
 
 static void internal_fault_handler(int signum, siginfo_t *info, void *context)
 {
@@ -39,15 +98,11 @@ static void internal_fault_handler(int signum, siginfo_t *info, void *context)
     char *addr = info->si_addr;
 #endif
 
-    struct page_table *pt = the_page_table;
-
-    if (pt)
+    for (struct page_table *pt = page_tables; pt; pt = pt->next)
     {
-        int page = (addr - pt->virtmem) / PAGE_SIZE;
-
-        if (page >= 0 && page < pt->npages)
+        if (addr >= pt->virtmem && addr < pt->virtmem + (size_t)pt->npages * pt->page_size)
         {
-            pt->handler(pt, page);
+            pt->handler(pt, (addr - pt->virtmem) / pt->page_size, fault_access(context));
             return;
         }
     }
@@ -56,59 +111,557 @@ static void internal_fault_handler(int signum, siginfo_t *info, void *context)
     abort();
 }
 
+// the entry of "page", or null if no entry near it was ever set
+static pte_t *pte_lookup(struct page_table *pt, int page)
+{
+    pte_t **middle = pt->root[page / PT_MIDDLE_PAGES];
+    pte_t *leaf = middle ? middle[(page >> PT_LEVEL_BITS) & PT_LEVEL_MASK] : 0;
+
+    return leaf ? &leaf[page & PT_LEVEL_MASK] : 0;
+}
+
+// the entry of "page", allocating the tables on the way down to it
+static pte_t *pte_alloc(struct page_table *pt, int page)
+{
+    pte_t ***middle = &pt->root[page / PT_MIDDLE_PAGES];
+
+    if (!*middle)
+    {
+        if (!(*middle = calloc(PT_LEVEL_SIZE, sizeof(pte_t *))))
+            return 0;
+        pt->table_bytes += PT_LEVEL_SIZE * sizeof(pte_t *);
+    }
+
+    pte_t **leaf = &(*middle)[(page >> PT_LEVEL_BITS) & PT_LEVEL_MASK];
+
+    if (!*leaf)
+    {
+        if (!(*leaf = calloc(PT_LEVEL_SIZE, sizeof(pte_t))))
+            return 0;
+        pt->table_bytes += PT_LEVEL_SIZE * sizeof(pte_t);
+    }
+
+    return &(*leaf)[page & PT_LEVEL_MASK];
+}
+
+static int pte_frame(pte_t pte)
+{
+    return pte >> PTE_FRAME_SHIFT;
+}
+
+static int pte_bits(pte_t pte)
+{
+    return pte & PTE_PROT;
+}
+
+// the entry of "page" as it was last set, or zero
+static pte_t pte_get(struct page_table *pt, int page)
+{
+    pte_t *pte = pte_lookup(pt, page);
+
+    return pte ? *pte : 0;
+}
+
+static void tables_free(struct page_table *pt)
+{
+    for (int i = 0; i < pt->nroot; i++)
+    {
+        if (!pt->root[i])
+            continue;
+        for (int j = 0; j < PT_LEVEL_SIZE; j++)
+            free(pt->root[i][j]);
+        free(pt->root[i]);
+    }
+    free(pt->root);
+}
+
+/*
+userfaultfd backend.
+
+virtmem is private anonymous memory registered for MISSING and WP faults,
+and dedicated threads read fault messages from the uffd and run the
+handler (one, or more with page_table_add_fault_threads). Since virtmem
+cannot alias physmem here, a mapping is installed by
+copying the frame into the page (UFFDIO_COPY, or UFFDIO_ZEROPAGE for an
+all-zero frame), and a writable page is copied back into its frame whenever
+it loses write access or is unmapped. Unmapping must therefore happen before
+a frame's contents are written back to disk.
+*/
+
+// the fault the calling handler thread is serving, and whether it installed the page
+static __thread int uffd_fault_page = -1;
+static __thread int uffd_fault_resolved;
+
+static void uffd_ioctl(struct page_table *pt, unsigned long request, void *arg, const char *name)
+{
+    if (ioctl(pt->uffd, request, arg) < 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "page_table: %s failed: %s\n", name, strerror(errno));
+        abort();
+    }
+}
+
+// Only removing write protection wakes blocked threads; see uffd_wake.
+static void uffd_write_protect(struct page_table *pt, int page, int protect)
+{
+    struct uffdio_writeprotect wp;
+
+    wp.range.start = (unsigned long)(pt->virtmem + (size_t)page * pt->page_size);
+    wp.range.len = pt->page_size;
+    wp.mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+    uffd_ioctl(pt, UFFDIO_WRITEPROTECT, &wp, "UFFDIO_WRITEPROTECT");
+}
+
+static void uffd_wake(struct page_table *pt, int page)
+{
+    struct uffdio_range range;
+
+    range.start = (unsigned long)(pt->virtmem + (size_t)page * pt->page_size);
+    range.len = pt->page_size;
+    ioctl(pt->uffd, UFFDIO_WAKE, &range);
+}
+
+static void uffd_map_page(struct page_table *pt, int page, int frame, int bits)
+{
+    char *addr = pt->virtmem + (size_t)page * pt->page_size;
+    char *data = pt->physmem + (size_t)frame * pt->page_size;
+
+    if (!(bits & PROT_WRITE) && page_is_zero(data, pt->page_size))
+    {
+        struct uffdio_zeropage zp;
+
+        zp.range.start = (unsigned long)addr;
+        zp.range.len = pt->page_size;
+        zp.mode = UFFDIO_ZEROPAGE_MODE_DONTWAKE;
+        uffd_ioctl(pt, UFFDIO_ZEROPAGE, &zp, "UFFDIO_ZEROPAGE");
+
+        uffd_write_protect(pt, page, 1);
+        uffd_wake(pt, page);
+    }
+    else
+    {
+        struct uffdio_copy copy;
+
+        copy.dst = (unsigned long)addr;
+        copy.src = (unsigned long)data;
+        copy.len = pt->page_size;
+        copy.mode = bits & PROT_WRITE ? 0 : UFFDIO_COPY_MODE_WP;
+        copy.copy = 0;
+        uffd_ioctl(pt, UFFDIO_COPY, &copy, "UFFDIO_COPY");
+    }
+}
+
+static void uffd_set_entry(struct page_table *pt, int page, int frame, int bits)
+{
+    pte_t old = pte_get(pt, page);
+    int old_frame = pte_frame(old);
+    int old_bits = pte_bits(old);
+    char *addr = pt->virtmem + (size_t)page * pt->page_size;
+
+    if (old_bits)
+    {
+        int same = (bits && frame == old_frame);
+
+        // the live copy of a writable page is in virtmem; flush it to its frame.
+        // When the page stays mapped, write-protect it first: the caller may be
+        // a thread other than the one running the program.
+        if (same)
+        {
+            if ((old_bits & PROT_WRITE) && !(bits & PROT_WRITE))
+            {
+                uffd_write_protect(pt, page, 1);
+                memcpy(pt->physmem + (size_t)old_frame * pt->page_size, addr, pt->page_size);
+                uffd_wake(pt, page);
+            }
+            else if (!(old_bits & PROT_WRITE) && (bits & PROT_WRITE))
+            {
+                uffd_write_protect(pt, page, 0);
+            }
+            return;
+        }
+
+        // likewise, so that a write from another program thread cannot land
+        // between the copy and the unmap and be lost
+        if (old_bits & PROT_WRITE)
+        {
+            uffd_write_protect(pt, page, 1);
+            memcpy(pt->physmem + (size_t)old_frame * pt->page_size, addr, pt->page_size);
+        }
+
+        madvise(addr, pt->page_size, MADV_DONTNEED);
+    }
+
+    if (bits)
+        uffd_map_page(pt, page, frame, bits);
+}
+
+static void *uffd_fault_thread(void *arg)
+{
+    struct page_table *pt = arg;
+    struct pollfd fds[2];
+    struct uffd_msg msg;
+
+    fds[0].fd = pt->uffd;
+    fds[0].events = POLLIN;
+    fds[1].fd = pt->stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        // every handler thread is woken; all but one find nothing to read
+        if (read(pt->uffd, &msg, sizeof(msg)) != sizeof(msg))
+            continue;
+
+        if (msg.event != UFFD_EVENT_PAGEFAULT)
+            continue;
+
+        char *addr = (char *)(unsigned long)msg.arg.pagefault.address;
+        int page = (addr - pt->virtmem) / pt->page_size;
+
+        uffd_fault_page = page;
+        uffd_fault_resolved = 0;
+
+        pt->handler(pt, page, msg.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WRITE ? PAGE_TABLE_ACCESS_WRITE : PAGE_TABLE_ACCESS_READ);
+
+        // the handler did not install anything for this page: let the
+        // faulting thread retry rather than leave it blocked forever
+        if (!uffd_fault_resolved)
+            uffd_wake(pt, page);
+
+        uffd_fault_page = -1;
+    }
+
+    return 0;
+}
+
+static int uffd_setup(struct page_table *pt)
+{
+    struct uffdio_api api;
+    struct uffdio_register reg;
+    int saved;
+
+    pt->uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    if (pt->uffd < 0)
+        return -1;
+
+    memset(&api, 0, sizeof(api));
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+    if (ioctl(pt->uffd, UFFDIO_API, &api) < 0)
+        goto close_uffd;
+
+    memset(&reg, 0, sizeof(reg));
+    reg.range.start = (unsigned long)pt->virtmem;
+    reg.range.len = (unsigned long)pt->npages * pt->page_size;
+    reg.mode = UFFDIO_REGISTER_MODE_MISSING | UFFDIO_REGISTER_MODE_WP;
+    if (ioctl(pt->uffd, UFFDIO_REGISTER, &reg) < 0)
+        goto close_uffd;
+
+    if (pipe(pt->stop_pipe) < 0)
+        goto close_uffd;
+
+    pt->nfault_threads = 0;
+    pt->fault_threads = 0;
+
+    if (page_table_add_fault_threads(pt, 1) < 0)
+    {
+        free(pt->fault_threads);
+        close(pt->stop_pipe[0]);
+        close(pt->stop_pipe[1]);
+        goto close_uffd;
+    }
+    return 0;
+
+close_uffd:
+    saved = errno;
+    close(pt->uffd);
+    errno = saved;
+    return -1;
+}
+
+static void uffd_teardown(struct page_table *pt)
+{
+    struct uffdio_range range;
+
+    // the byte is never read, so it stops every handler thread
+    if (write(pt->stop_pipe[1], "", 1) == 1)
+    {
+        for (int i = 0; i < pt->nfault_threads; i++)
+            pthread_join(pt->fault_threads[i], 0);
+    }
+    free(pt->fault_threads);
+
+    range.start = (unsigned long)pt->virtmem;
+    range.len = (unsigned long)pt->npages * pt->page_size;
+    ioctl(pt->uffd, UFFDIO_UNREGISTER, &range);
+
+    close(pt->stop_pipe[0]);
+    close(pt->stop_pipe[1]);
+    close(pt->uffd);
+}
+
 struct page_table *page_table_create(int npages, int nframes, page_fault_handler_t handler)
 {
-    int i;
+    return page_table_create_with_backend(npages, nframes, handler, PAGE_TABLE_BACKEND_SIGSEGV);
+}
+
+struct page_table *page_table_create_with_backend(int npages, int nframes, page_fault_handler_t handler, enum page_table_backend backend)
+{
+    return page_table_create_with_page_size(npages, nframes, PAGE_SIZE, handler, backend);
+}
+
+// whether the kernel gives shared memory transparent huge pages when advised to
+static int shmem_thp_enabled(void)
+{
+    char mode[128] = "";
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+
+    if (!f)
+        return 0;
+    if (!fgets(mode, sizeof(mode), f))
+        mode[0] = 0;
+    fclose(f);
+
+    return !strstr(mode, "[never]") && !strstr(mode, "[deny]");
+}
+
+// Open the file behind physmem, big enough for "nframes" frames and for the
+// npages pages virtmem maps from it, and map the frames. Pages of PAGE_SIZE_MAX
+// come from hugetlbfs when the system has huge pages reserved, and otherwise
+// from shared memory advised to use transparent huge pages.
+static int physmem_setup(struct page_table *pt, int npages, int nframes)
+{
+    size_t file_size = (size_t)(npages > nframes ? npages : nframes) * pt->page_size;
+    size_t size = (size_t)nframes * pt->page_size;
+    char filename[256];
+
+    pt->memory = PAGE_TABLE_MEMORY_NORMAL;
+
+    if (pt->page_size == PAGE_SIZE_MAX)
+    {
+        // mapping the frames reserves the huge pages, and fails if there are too few
+        pt->fd = memfd_create("physmem", MFD_HUGETLB);
+        if (pt->fd >= 0 && ftruncate(pt->fd, file_size) == 0)
+        {
+            pt->physmem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, pt->fd, 0);
+            if (pt->physmem != MAP_FAILED)
+            {
+                pt->memory = PAGE_TABLE_MEMORY_HUGETLB;
+                return 0;
+            }
+        }
+        if (pt->fd >= 0)
+            close(pt->fd);
+
+        pt->fd = memfd_create("physmem", 0);
+    }
+    else
+    {
+        sprintf(filename, "/tmp/pmem.%d.%d", getpid(), getuid());
+        pt->fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, 0777);
+        unlink(filename);
+    }
+
+    if (pt->fd < 0)
+        return -1;
+
+    if (ftruncate(pt->fd, file_size) < 0 ||
+        (pt->physmem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, pt->fd, 0)) == MAP_FAILED)
+    {
+        close(pt->fd);
+        return -1;
+    }
+
+    if (pt->page_size == PAGE_SIZE_MAX && madvise(pt->physmem, size, MADV_HUGEPAGE) == 0 && shmem_thp_enabled())
+        pt->memory = PAGE_TABLE_MEMORY_THP;
+
+    return 0;
+}
+
+// drop a page table's hold on its physical memory, unmapping it with the last one
+static void physmem_release(struct page_table *pt)
+{
+    if (--*pt->physmem_refs > 0)
+        return;
+
+    munmap(pt->physmem, (size_t)pt->nframes * pt->page_size);
+    close(pt->fd);
+    free(pt->physmem_refs);
+}
+
+// Map the virtual memory of a page table, whose physical memory is set up, and
+// start delivering its faults to "handler". Returns -1 with errno set on failure.
+static int virtmem_setup(struct page_table *pt, int npages, page_fault_handler_t handler)
+{
     struct sigaction sa;
+    size_t size = (size_t)npages * pt->page_size;
+
+    if (pt->backend == PAGE_TABLE_BACKEND_USERFAULTFD)
+        pt->virtmem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    else
+        pt->virtmem = mmap(0, size, PROT_NONE, MAP_SHARED | MAP_NORESERVE, pt->fd, 0);
+    if (pt->virtmem == MAP_FAILED)
+        return -1;
+    pt->npages = npages;
+
+    pt->nroot = (npages + PT_MIDDLE_PAGES - 1) / PT_MIDDLE_PAGES;
+    pt->root = calloc(pt->nroot, sizeof(pte_t **));
+    pt->table_bytes = pt->nroot * sizeof(pte_t **);
+
+    pt->handler = handler;
+    pt->private = 0;
+
+    if (!pt->root || (pt->backend == PAGE_TABLE_BACKEND_USERFAULTFD && uffd_setup(pt) < 0))
+    {
+        int saved = errno;
+        munmap(pt->virtmem, size);
+        free(pt->root);
+        errno = saved;
+        return -1;
+    }
+
+    // faults on userfaultfd memory come through the descriptor: a SIGSEGV there
+    // is a real one, and is left to kill the process
+    if (pt->backend == PAGE_TABLE_BACKEND_SIGSEGV)
+    {
+        sa.sa_sigaction = internal_fault_handler;
+        sa.sa_flags = SA_SIGINFO;
+
+        sigfillset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, 0);
+    }
+
+    pt->next = page_tables;
+    page_tables = pt;
+    return 0;
+}
+
+struct page_table *page_table_create_with_page_size(int npages, int nframes, int page_size, page_fault_handler_t handler, enum page_table_backend backend)
+{
     struct page_table *pt;
-    char filename[256];
+
+    if (page_size < PAGE_SIZE || page_size > PAGE_SIZE_MAX || (page_size & (page_size - 1)))
+    {
+        errno = EINVAL;
+        return 0;
+    }
 
     pt = malloc(sizeof(struct page_table));
     if (!pt)
         return 0;
 
-    the_page_table = pt;
+    pt->backend = backend;
+    pt->page_size = page_size;
 
-    sprintf(filename, "/tmp/pmem.%d.%d", getpid(), getuid());
+    pt->physmem_refs = malloc(sizeof(int));
+    if (!pt->physmem_refs || physmem_setup(pt, npages, nframes) < 0)
+    {
+        int saved = errno;
+        free(pt->physmem_refs);
+        free(pt);
+        errno = saved;
+        return 0;
+    }
+    pt->nframes = nframes;
+    *pt->physmem_refs = 1;
 
-    pt->fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, 0777);
-    if (!pt->fd)
+    if (virtmem_setup(pt, npages, handler) < 0)
+    {
+        int saved = errno;
+        physmem_release(pt);
+        free(pt);
+        errno = saved;
         return 0;
+    }
 
-    ftruncate(pt->fd, PAGE_SIZE * npages);
+    return pt;
+}
 
-    unlink(filename);
+struct page_table *page_table_create_shared(struct page_table *share, int npages, page_fault_handler_t handler)
+{
+    struct page_table *pt = malloc(sizeof(struct page_table));
+    struct stat st;
+    off_t file_size = (off_t)npages * share->page_size;
 
-    pt->physmem = mmap(0, nframes * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, pt->fd, 0);
-    pt->nframes = nframes;
+    if (!pt)
+        return 0;
 
-    pt->virtmem = mmap(0, npages * PAGE_SIZE, PROT_NONE, MAP_SHARED | MAP_NORESERVE, pt->fd, 0);
-    pt->npages = npages;
+    // virtmem maps the file from the start, so it must be as long as virtmem is
+    if (share->backend == PAGE_TABLE_BACKEND_SIGSEGV &&
+        (fstat(share->fd, &st) < 0 || (st.st_size < file_size && ftruncate(share->fd, file_size) < 0)))
+    {
+        free(pt);
+        return 0;
+    }
 
-    pt->page_bits = malloc(sizeof(int) * npages);
-    pt->page_mapping = malloc(sizeof(int) * npages);
+    pt->backend = share->backend;
+    pt->page_size = share->page_size;
+    pt->fd = share->fd;
+    pt->physmem = share->physmem;
+    pt->nframes = share->nframes;
+    pt->memory = share->memory;
+    pt->physmem_refs = share->physmem_refs;
+    ++*pt->physmem_refs;
 
-    pt->handler = handler;
+    if (virtmem_setup(pt, npages, handler) < 0)
+    {
+        int saved = errno;
+        physmem_release(pt);
+        free(pt);
+        errno = saved;
+        return 0;
+    }
 
-    for (i = 0; i < pt->npages; i++)
-        pt->page_bits[i] = 0;
+    return pt;
+}
 
-    sa.sa_sigaction = internal_fault_handler;
-    sa.sa_flags = SA_SIGINFO;
+int page_table_add_fault_threads(struct page_table *pt, int count)
+{
+    if (pt->backend != PAGE_TABLE_BACKEND_USERFAULTFD || count <= 0)
+        return 0;
 
-    sigfillset(&sa.sa_mask);
-    sigaction(SIGSEGV, &sa, 0);
+    pthread_t *threads = realloc(pt->fault_threads, (pt->nfault_threads + count) * sizeof(pthread_t));
 
-    return pt;
+    if (!threads)
+        return -1;
+    pt->fault_threads = threads;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (pthread_create(&pt->fault_threads[pt->nfault_threads], 0, uffd_fault_thread, pt) != 0)
+            return -1;
+        pt->nfault_threads++;
+    }
+    return 0;
 }
 
 void page_table_delete(struct page_table *pt)
 {
-    munmap(pt->virtmem, pt->npages * PAGE_SIZE);
-    munmap(pt->physmem, pt->nframes * PAGE_SIZE);
-    free(pt->page_bits);
-    free(pt->page_mapping);
-    close(pt->fd);
+    if (pt->backend == PAGE_TABLE_BACKEND_USERFAULTFD)
+        uffd_teardown(pt);
+
+    for (struct page_table **p = &page_tables; *p; p = &(*p)->next)
+    {
+        if (*p == pt)
+        {
+            *p = pt->next;
+            break;
+        }
+    }
+
+    munmap(pt->virtmem, (size_t)pt->npages * pt->page_size);
+    tables_free(pt);
+    physmem_release(pt);
     free(pt);
 }
 
@@ -126,11 +679,37 @@ void page_table_set_entry(struct page_table *pt, int page, int frame, int bits)
         abort();
     }
 
-    pt->page_mapping[page] = frame;
-    pt->page_bits[page] = bits;
+    pte_t *pte = pte_alloc(pt, page);
 
-    remap_file_pages(pt->virtmem + page * PAGE_SIZE, PAGE_SIZE, 0, frame, 0);
-    mprotect(pt->virtmem + page * PAGE_SIZE, PAGE_SIZE, bits);
+    if (!pte)
+    {
+        fprintf(stderr, "page_table_set_entry: out of memory for the entry of page #%d\n", page);
+        abort();
+    }
+
+    long start = latency_now();
+
+    if (pt->backend == PAGE_TABLE_BACKEND_USERFAULTFD)
+    {
+        uffd_set_entry(pt, page, frame, bits);
+        // only a handler thread resolves the fault it is serving
+        if (bits && page == uffd_fault_page)
+            uffd_fault_resolved = 1;
+    }
+    else
+    {
+        // a remapped page keeps its protection until the mprotect, so an
+        // accessible page is closed off first: another thread must not reach
+        // the new frame through the old bits
+        if (pte_bits(*pte) && frame != pte_frame(*pte))
+            mprotect(pt->virtmem + (size_t)page * pt->page_size, pt->page_size, PROT_NONE);
+        remap_file_pages(pt->virtmem + (size_t)page * pt->page_size, pt->page_size, 0, (size_t)frame * (pt->page_size / PAGE_SIZE), 0);
+        mprotect(pt->virtmem + (size_t)page * pt->page_size, pt->page_size, bits);
+    }
+
+    *pte = (pte_t)frame << PTE_FRAME_SHIFT | (bits & PTE_PROT);
+
+    latency_record(LATENCY_MAP, start);
 }
 
 void page_table_get_entry(struct page_table *pt, int page, int *frame, int *bits)
@@ -141,8 +720,10 @@ void page_table_get_entry(struct page_table *pt, int page, int *frame, int *bits
         abort();
     }
 
-    *frame = pt->page_mapping[page];
-    *bits = pt->page_bits[page];
+    pte_t pte = pte_get(pt, page);
+
+    *frame = pte_frame(pte);
+    *bits = pte_bits(pte);
 }
 
 void page_table_print_entry(struct page_table *pt, int page)
@@ -153,11 +734,12 @@ void page_table_print_entry(struct page_table *pt, int page)
         abort();
     }
 
-    int b = pt->page_bits[page];
+    pte_t pte = pte_get(pt, page);
+    int b = pte_bits(pte);
 
     printf("page %06d: frame %06d bits %c%c%c\n",
            page,
-           pt->page_mapping[page],
+           pte_frame(pte),
            b & PROT_READ ? 'r' : '-',
            b & PROT_WRITE ? 'w' : '-',
            b & PROT_EXEC ? 'x' : '-');
@@ -182,6 +764,11 @@ int page_table_get_npages(struct page_table *pt)
     return pt->npages;
 }
 
+size_t page_table_get_table_bytes(struct page_table *pt)
+{
+    return pt->table_bytes;
+}
+
 char *page_table_get_virtmem(struct page_table *pt)
 {
     return pt->virtmem;
@@ -190,4 +777,29 @@ char *page_table_get_virtmem(struct page_table *pt)
 char *page_table_get_physmem(struct page_table *pt)
 {
     return pt->physmem;
-}
\ No newline at end of file
+}
+
+int page_table_get_page_size(struct page_table *pt)
+{
+    return pt->page_size;
+}
+
+enum page_table_memory page_table_get_memory(struct page_table *pt)
+{
+    return pt->memory;
+}
+
+enum page_table_backend page_table_get_backend(struct page_table *pt)
+{
+    return pt->backend;
+}
+
+void page_table_set_private(struct page_table *pt, void *data)
+{
+    pt->private = data;
+}
+
+void *page_table_get_private(struct page_table *pt)
+{
+    return pt->private;
+}
@@ -7,23 +7,114 @@
 #define PAGE_SIZE 4096
 #endif
 
+// the largest page size a page table can be created with: one huge page
+#define PAGE_SIZE_MAX (2 * 1024 * 1024)
+
 struct page_table;
 
-typedef void (*page_fault_handler_t)(struct page_table *pt, int page);
+/*
+The access that caused a page fault, as far as the backend can tell.
+PAGE_TABLE_ACCESS_WRITE is a store, to a page absent or mapped without PROT_WRITE;
+the handler may then map the page writable at once, sparing the fault a store to
+a page just mapped read-only would take. PAGE_TABLE_ACCESS_READ is a load or an
+instruction fetch. PAGE_TABLE_ACCESS_UNKNOWN is given where the hardware does not
+report it: a fault on a page mapped read-only is then a write, and one on an
+absent page is best treated as a read.
+*/
+
+enum page_table_access
+{
+    PAGE_TABLE_ACCESS_UNKNOWN,
+    PAGE_TABLE_ACCESS_READ,
+    PAGE_TABLE_ACCESS_WRITE
+};
+
+typedef void (*page_fault_handler_t)(struct page_table *pt, int page, enum page_table_access access);
+
+/*
+How page faults are delivered to the handler.
+PAGE_TABLE_BACKEND_SIGSEGV catches SIGSEGV in the faulting thread and maps
+frames with remap_file_pages and mprotect. The access is read from the page
+fault error code on x86, and unknown elsewhere.
+PAGE_TABLE_BACKEND_USERFAULTFD serves faults from a handler thread reading a
+userfaultfd, installing pages with UFFDIO_COPY / UFFDIO_ZEROPAGE and tracking
+write access with userfaultfd write-protect mode. The access is taken from
+the fault message.
+*/
+
+enum page_table_backend
+{
+    PAGE_TABLE_BACKEND_SIGSEGV,
+    PAGE_TABLE_BACKEND_USERFAULTFD
+};
+
+/*
+What the physical memory is backed by.
+PAGE_TABLE_MEMORY_NORMAL is ordinary pages.
+PAGE_TABLE_MEMORY_THP is shared memory advised to use transparent huge pages,
+with the kernel set to honour the advice.
+PAGE_TABLE_MEMORY_HUGETLB is huge pages reserved from hugetlbfs.
+*/
+
+enum page_table_memory
+{
+    PAGE_TABLE_MEMORY_NORMAL,
+    PAGE_TABLE_MEMORY_THP,
+    PAGE_TABLE_MEMORY_HUGETLB
+};
 
 /* Create a new page table, along with a corresponding virtual memory
 that is "npages" big and a physical memory that is "nframes" bit
- When a page fault occurs, the routine pointed to by "handler" will be called. */
+ When a page fault occurs, the routine pointed to by "handler" will be called.
+ The virtual memory may be larger than 2 GiB: only the number of pages must fit
+ in an int. The table only takes memory for the entries around the pages set. */
 
 struct page_table *page_table_create(int npages, int nframes, page_fault_handler_t handler);
 
-/* Delete a page table and the corresponding virtual and physical memories. */
+/* Same as page_table_create, but with an explicit fault delivery backend.
+ Returns null if the backend is not available on this system. */
+
+struct page_table *page_table_create_with_backend(int npages, int nframes, page_fault_handler_t handler, enum page_table_backend backend);
+
+/* Same as page_table_create_with_backend, but with pages and frames of
+ "page_size" bytes: a power of two from PAGE_SIZE to PAGE_SIZE_MAX. Each fault
+ then maps a whole page, and "npages" and "nframes" count pages of that size.
+ Physical memory with pages of PAGE_SIZE_MAX is backed by huge pages when the
+ system has them (see page_table_get_memory).
+ Returns null with errno set to EINVAL if the size is not allowed. */
+
+struct page_table *page_table_create_with_page_size(int npages, int nframes, int page_size, page_fault_handler_t handler, enum page_table_backend backend);
+
+/* Create another address space, "npages" big, over the physical memory of "share":
+ the two page tables have the same frames, page size and backend, and a frame
+ mapped in one can be read in the other. Each page table has its own virtual
+ memory, entries and handler. The physical memory lasts until the last page table
+ using it is deleted. Page tables should be created and deleted while none of
+ them is taking faults. Returns null on failure. */
+
+struct page_table *page_table_create_shared(struct page_table *share, int npages, page_fault_handler_t handler);
+
+/* Serve faults with "count" more threads. With the userfaultfd backend faults
+ are handled by dedicated threads, one by default, so a program faulting from
+ several threads at once needs more of them for the handler to run in parallel.
+ The handler must then be safe to call from several threads. The SIGSEGV backend
+ handles every fault in the thread that took it, and ignores this.
+ Returns 0, or -1 if a thread could not be started. */
+
+int page_table_add_fault_threads(struct page_table *pt, int count);
+
+/* Delete a page table and the corresponding virtual memory, and its physical
+ memory unless another page table shares it. */
 
 void page_table_delete(struct page_table *pt);
 
 /*
 Set the frame number and access bits associated with a page.
 The bits may be any of PROT_READ, PROT_WRITE, or PROT_EXEC logical-ored together.
+With the userfaultfd backend a writable page is only copied back into its frame
+when it loses PROT_WRITE or is unmapped, so do that before writing the frame to disk.
+Entries may be changed from threads other than the fault handler, as long as the
+caller serializes them with the handler.
 */
 
 void page_table_set_entry(struct page_table *pt, int page, int frame, int bits);
@@ -44,6 +135,14 @@ char *page_table_get_virtmem(struct page_table *pt);
 
 char *page_table_get_physmem(struct page_table *pt);
 
+/* Return the size of the pages and frames, in bytes. */
+
+int page_table_get_page_size(struct page_table *pt);
+
+/* Return what the physical memory is backed by. */
+
+enum page_table_memory page_table_get_memory(struct page_table *pt);
+
 /* Return the total number of frames in the physical memory. */
 
 int page_table_get_nframes(struct page_table *pt);
@@ -52,6 +151,22 @@ int page_table_get_nframes(struct page_table *pt);
 
 int page_table_get_npages(struct page_table *pt);
 
+/* Return the memory taken by the entries of the page table, in bytes. */
+
+size_t page_table_get_table_bytes(struct page_table *pt);
+
+/* Attach an arbitrary pointer to a page table, for use by the fault handler. */
+
+void page_table_set_private(struct page_table *pt, void *data);
+
+/* Return the pointer attached with page_table_set_private, or null. */
+
+void *page_table_get_private(struct page_table *pt);
+
+/* Return the fault delivery backend the page table was created with. */
+
+enum page_table_backend page_table_get_backend(struct page_table *pt);
+
 /* Print out the page table entry for a single page. */
 
 void page_table_print_entry(struct page_table *pt, int page);
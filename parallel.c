@@ -0,0 +1,210 @@
+#include "parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+struct slice
+{
+    char *data;
+    size_t length;
+    int index;
+    unsigned total;
+};
+
+// a random stream for thread "index" of a program seeded with "seed": thread 0
+// gets the stream srand48(seed) would give, so one thread matches the program
+static void seed_stream(unsigned short xsubi[3], long seed, int index)
+{
+    seed += (long)index * 7919;
+    xsubi[0] = 0x330E;
+    xsubi[1] = seed & 0xffff;
+    xsubi[2] = (seed >> 16) & 0xffff;
+}
+
+static int compare_bytes(const void *pa, const void *pb)
+{
+    int a = *(char *)pa;
+    int b = *(char *)pb;
+
+    return a < b ? -1 : a > b;
+}
+
+static void *alpha_slice(void *arg)
+{
+    struct slice *s = arg;
+    char *data = s->data;
+    size_t length = s->length;
+    unsigned short xsubi[3];
+    int total = 0;
+
+    seed_stream(xsubi, 38290, s->index);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = 0;
+    }
+
+    for (int j = 0; j < 100; j++)
+    {
+        size_t start = nrand48(xsubi) % length;
+        int size = 25;
+        for (int i = 0; i < 100; i++)
+        {
+            data[(start + nrand48(xsubi) % size) % length] = nrand48(xsubi);
+        }
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        total += data[i];
+    }
+
+    s->total = total;
+    return 0;
+}
+
+static void *beta_slice(void *arg)
+{
+    struct slice *s = arg;
+    char *data = s->data;
+    size_t length = s->length;
+    unsigned short xsubi[3];
+    int total = 0;
+
+    seed_stream(xsubi, 4856, s->index);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = nrand48(xsubi);
+    }
+
+    qsort(data, length, 1, compare_bytes);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        total += data[i];
+    }
+
+    s->total = total;
+    return 0;
+}
+
+static void *gamma_slice(void *arg)
+{
+    struct slice *s = arg;
+    unsigned char *data = (unsigned char *)s->data;
+    size_t length = s->length;
+    unsigned total = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = i % 256;
+    }
+
+    for (int j = 0; j < 10; j++)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            total += data[i];
+        }
+    }
+
+    s->total = total;
+    return 0;
+}
+
+static void *delta_slice(void *arg)
+{
+    struct slice *s = arg;
+    unsigned char *data = (unsigned char *)s->data;
+    size_t length = s->length;
+    unsigned total = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = i % 256;
+    }
+
+    for (int j = 0; j < 10; j++)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            total += data[i];
+        }
+        for (size_t i = length - 1; i > 0; i--)
+        {
+            total += data[i];
+        }
+    }
+
+    s->total = total;
+    return 0;
+}
+
+// run "body" over "nthreads" slices of "data" and print the sum of their totals
+static void run_slices(const char *name, void *(*body)(void *), char *data, size_t length, int nthreads)
+{
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    struct slice *slices = malloc(nthreads * sizeof(struct slice));
+    unsigned total = 0;
+
+    if (!threads || !slices || nthreads > length)
+    {
+        fprintf(stderr, "%s: couldn't split %zu bytes among %d threads\n", name, length, nthreads);
+        exit(1);
+    }
+
+    for (int t = 0; t < nthreads; t++)
+    {
+        size_t begin = length * t / nthreads;
+        size_t end = length * (t + 1) / nthreads;
+
+        slices[t] = (struct slice){data + begin, end - begin, t, 0};
+    }
+
+    // thread 0's slice runs in the calling thread
+    for (int t = 1; t < nthreads; t++)
+    {
+        if (pthread_create(&threads[t], 0, body, &slices[t]) != 0)
+        {
+            fprintf(stderr, "%s: couldn't start thread %d\n", name, t);
+            exit(1);
+        }
+    }
+    body(&slices[0]);
+    for (int t = 1; t < nthreads; t++)
+    {
+        pthread_join(threads[t], 0);
+    }
+
+    for (int t = 0; t < nthreads; t++)
+    {
+        total += slices[t].total;
+    }
+
+    printf("%s result is %d\n", name, (int)total);
+
+    free(threads);
+    free(slices);
+}
+
+void alpha_program_parallel(char *data, size_t length, int nthreads)
+{
+    run_slices("alpha", alpha_slice, data, length, nthreads);
+}
+
+void beta_program_parallel(char *data, size_t length, int nthreads)
+{
+    run_slices("beta", beta_slice, data, length, nthreads);
+}
+
+void gamma_program_parallel(char *data, size_t length, int nthreads)
+{
+    run_slices("gamma", gamma_slice, data, length, nthreads);
+}
+
+void delta_program_parallel(char *data, size_t length, int nthreads)
+{
+    run_slices("delta", delta_slice, data, length, nthreads);
+}
@@ -0,0 +1,23 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+/*
+Parallel variants of the programs in program.c, to measure how fault handling
+scales with the number of threads faulting at once.
+
+Each program is split into "nthreads" slices of "data", one per thread, and every
+thread runs the program's work over its own slice: alpha and beta draw from their
+own random streams, seeded from the program's seed and the thread number. The
+partial totals are summed and printed in the same form as the program's result.
+With one thread each variant does exactly what the program does, and prints the
+same result.
+*/
+
+void alpha_program_parallel(char *data, size_t length, int nthreads);
+void beta_program_parallel(char *data, size_t length, int nthreads);
+void gamma_program_parallel(char *data, size_t length, int nthreads);
+void delta_program_parallel(char *data, size_t length, int nthreads);
+
+#endif
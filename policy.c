@@ -0,0 +1,286 @@
+#include "policy.h"
+#include "clock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const struct policy_ops *all_policies[] = {
+    &fifo_policy_ops,
+    &rand_policy_ops,
+    &custom_policy_ops,
+    &clock_policy_ops,
+    &clockpro_policy_ops,
+    &arc_policy_ops,
+    &lirs_policy_ops,
+    &twoq_policy_ops,
+    &opt_policy_ops,
+};
+
+#define NPOLICIES (int)(sizeof(all_policies) / sizeof(all_policies[0]))
+
+const struct policy_ops *policy_lookup(const char *name)
+{
+    for (int i = 0; i < NPOLICIES; i++)
+    {
+        if (!strcmp(all_policies[i]->name, name))
+            return all_policies[i];
+    }
+    return 0;
+}
+
+const char *policy_names(void)
+{
+    static char names[256];
+
+    if (!names[0])
+    {
+        for (int i = 0; i < NPOLICIES; i++)
+        {
+            if (i)
+                strcat(names, "|");
+            strcat(names, all_policies[i]->name);
+        }
+    }
+    return names;
+}
+
+struct policy *policy_create(const char *name, struct frame_table *ft, int npages, policy_unreference_t unreference, void *arg)
+{
+    return policy_create_with_quota(name, ft, npages, frame_table_nframes(ft), unreference, arg);
+}
+
+struct policy *policy_create_with_quota(const char *name, struct frame_table *ft, int npages, int quota, policy_unreference_t unreference, void *arg)
+{
+    const struct policy_ops *ops = policy_lookup(name);
+    struct policy *p;
+
+    if (!ops)
+        return 0;
+
+    p = calloc(1, sizeof(*p));
+    if (!p)
+        return 0;
+
+    p->ops = ops;
+    p->ft = ft;
+    p->npages = npages;
+    p->nframes = quota;
+    p->unreference = unreference;
+    p->arg = arg;
+
+    if (ops->init && ops->init(p) < 0)
+    {
+        free(p);
+        return 0;
+    }
+
+    return p;
+}
+
+void policy_delete(struct policy *p)
+{
+    if (p->ops->destroy)
+        p->ops->destroy(p);
+    free(p);
+}
+
+void policy_unreference(struct policy *p, int frame)
+{
+    if (p->unreference)
+        p->unreference(p->arg, frame);
+    else
+        frame_table_info(p->ft, frame)->flags &= ~FRAME_REFERENCED;
+}
+
+int policy_list_victim(struct policy *p, struct page_list *l, int *prev)
+{
+    for (int page = l->tail; page >= 0; page = prev[page])
+    {
+        int frame = frame_table_lookup(p->ft, page);
+
+        if (frame >= 0 && !frame_table_info(p->ft, frame)->pins)
+            return page;
+    }
+    return -1;
+}
+
+void policy_on_fault(struct policy *p, int page)
+{
+    if (p->ops->on_fault)
+        p->ops->on_fault(p, page);
+}
+
+void policy_on_access(struct policy *p, int page, int frame)
+{
+    if (p->ops->on_access)
+        p->ops->on_access(p, page, frame);
+}
+
+int policy_choose_victim(struct policy *p, int page)
+{
+    return p->ops->choose_victim(p, page);
+}
+
+void policy_on_evict(struct policy *p, int page, int frame)
+{
+    if (p->ops->on_evict)
+        p->ops->on_evict(p, page, frame);
+}
+
+void policy_on_load(struct policy *p, int page, int frame)
+{
+    if (p->ops->on_load)
+        p->ops->on_load(p, page, frame);
+}
+
+/*
+fifo: a counter walks round the frames, and the frame under it is replaced.
+*/
+
+struct fifo_state
+{
+    int frame_counter; // holds an index into the frame table
+};
+
+static int fifo_init(struct policy *p)
+{
+    p->state = calloc(1, sizeof(struct fifo_state));
+    return p->state ? 0 : -1;
+}
+
+static void fifo_destroy(struct policy *p)
+{
+    free(p->state);
+}
+
+static int fifo_choose_victim(struct policy *p, int page)
+{
+    struct fifo_state *s = p->state;
+    int nframes = frame_table_nframes(p->ft);
+
+    for (int i = 0; i < nframes; i++)
+    {
+        int frame = s->frame_counter;
+
+        s->frame_counter = (s->frame_counter + 1) % nframes;
+        if (!frame_table_info(p->ft, frame)->pins)
+            return frame;
+    }
+    return -1;
+}
+
+const struct policy_ops fifo_policy_ops = {
+    .name = "fifo",
+    .init = fifo_init,
+    .destroy = fifo_destroy,
+    .choose_victim = fifo_choose_victim,
+};
+
+/*
+rand: replace a frame chosen uniformly at random.
+*/
+
+static int rand_choose_victim(struct policy *p, int page)
+{
+    int nframes = frame_table_nframes(p->ft);
+    int frame = rand() % nframes;
+
+    // probe onwards from the random pick past pinned frames
+    for (int i = 0; i < nframes; i++)
+    {
+        if (!frame_table_info(p->ft, (frame + i) % nframes)->pins)
+            return (frame + i) % nframes;
+    }
+    return -1;
+}
+
+const struct policy_ops rand_policy_ops = {
+    .name = "rand",
+    .choose_victim = rand_choose_victim,
+};
+
+/*
+custom: fifo with readahead (see readahead.c) turned on.
+*/
+
+const struct policy_ops custom_policy_ops = {
+    .name = "custom",
+    .readahead = 1,
+    .init = fifo_init,
+    .destroy = fifo_destroy,
+    .choose_victim = fifo_choose_victim,
+};
+
+/*
+clock and clockpro: see clock.c.
+*/
+
+static void clock_unreference(void *arg, int frame)
+{
+    policy_unreference(arg, frame);
+}
+
+static int clock_init_common(struct policy *p, int pro)
+{
+    p->state = clock_create(p->ft, p->npages, p->nframes, pro, clock_unreference, p);
+    return p->state ? 0 : -1;
+}
+
+static int clock_init(struct policy *p)
+{
+    return clock_init_common(p, 0);
+}
+
+static int clockpro_init(struct policy *p)
+{
+    return clock_init_common(p, 1);
+}
+
+static void clock_destroy(struct policy *p)
+{
+    clock_delete(p->state);
+}
+
+static void clock_fault(struct policy *p, int page)
+{
+    clock_on_miss(p->state, page);
+}
+
+static int clock_victim(struct policy *p, int page)
+{
+    return clock_choose_victim(p->state);
+}
+
+static void clock_evict(struct policy *p, int page, int frame)
+{
+    clock_on_evict(p->state, page);
+}
+
+static void clock_load(struct policy *p, int page, int frame)
+{
+    clock_on_load(p->state, page, frame);
+}
+
+const struct policy_ops clock_policy_ops = {
+    .name = "clock",
+    .sampled = 1,
+    .refbits = 1,
+    .init = clock_init,
+    .destroy = clock_destroy,
+    .on_fault = clock_fault,
+    .choose_victim = clock_victim,
+    .on_evict = clock_evict,
+    .on_load = clock_load,
+};
+
+const struct policy_ops clockpro_policy_ops = {
+    .name = "clockpro",
+    .sampled = 1,
+    .refbits = 1,
+    .init = clockpro_init,
+    .destroy = clock_destroy,
+    .on_fault = clock_fault,
+    .choose_victim = clock_victim,
+    .on_evict = clock_evict,
+    .on_load = clock_load,
+};
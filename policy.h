@@ -0,0 +1,116 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "frame_table.h"
+#include "page_list.h"
+
+/*
+Page replacement policies.
+
+A policy is a table of hooks that the fault handler calls as pages come and go.
+Policies keep their own state and read frame metadata (reference and dirty bits)
+from the frame table; they never touch the page table or the disk, so the same
+code runs inside virtmem and in offline simulation.
+
+For a fault on a non-resident page the handler calls, in order:
+    on_fault(page)
+    choose_victim(page)       -- only if there is no free frame
+    on_evict(victim, frame)   -- for every page that leaves memory
+    on_load(page, frame)
+Pages brought in by readahead go through the same sequence. on_access(page, frame)
+reports a sampled reference to a resident page. Every hook except choose_victim
+may be null. choose_victim must not return a pinned frame.
+*/
+
+struct policy;
+
+/* Clear the reference bit of "frame" and make sure that the next access to its
+ page is seen again. Supplied by the caller of policy_create. */
+
+typedef void (*policy_unreference_t)(void *arg, int frame);
+
+struct policy_ops
+{
+    const char *name;
+
+    // the policy wants references to resident pages to be sampled and passed to on_access
+    int sampled;
+    // the policy clears FRAME_REFERENCED itself, through policy_unreference
+    int refbits;
+    // readahead is on by default with this policy
+    int readahead;
+
+    int (*init)(struct policy *p);
+    void (*destroy)(struct policy *p);
+
+    void (*on_fault)(struct policy *p, int page);
+    void (*on_access)(struct policy *p, int page, int frame);
+    int (*choose_victim)(struct policy *p, int page);
+    void (*on_evict)(struct policy *p, int page, int frame);
+    void (*on_load)(struct policy *p, int page, int frame);
+};
+
+struct policy
+{
+    const struct policy_ops *ops;
+    struct frame_table *ft;
+    int npages;
+    int nframes; // frames it may hold: all of them, or its quota
+    policy_unreference_t unreference;
+    void *arg;
+    void *state;
+};
+
+extern const struct policy_ops fifo_policy_ops;
+extern const struct policy_ops rand_policy_ops;
+extern const struct policy_ops custom_policy_ops;
+extern const struct policy_ops clock_policy_ops;
+extern const struct policy_ops clockpro_policy_ops;
+extern const struct policy_ops arc_policy_ops;
+extern const struct policy_ops lirs_policy_ops;
+extern const struct policy_ops twoq_policy_ops;
+extern const struct policy_ops opt_policy_ops;
+
+/* Create the policy called "name" over the frames of "ft".
+ Returns null if there is no such policy or it could not be set up. */
+
+struct policy *policy_create(const char *name, struct frame_table *ft, int npages, policy_unreference_t unreference, void *arg);
+
+/* Same as policy_create, for local replacement, where several policies share the
+ frames of "ft" and each holds at most "quota" of them. A policy is only told of
+ its own pages, and sizes its lists by its quota; policies that sweep the frames
+ (fifo, rand, clock) rely on the caller pinning the frames of the others while
+ they choose a victim. */
+
+struct policy *policy_create_with_quota(const char *name, struct frame_table *ft, int npages, int quota, policy_unreference_t unreference, void *arg);
+
+/* Delete a policy. */
+
+void policy_delete(struct policy *p);
+
+/* Return the names of all policies separated by "|", for usage messages. */
+
+const char *policy_names(void);
+
+/* Return the policy ops table called "name", or null. */
+
+const struct policy_ops *policy_lookup(const char *name);
+
+/* Call the unreference callback for a frame. */
+
+void policy_unreference(struct policy *p, int frame);
+
+/* Return the resident page nearest the tail of "l" whose frame is not pinned,
+ or -1. "prev" is the list's link array. For use by policies built on page_list. */
+
+int policy_list_victim(struct policy *p, struct page_list *l, int *prev);
+
+/* Hook wrappers, which skip hooks a policy does not implement. */
+
+void policy_on_fault(struct policy *p, int page);
+void policy_on_access(struct policy *p, int page, int frame);
+int policy_choose_victim(struct policy *p, int page);
+void policy_on_evict(struct policy *p, int page, int frame);
+void policy_on_load(struct policy *p, int page, int frame);
+
+#endif
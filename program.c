@@ -27,10 +27,11 @@ static int compare_bytes(const void *pa, const void *pb)
     }
 }
 
-void alpha_program(char *data, int length)
+void alpha_program(char *data, size_t length)
 {
     int total = 0;
-    int i, j;
+    size_t i;
+    int j;
 
     srand48(38290);
 
@@ -41,7 +42,7 @@ void alpha_program(char *data, int length)
 
     for (j = 0; j < 100; j++)
     {
-        int start = lrand48() % length;
+        size_t start = lrand48() % length;
         int size = 25;
         for (i = 0; i < 100; i++)
         {
@@ -57,10 +58,10 @@ void alpha_program(char *data, int length)
     printf("alpha result is %d\n", total);
 }
 
-void beta_program(char *data, int length)
+void beta_program(char *data, size_t length)
 {
     int total = 0;
-    int i;
+    size_t i;
 
     srand48(4856);
 
@@ -79,9 +80,10 @@ void beta_program(char *data, int length)
     printf("beta result is %d\n", total);
 }
 
-void gamma_program(char *cdata, int length)
+void gamma_program(char *cdata, size_t length)
 {
-    unsigned i, j;
+    size_t i;
+    unsigned j;
     unsigned char *data = (unsigned char *)cdata;
     unsigned total = 0;
 
@@ -101,9 +103,10 @@ void gamma_program(char *cdata, int length)
     printf("gamma result is %d\n", total);
 }
 
-void delta_program(char *cdata, int length)
+void delta_program(char *cdata, size_t length)
 {
-    unsigned i, j;
+    size_t i;
+    unsigned j;
     unsigned char *data = (unsigned char *)cdata;
     unsigned total = 0;
 
@@ -6,9 +6,11 @@ Make all of your changes to main.c instead.
 #ifndef PROGRAM_H
 #define PROGRAM_H
 
-void alpha_program(char *data, int length);
-void beta_program(char *data, int length);
-void gamma_program(char *data, int length);
-void delta_program(char *data, int length);
+#include <stddef.h>
+
+void alpha_program(char *data, size_t length);
+void beta_program(char *data, size_t length);
+void gamma_program(char *data, size_t length);
+void delta_program(char *data, size_t length);
 
 #endif
\ No newline at end of file
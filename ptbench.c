@@ -0,0 +1,173 @@
+/*
+Memory overhead of the page table.
+
+ptbench creates a page table for a virtual memory of "npages" pages and sets the
+entries of "count" of them, then reports how much memory the entries take, next
+to the flat arrays the page table used to keep: an int for the frame and an int
+for the bits of every page, used or not. It also times setting an entry, which
+maps the page and so includes the system calls, and looking one up.
+
+The pages set are laid out by "pattern":
+  dense   pages 0 to count - 1, as a program filling its memory from the start
+  spread  every (npages / count)th page, so that no two share a leaf table
+  random  pages drawn at random, repeats included
+
+The virtual memory is only reserved, never touched, so that a page table for
+far more memory than the machine has can be created.
+*/
+
+#include "page_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// frames behind the pages set; the frame mapped is the page number modulo this
+#define BENCH_FRAMES 1024
+
+static void fault_handler(struct page_table *pt, int page, enum page_table_access access)
+{
+    fprintf(stderr, "ptbench: unexpected fault on page #%d\n", page);
+    abort();
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int pattern_page(const char *pattern, int npages, int count, int i)
+{
+    if (!strcmp(pattern, "dense"))
+    {
+        return i;
+    }
+    else if (!strcmp(pattern, "spread"))
+    {
+        return (long)i * (npages / count);
+    }
+    else
+    {
+        return lrand48() % npages;
+    }
+}
+
+static void usage(void)
+{
+    printf("use: ptbench [-b sigsegv|uffd] <npages> <count> <dense|spread|random>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    enum page_table_backend backend = PAGE_TABLE_BACKEND_SIGSEGV;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            if (!strcmp(optarg, "sigsegv"))
+            {
+                backend = PAGE_TABLE_BACKEND_SIGSEGV;
+            }
+            else if (!strcmp(optarg, "uffd"))
+            {
+                backend = PAGE_TABLE_BACKEND_USERFAULTFD;
+            }
+            else
+            {
+                printf("unknown backend: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 3)
+    {
+        usage();
+        return 1;
+    }
+    argv += optind - 1;
+
+    int npages = atoi(argv[1]);
+    int count = atoi(argv[2]);
+    const char *pattern = argv[3];
+
+    if (npages < 1 || count < 1 || count > npages)
+    {
+        printf("npages must be >= 1, and count between 1 and npages\n");
+        return 1;
+    }
+    if (strcmp(pattern, "dense") && strcmp(pattern, "spread") && strcmp(pattern, "random"))
+    {
+        printf("unknown pattern: %s\n", pattern);
+        return 1;
+    }
+
+    struct page_table *pt = page_table_create_with_backend(npages, BENCH_FRAMES, fault_handler, backend);
+    if (!pt)
+    {
+        perror("couldn't create page table");
+        return 1;
+    }
+
+    size_t empty = page_table_get_table_bytes(pt);
+    int *pages = malloc(count * sizeof(int));
+    if (!pages)
+    {
+        printf("couldn't allocate page list\n");
+        return 1;
+    }
+    srand48(1);
+    for (int i = 0; i < count; i++)
+    {
+        pages[i] = pattern_page(pattern, npages, count, i);
+    }
+
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < count; i++)
+    {
+        page_table_set_entry(pt, pages[i], pages[i] % BENCH_FRAMES, PROT_READ);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double set_seconds = elapsed_seconds(&start, &end);
+
+    // every entry is looked up several times, so that the clock sees the lookups
+    long lookups = 0;
+    int frame, bits;
+    volatile int sink;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < 16; round++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            page_table_get_entry(pt, pages[i], &frame, &bits);
+            sink = frame + bits;
+            lookups++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double get_seconds = elapsed_seconds(&start, &end);
+
+    size_t bytes = page_table_get_table_bytes(pt);
+    size_t flat = (size_t)npages * 2 * sizeof(int);
+
+    printf("Page table: %d pages | %d entries set, %s | %zu bytes, %zu empty, %.1f per entry set | flat arrays %zu bytes, %.1fx | set %.0f ns, get %.1f ns\n",
+           npages, count, pattern, bytes, empty, (double)bytes / count, flat, (double)flat / bytes,
+           set_seconds * 1e9 / count, get_seconds * 1e9 / lookups);
+    (void)sink;
+
+    free(pages);
+    page_table_delete(pt);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "readahead.h"
+
+#include <stdlib.h>
+
+#define INITIAL_WINDOW 4
+
+struct readahead
+{
+    int npages;
+    int max_window;
+    int max_outstanding;
+
+    int window;
+    int outstanding; // prefetched pages resident but not used yet
+
+    // stride detection over the access stream
+    int last;   // last page accessed, or -1
+    int stride; // last stride seen
+    int run;    // how many times in a row "stride" was seen
+    int next;   // next page along the stride not requested yet
+
+    struct readahead_stats stats;
+};
+
+struct readahead *readahead_create(int npages, int max_window, int max_outstanding)
+{
+    struct readahead *ra = calloc(1, sizeof(*ra));
+
+    if (!ra)
+        return 0;
+
+    ra->npages = npages;
+    ra->max_window = max_window > 0 ? max_window : 1;
+    ra->max_outstanding = max_outstanding > 0 ? max_outstanding : 1;
+    ra->window = INITIAL_WINDOW < ra->max_window ? INITIAL_WINDOW : ra->max_window;
+    ra->last = -1;
+
+    return ra;
+}
+
+void readahead_delete(struct readahead *ra)
+{
+    free(ra);
+}
+
+static void observe(struct readahead *ra, int page)
+{
+    int stride = page - ra->last;
+
+    if (ra->last >= 0 && stride != 0)
+    {
+        if (stride == ra->stride)
+        {
+            ra->run++;
+        }
+        else
+        {
+            // a new candidate stride: forget what the old run had requested
+            ra->stride = stride;
+            ra->run = 1;
+            ra->next = page + stride;
+        }
+    }
+
+    ra->last = page;
+}
+
+// like observe, for a prefetched page the stream has reached: the pages along
+// the run before it may have been used without the fault handler seeing them
+static void follow(struct readahead *ra, int page)
+{
+    int distance = page - ra->last;
+
+    if (ra->run >= 2 && ra->last >= 0 && distance != 0 && distance % ra->stride == 0 && (distance > 0) == (ra->stride > 0))
+    {
+        ra->run++;
+        ra->last = page;
+    }
+    else
+    {
+        observe(ra, page);
+    }
+}
+
+static int request(struct readahead *ra, int page, int *pages, int max)
+{
+    int count = 0;
+    int stride = ra->stride;
+
+    // an access, then two more at the same stride, make a run
+    if (ra->run < 2)
+        return 0;
+
+    if ((stride > 0 && ra->next <= page) || (stride < 0 && ra->next >= page))
+        ra->next = page + stride;
+
+    int limit = page + ra->window * stride;
+    int p = ra->next;
+
+    while (count < max && ra->outstanding + count < ra->max_outstanding && p >= 0 && p < ra->npages)
+    {
+        if ((stride > 0 && p > limit) || (stride < 0 && p < limit))
+            break;
+
+        pages[count++] = p;
+        p += stride;
+    }
+
+    ra->next = p;
+    return count;
+}
+
+int readahead_on_miss(struct readahead *ra, int page, int *pages, int max)
+{
+    ra->stats.misses++;
+    observe(ra, page);
+    return request(ra, page, pages, max);
+}
+
+int readahead_on_hit(struct readahead *ra, int page, int *pages, int max)
+{
+    readahead_used(ra, page);
+    follow(ra, page);
+    return request(ra, page, pages, max);
+}
+
+void readahead_used(struct readahead *ra, int page)
+{
+    ra->stats.hits++;
+    if (ra->outstanding > 0)
+        ra->outstanding--;
+    if (ra->window < ra->max_window)
+        ra->window++;
+}
+
+void readahead_issued(struct readahead *ra, int page)
+{
+    ra->stats.issued++;
+    ra->outstanding++;
+}
+
+void readahead_on_waste(struct readahead *ra, int page)
+{
+    ra->stats.wasted++;
+    if (ra->outstanding > 0)
+        ra->outstanding--;
+    if (ra->window > 1)
+        ra->window /= 2;
+}
+
+int readahead_stride(struct readahead *ra)
+{
+    return ra->run >= 2 ? ra->stride : 0;
+}
+
+int readahead_window(struct readahead *ra)
+{
+    return ra->window;
+}
+
+struct readahead_stats readahead_get_stats(struct readahead *ra)
+{
+    return ra->stats;
+}
@@ -0,0 +1,77 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+/*
+Adaptive readahead.
+
+The engine watches the stream of accesses that reach the fault handler (demand
+misses and first touches of prefetched pages seen) and looks for runs with a constant
+stride: forward or backward sequential sweeps, or fixed strides. Once a run is
+established it asks for the next "window" pages along the stride. The window
+grows by one for every prefetched page that gets used and halves for every one
+evicted unused, and the number of prefetched-but-unused pages resident at once
+is capped so that readahead cannot take over memory.
+
+The engine only decides which pages to fetch; the caller loads them, and reports
+back with readahead_on_hit / readahead_used / readahead_on_waste. A caller that
+maps prefetched pages readable sees only some first uses, the last page of each
+batch for instance: a hit further along the run continues it.
+*/
+
+struct readahead;
+
+struct readahead_stats
+{
+    int misses;  // demand misses seen
+    int issued;  // pages prefetched
+    int hits;    // prefetched pages that were used
+    int wasted;  // prefetched pages evicted unused
+};
+
+/* Create a readahead engine for "npages" pages. The window never exceeds
+ "max_window" pages, and at most "max_outstanding" prefetched pages may be
+ waiting to be used at once. */
+
+struct readahead *readahead_create(int npages, int max_window, int max_outstanding);
+
+/* Delete a readahead engine. */
+
+void readahead_delete(struct readahead *ra);
+
+/* Report a demand miss on "page". Fills "pages" with up to "max" pages to prefetch
+ and returns how many. The caller skips pages that are already resident but must
+ call readahead_issued for every page it actually loads. */
+
+int readahead_on_miss(struct readahead *ra, int page, int *pages, int max);
+
+/* Report the first access to a prefetched page. Like readahead_on_miss, it may
+ ask for more pages to keep the window ahead of the stream. */
+
+int readahead_on_hit(struct readahead *ra, int page, int *pages, int max);
+
+/* Report that a prefetched page was used without the access being seen, as
+ readahead_on_hit does but asking for nothing. */
+
+void readahead_used(struct readahead *ra, int page);
+
+/* Report that a prefetched page was loaded. */
+
+void readahead_issued(struct readahead *ra, int page);
+
+/* Report that a prefetched page was evicted before it was used. */
+
+void readahead_on_waste(struct readahead *ra, int page);
+
+/* Return the stride of the run being followed, or 0 if there is none. */
+
+int readahead_stride(struct readahead *ra);
+
+/* Return the current window size. */
+
+int readahead_window(struct readahead *ra);
+
+/* Return the counters. */
+
+struct readahead_stats readahead_get_stats(struct readahead *ra);
+
+#endif
@@ -0,0 +1,219 @@
+#include "snapshot.h"
+#include "frame_table.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_MAGIC "VMSNAP01"
+#define SNAPSHOT_MAGIC_SIZE 8
+
+struct snapshot_writer
+{
+    FILE *f;
+    int page_size;
+    int count; // pages still to be appended
+    long bytes;
+};
+
+struct snapshot_reader
+{
+    FILE *f;
+    int npages;
+    int page_size;
+    int count;
+    int left; // pages not read yet
+};
+
+static void put_varint(struct snapshot_writer *s, unsigned long v)
+{
+    while (v >= 0x80)
+    {
+        putc(v | 0x80, s->f);
+        v >>= 7;
+        s->bytes++;
+    }
+    putc(v, s->f);
+    s->bytes++;
+}
+
+// returns -1 at the end of the file, or on a varint too long to be one
+static long get_varint(struct snapshot_reader *s)
+{
+    unsigned long v = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(s->f);
+
+        if (c == EOF)
+            return -1;
+        v |= (unsigned long)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return v > (unsigned long)INT_MAX ? -1 : (long)v;
+    }
+    return -1;
+}
+
+struct snapshot_writer *snapshot_writer_create(const char *filename, int npages, int page_size, int count, const unsigned char *page_zero)
+{
+    struct snapshot_writer *s = malloc(sizeof(*s));
+
+    if (!s)
+        return 0;
+
+    s->f = fopen(filename, "w");
+    if (!s->f)
+    {
+        free(s);
+        return 0;
+    }
+
+    s->page_size = page_size;
+    s->count = count;
+    s->bytes = SNAPSHOT_MAGIC_SIZE;
+    fwrite(SNAPSHOT_MAGIC, 1, SNAPSHOT_MAGIC_SIZE, s->f);
+    put_varint(s, npages);
+    put_varint(s, page_size);
+    put_varint(s, count);
+
+    for (int i = 0; i < npages; i += 8)
+    {
+        int bits = 0;
+
+        for (int j = 0; j < 8 && i + j < npages; j++)
+            bits |= (page_zero[i + j] != 0) << j;
+        putc(bits, s->f);
+        s->bytes++;
+    }
+
+    return s;
+}
+
+void snapshot_write(struct snapshot_writer *s, int page, int flags, const char *data)
+{
+    put_varint(s, page);
+    put_varint(s, flags);
+    if (flags & FRAME_DIRTY)
+    {
+        fwrite(data, 1, s->page_size, s->f);
+        s->bytes += s->page_size;
+    }
+    s->count--;
+}
+
+long snapshot_writer_bytes(struct snapshot_writer *s)
+{
+    return s->bytes;
+}
+
+int snapshot_writer_close(struct snapshot_writer *s)
+{
+    int error = ferror(s->f) || s->count != 0;
+
+    if (fclose(s->f) != 0)
+        error = 1;
+    free(s);
+    return error ? -1 : 0;
+}
+
+struct snapshot_reader *snapshot_reader_open(const char *filename, int npages, int page_size, unsigned char *page_zero)
+{
+    struct snapshot_reader *s = malloc(sizeof(*s));
+    unsigned char *zero = malloc(npages);
+    char magic[SNAPSHOT_MAGIC_SIZE];
+
+    if (!s || !zero)
+    {
+        free(s);
+        free(zero);
+        return 0;
+    }
+
+    s->f = fopen(filename, "r");
+    if (!s->f)
+    {
+        free(s);
+        free(zero);
+        return 0;
+    }
+
+    if (fread(magic, 1, SNAPSHOT_MAGIC_SIZE, s->f) != SNAPSHOT_MAGIC_SIZE || memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE))
+        goto corrupt;
+
+    long recorded_npages = get_varint(s);
+    long recorded_page_size = get_varint(s);
+
+    s->count = get_varint(s);
+    if (recorded_npages < 0 || recorded_page_size < 0 || s->count < 0)
+        goto corrupt;
+    if (recorded_npages != npages || recorded_page_size != page_size)
+    {
+        fclose(s->f);
+        free(s);
+        free(zero);
+        errno = EINVAL;
+        return 0;
+    }
+
+    // the zero map is only handed over once all of it has been read
+    for (int i = 0; i < npages; i += 8)
+    {
+        int bits = getc(s->f);
+
+        if (bits == EOF)
+            goto corrupt;
+        for (int j = 0; j < 8 && i + j < npages; j++)
+            zero[i + j] = (bits >> j) & 1;
+    }
+    memcpy(page_zero, zero, npages);
+    free(zero);
+
+    s->npages = npages;
+    s->page_size = page_size;
+    s->left = s->count;
+    return s;
+
+corrupt:
+    fclose(s->f);
+    free(s);
+    free(zero);
+    errno = EBADMSG;
+    return 0;
+}
+
+int snapshot_reader_count(struct snapshot_reader *s)
+{
+    return s->count;
+}
+
+int snapshot_read(struct snapshot_reader *s, int *page, int *flags, char *data)
+{
+    if (s->left == 0)
+        return 0;
+
+    long p = get_varint(s);
+    long f = get_varint(s);
+
+    if (p < 0 || p >= s->npages || f < 0)
+        return -1;
+
+    if (f & FRAME_DIRTY)
+    {
+        if (data ? fread(data, 1, s->page_size, s->f) != (size_t)s->page_size : fseek(s->f, s->page_size, SEEK_CUR) < 0)
+            return -1;
+    }
+
+    *page = p;
+    *flags = f;
+    s->left--;
+    return 1;
+}
+
+void snapshot_reader_close(struct snapshot_reader *s)
+{
+    fclose(s->f);
+    free(s);
+}
@@ -0,0 +1,66 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+Snapshots of memory, for a warm restart.
+
+A snapshot records what a run held in memory when it ended: the resident
+pages, most recently used first, with their frame flags, the contents of the
+dirty ones, whose copies on disk are stale, and which disk blocks are known to
+be all zeros. The clean pages are not in it: a run restoring the snapshot reads
+them from the disk the recording run left behind (see disk_reopen), which must
+not have been used by another run in between. A run with fewer frames restores
+the pages used most recently.
+
+The file starts with the magic "VMSNAP01", then the number of pages, the page
+size and the number of resident pages as varints, and the zero map, one bit per
+page. A record follows for each resident page: its number and flags as varints,
+then its contents if it is dirty.
+*/
+
+struct snapshot_writer;
+struct snapshot_reader;
+
+/* Create the snapshot file "filename" of a run over "npages" pages of
+ "page_size" bytes, which will hold "count" resident pages. "page_zero" has a
+ byte for each page, set if its disk block is all zeros. Returns null on
+ failure, with errno set. */
+
+struct snapshot_writer *snapshot_writer_create(const char *filename, int npages, int page_size, int count, const unsigned char *page_zero);
+
+/* Append a resident page with its frame flags. If they include FRAME_DIRTY,
+ the page's contents, at "data", are written as well. */
+
+void snapshot_write(struct snapshot_writer *s, int page, int flags, const char *data);
+
+/* Return the number of bytes written so far. */
+
+long snapshot_writer_bytes(struct snapshot_writer *s);
+
+/* Flush and close a snapshot. Returns 0, or -1 if any write failed or fewer
+ pages were appended than announced. */
+
+int snapshot_writer_close(struct snapshot_writer *s);
+
+/* Open the snapshot file "filename" for restoring, and read its zero map into
+ "page_zero", which has a byte for each page. Returns null with errno set if it
+ cannot be opened, leaving "page_zero" as it was: EBADMSG if it is not a
+ snapshot, and EINVAL if it is not one of "npages" pages of "page_size" bytes. */
+
+struct snapshot_reader *snapshot_reader_open(const char *filename, int npages, int page_size, unsigned char *page_zero);
+
+/* Return the number of resident pages recorded. */
+
+int snapshot_reader_count(struct snapshot_reader *s);
+
+/* Read the next resident page into "page" and "flags", and its contents into
+ "data" if it is dirty; with "data" null they are skipped. Returns 1, 0 at the
+ end of the snapshot, or -1 if it is corrupt. */
+
+int snapshot_read(struct snapshot_reader *s, int *page, int *flags, char *data);
+
+/* Close a snapshot opened for restoring. */
+
+void snapshot_reader_close(struct snapshot_reader *s);
+
+#endif
@@ -0,0 +1,345 @@
+#include "swap_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// segments only the cleaner may open, so that it can always copy a segment out
+#define RESERVE_SEGMENTS 1
+
+// the cleaner starts when this many segments are free, and stops one later
+#define CLEAN_LOW (RESERVE_SEGMENTS + 2)
+
+enum segment_state
+{
+    SEGMENT_FREE,
+    SEGMENT_OPEN,     // one of the two being appended to
+    SEGMENT_FULL,
+    SEGMENT_CLEANING  // its live pages are being copied out
+};
+
+struct swap_log
+{
+    int npages;
+    int segment_blocks;
+    int nsegments;
+
+    int *map;   // block holding the current copy of each page, or -1
+    int *owner; // a page whose copy each block holds, or -1 if the block is stale
+    int *snext; // pages holding the same block, in a ring; a page alone is its own ring
+    int *sprev;
+    int *from;  // for a block a live page is being copied to, the block it is copied from, or -1
+
+    unsigned char *state;
+    int *live;     // live blocks in each segment
+    int *inflight; // reads and writes of each segment's blocks not yet completed
+    int *free;    // stack of free segments
+    int nfree;
+
+    int hot, hot_next;   // open segment for new writes, and its next block; -1 if none
+    int cold, cold_next; // open segment for the cleaner's copies
+    int victim;          // segment being cleaned, or -1
+    int cleaning;
+
+    struct swap_log_stats stats;
+};
+
+struct swap_log *swap_log_create(int npages, int segment_blocks, int spare)
+{
+    struct swap_log *l = calloc(1, sizeof(*l));
+
+    if (!l)
+        return 0;
+
+    int data = (npages + segment_blocks - 1) / segment_blocks;
+    int extra = ((long)data * spare + 99) / 100;
+
+    // the two open segments and the reserve come on top of the spare ones
+    l->npages = npages;
+    l->segment_blocks = segment_blocks;
+    l->nsegments = data + (extra > 3 ? extra : 3) + 2 + RESERVE_SEGMENTS;
+
+    int nblocks = swap_log_nblocks(l);
+
+    l->map = malloc(npages * sizeof(int));
+    l->snext = malloc(npages * sizeof(int));
+    l->sprev = malloc(npages * sizeof(int));
+    l->owner = malloc(nblocks * sizeof(int));
+    l->from = malloc(nblocks * sizeof(int));
+    l->state = calloc(l->nsegments, 1);
+    l->live = calloc(l->nsegments, sizeof(int));
+    l->inflight = calloc(l->nsegments, sizeof(int));
+    l->free = malloc(l->nsegments * sizeof(int));
+    if (!l->map || !l->snext || !l->sprev || !l->owner || !l->from || !l->state || !l->live || !l->inflight || !l->free)
+    {
+        swap_log_delete(l);
+        return 0;
+    }
+
+    memset(l->map, -1, npages * sizeof(int));
+    memset(l->owner, -1, nblocks * sizeof(int));
+    memset(l->from, -1, nblocks * sizeof(int));
+    for (int page = 0; page < npages; page++)
+        l->snext[page] = l->sprev[page] = page;
+
+    // segments are handed out from the front of the disk first
+    for (int s = l->nsegments - 1; s >= 0; s--)
+        l->free[l->nfree++] = s;
+
+    l->hot = l->cold = l->victim = -1;
+    l->stats.segments = l->nsegments;
+
+    return l;
+}
+
+void swap_log_delete(struct swap_log *l)
+{
+    free(l->map);
+    free(l->snext);
+    free(l->sprev);
+    free(l->owner);
+    free(l->from);
+    free(l->state);
+    free(l->live);
+    free(l->inflight);
+    free(l->free);
+    free(l);
+}
+
+int swap_log_nblocks(struct swap_log *l)
+{
+    return l->nsegments * l->segment_blocks;
+}
+
+int swap_log_segment_blocks(struct swap_log *l)
+{
+    return l->segment_blocks;
+}
+
+// free a full segment once nothing on it is needed or still in flight
+static void segment_check(struct swap_log *l, int s)
+{
+    if (l->state[s] == SEGMENT_FULL && !l->live[s] && !l->inflight[s])
+    {
+        l->state[s] = SEGMENT_FREE;
+        l->free[l->nfree++] = s;
+    }
+}
+
+// the next block of an open segment, opening a free one if needed
+static int segment_append(struct swap_log *l, int *open, int *next)
+{
+    if (*open < 0)
+    {
+        *open = l->free[--l->nfree];
+        *next = 0;
+        l->state[*open] = SEGMENT_OPEN;
+    }
+
+    int block = *open * l->segment_blocks + (*next)++;
+
+    if (*next == l->segment_blocks)
+    {
+        l->state[*open] = SEGMENT_FULL;
+        *open = -1;
+    }
+    return block;
+}
+
+// make "block" the current copy of "page"
+static void block_map(struct swap_log *l, int page, int block)
+{
+    swap_log_discard(l, page);
+    l->map[page] = block;
+    l->owner[block] = page;
+    l->live[block / l->segment_blocks]++;
+}
+
+// move the pages holding block "from" to block "to", which takes over its place
+static void block_move(struct swap_log *l, int from, int to)
+{
+    int page = l->owner[from];
+
+    do
+    {
+        l->map[page] = to;
+        page = l->snext[page];
+    } while (page != l->owner[from]);
+
+    l->owner[to] = l->owner[from];
+    l->owner[from] = -1;
+    l->live[to / l->segment_blocks]++;
+    l->live[from / l->segment_blocks]--;
+}
+
+int swap_log_can_write(struct swap_log *l, int count)
+{
+    long room = l->hot >= 0 ? l->segment_blocks - l->hot_next : 0;
+
+    if (l->nfree > RESERVE_SEGMENTS)
+        room += (long)(l->nfree - RESERVE_SEGMENTS) * l->segment_blocks;
+    return room >= count;
+}
+
+int swap_log_write(struct swap_log *l, int page)
+{
+    int block = segment_append(l, &l->hot, &l->hot_next);
+
+    block_map(l, page, block);
+    l->inflight[block / l->segment_blocks]++;
+    l->stats.writes++;
+    return block;
+}
+
+void swap_log_discard(struct swap_log *l, int page)
+{
+    int block = l->map[page];
+
+    if (block < 0)
+        return;
+
+    l->map[page] = -1;
+
+    // the block stays live for the other pages holding it
+    if (l->snext[page] != page)
+    {
+        if (l->owner[block] == page)
+            l->owner[block] = l->snext[page];
+        l->snext[l->sprev[page]] = l->snext[page];
+        l->sprev[l->snext[page]] = l->sprev[page];
+        l->snext[page] = l->sprev[page] = page;
+        return;
+    }
+
+    int s = block / l->segment_blocks;
+
+    l->owner[block] = -1;
+    l->live[s]--;
+    segment_check(l, s);
+}
+
+int swap_log_share(struct swap_log *l, int page, int with)
+{
+    int block = l->map[with];
+
+    if (block < 0 || page == with)
+        return -1;
+    if (l->map[page] == block)
+        return 0;
+
+    swap_log_discard(l, page);
+    l->map[page] = block;
+    l->snext[page] = l->snext[with];
+    l->sprev[page] = with;
+    l->sprev[l->snext[with]] = page;
+    l->snext[with] = page;
+    l->stats.shares++;
+    return 0;
+}
+
+int swap_log_read(struct swap_log *l, int page)
+{
+    int block = l->map[page];
+
+    if (block < 0)
+        return -1;
+
+    // a copy not written yet: its source is still good
+    if (l->from[block] >= 0)
+        block = l->from[block];
+
+    l->inflight[block / l->segment_blocks]++;
+    return block;
+}
+
+void swap_log_release(struct swap_log *l, int block)
+{
+    int s = block / l->segment_blocks;
+
+    l->inflight[s]--;
+    segment_check(l, s);
+}
+
+int swap_log_needs_cleaning(struct swap_log *l)
+{
+    if (l->nfree <= CLEAN_LOW)
+        l->cleaning = 1;
+    else if (l->nfree > CLEAN_LOW + 1)
+        l->cleaning = 0;
+    return l->cleaning;
+}
+
+static int compare_pages(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+int swap_log_clean_start(struct swap_log *l, int *pages, int *from, int *to)
+{
+    int victim = -1;
+
+    // greedy: the full segment that frees the most room for the least copying.
+    // Blocks still being written are not worth copying yet.
+    for (int s = 0; s < l->nsegments; s++)
+    {
+        if (l->state[s] == SEGMENT_FULL && !l->inflight[s] && l->live[s] > 0 && l->live[s] < l->segment_blocks &&
+            (victim < 0 || l->live[s] < l->live[victim]))
+            victim = s;
+    }
+    if (victim < 0)
+        return -1;
+
+    long room = (l->cold >= 0 ? l->segment_blocks - l->cold_next : 0) + (long)l->nfree * l->segment_blocks;
+    if (room < l->live[victim])
+        return -1;
+
+    int count = 0;
+
+    for (int b = victim * l->segment_blocks; b < (victim + 1) * l->segment_blocks; b++)
+    {
+        int page = l->owner[b];
+
+        if (page >= 0 && l->map[page] == b)
+            pages[count++] = page;
+    }
+    qsort(pages, count, sizeof(int), compare_pages);
+
+    // the cleaner reads the segment as well, which keeps it from being freed as
+    // its pages move out
+    l->state[victim] = SEGMENT_CLEANING;
+    l->inflight[victim]++;
+    l->victim = victim;
+
+    for (int i = 0; i < count; i++)
+    {
+        from[i] = l->map[pages[i]];
+        to[i] = segment_append(l, &l->cold, &l->cold_next);
+        block_move(l, from[i], to[i]);
+        l->from[to[i]] = from[i];
+        l->inflight[to[i] / l->segment_blocks]++;
+    }
+
+    l->stats.moves += count;
+    return count;
+}
+
+void swap_log_clean_done(struct swap_log *l, const int *to, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        l->from[to[i]] = -1;
+        swap_log_release(l, to[i]);
+    }
+
+    l->state[l->victim] = SEGMENT_FULL;
+    swap_log_release(l, l->victim * l->segment_blocks);
+    l->victim = -1;
+    l->stats.cleaned++;
+}
+
+struct swap_log_stats swap_log_get_stats(struct swap_log *l)
+{
+    struct swap_log_stats stats = l->stats;
+
+    stats.free = l->nfree;
+    return stats;
+}
@@ -0,0 +1,115 @@
+#ifndef SWAP_LOG_H
+#define SWAP_LOG_H
+
+/*
+A log-structured layout for the swap area.
+
+Rather than going to a block of its own, every page written is appended to the
+open segment of a log: a run of consecutive disk blocks, filled in order. A batch
+of write-backs then lands on consecutive blocks and goes out as one sequential
+write, whichever pages it holds. A map from pages to blocks finds each page
+again, and its previous block becomes stale.
+
+Segments whose blocks have all gone stale are reused. The others are cleaned:
+the segment with the fewest live blocks is chosen, its live pages are copied to
+a second open segment, kept apart from new writes since pages that survive a
+cleaning tend to change rarely, and it is freed once the copies are written
+(Rosenblum and Ousterhout, "The Design and Implementation of a Log-Structured
+File System", 1992). The pages of a cleaning are laid out in page order, so
+that pages read in sequence are still near each other on disk.
+
+The log only does the bookkeeping: the caller reads and writes the blocks, and
+serializes every call. The blocks returned for reads and writes are held until
+the transfer completes, so that their segment is neither reused nor cleaned
+under it. A few segments are kept for the cleaner alone, so that it can always
+make room.
+
+Pages known to hold the same bytes may hold one block between them (see
+swap_log_share). The block then stays live until the last of them leaves it, and
+a cleaning moves them all at once.
+*/
+
+struct swap_log;
+
+struct swap_log_stats
+{
+    int segments;     // segments in the log
+    int free;         // segments free now
+    long writes;      // pages appended
+    long moves;       // live blocks copied out of segments being cleaned
+    long shares;      // pages given the block of another page with the same bytes
+    int cleaned;      // segments cleaned
+};
+
+/* Create a log for "npages" pages, in segments of "segment_blocks" blocks, with
+ "spare" percent more segments than the pages fill, and at least three more.
+ Every page starts with no copy on disk. Returns null on failure. */
+
+struct swap_log *swap_log_create(int npages, int segment_blocks, int spare);
+
+/* Delete a log. */
+
+void swap_log_delete(struct swap_log *l);
+
+/* Return the number of blocks the disk needs to hold the log. */
+
+int swap_log_nblocks(struct swap_log *l);
+
+/* Return the number of blocks in a segment. */
+
+int swap_log_segment_blocks(struct swap_log *l);
+
+/* Return whether "count" pages can be appended now, without the segments kept
+ for the cleaner. */
+
+int swap_log_can_write(struct swap_log *l, int count);
+
+/* Append "page" to the log, and return the block it is to be written to, held
+ until swap_log_release. Its previous copy is stale from now on. There must be
+ room (see swap_log_can_write). */
+
+int swap_log_write(struct swap_log *l, int page);
+
+/* Forget the copy of "page" on disk: the page is kept elsewhere, or needs none. */
+
+void swap_log_discard(struct swap_log *l, int page);
+
+/* Give "page" the block holding the copy of "with", which the caller knows to
+ hold the same bytes as "page", in place of its own copy. Returns -1 if "with"
+ has no copy on disk. */
+
+int swap_log_share(struct swap_log *l, int page, int with);
+
+/* Return the block to read "page" from, held until swap_log_release, or -1 if
+ the page has no copy on disk. */
+
+int swap_log_read(struct swap_log *l, int page);
+
+/* Let go of a block returned by swap_log_read or swap_log_write, once it has
+ been read or written. */
+
+void swap_log_release(struct swap_log *l, int block);
+
+/* Return whether so few segments are free that the cleaner should run. It keeps
+ running until a few more are. */
+
+int swap_log_needs_cleaning(struct swap_log *l);
+
+/* Start cleaning the segment with the fewest live blocks. Its live pages are
+ given blocks in the cleaner's segment at once: the caller copies block
+ "from[i]" to block "to[i]" for each page "pages[i]", and calls
+ swap_log_clean_done. The arrays must hold a segment. Until then reads of the
+ pages go to their old blocks. Returns the number of pages to copy, or -1 if no
+ segment can be cleaned now. Only one cleaning may be in progress. */
+
+int swap_log_clean_start(struct swap_log *l, int *pages, int *from, int *to);
+
+/* Finish the cleaning started by swap_log_clean_start, once every copy is written. */
+
+void swap_log_clean_done(struct swap_log *l, const int *to, int count);
+
+/* Return the counters. */
+
+struct swap_log_stats swap_log_get_stats(struct swap_log *l);
+
+#endif
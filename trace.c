@@ -0,0 +1,277 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC "VMTRACE1"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_BUFFER_SIZE 65536
+#define VARINT_MAX 10 // bytes in the longest 64-bit varint
+
+struct trace_writer
+{
+    int fd;
+    int error;
+    int last; // page of the previous record
+    long count;
+    int used;
+    unsigned char buffer[TRACE_BUFFER_SIZE];
+};
+
+struct trace_reader
+{
+    int fd;
+    int npages;
+    int last;
+    int pos;
+    int len;
+    unsigned char buffer[TRACE_BUFFER_SIZE];
+};
+
+static unsigned long zigzag_encode(long v)
+{
+    return ((unsigned long)v << 1) ^ (unsigned long)(v >> (sizeof(long) * 8 - 1));
+}
+
+static long zigzag_decode(unsigned long v)
+{
+    return (long)(v >> 1) ^ -(long)(v & 1);
+}
+
+static void writer_flush(struct trace_writer *t)
+{
+    unsigned char *p = t->buffer;
+
+    while (t->used > 0)
+    {
+        ssize_t n = write(t->fd, p, t->used);
+
+        if (n < 0)
+        {
+            t->error = 1;
+            break;
+        }
+        p += n;
+        t->used -= n;
+    }
+    t->used = 0;
+}
+
+static void put_varint(struct trace_writer *t, unsigned long v)
+{
+    if (t->used > TRACE_BUFFER_SIZE - VARINT_MAX)
+    {
+        writer_flush(t);
+    }
+
+    while (v >= 0x80)
+    {
+        t->buffer[t->used++] = v | 0x80;
+        v >>= 7;
+    }
+    t->buffer[t->used++] = v;
+}
+
+struct trace_writer *trace_writer_create(const char *filename, int npages)
+{
+    struct trace_writer *t = malloc(sizeof(*t));
+
+    if (!t)
+        return 0;
+
+    t->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (t->fd < 0)
+    {
+        free(t);
+        return 0;
+    }
+
+    t->error = 0;
+    t->last = 0;
+    t->count = 0;
+    memcpy(t->buffer, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    t->used = TRACE_MAGIC_SIZE;
+    put_varint(t, npages);
+
+    return t;
+}
+
+void trace_write(struct trace_writer *t, int page, int kind)
+{
+    put_varint(t, zigzag_encode((long)page - t->last) << 2 | kind);
+    t->last = page;
+    t->count++;
+}
+
+long trace_writer_count(struct trace_writer *t)
+{
+    return t->count;
+}
+
+int trace_writer_close(struct trace_writer *t)
+{
+    writer_flush(t);
+    if (close(t->fd) < 0)
+    {
+        t->error = 1;
+    }
+
+    int error = t->error;
+    free(t);
+    return error ? -1 : 0;
+}
+
+// refill the buffer, keeping the bytes not consumed yet. Returns the number of bytes available.
+static int reader_fill(struct trace_reader *t)
+{
+    memmove(t->buffer, t->buffer + t->pos, t->len - t->pos);
+    t->len -= t->pos;
+    t->pos = 0;
+
+    while (t->len < TRACE_BUFFER_SIZE)
+    {
+        ssize_t n = read(t->fd, t->buffer + t->len, TRACE_BUFFER_SIZE - t->len);
+
+        if (n <= 0)
+            break;
+        t->len += n;
+    }
+    return t->len;
+}
+
+// read a varint. Returns 1, 0 at a clean end of file, or -1 if it is truncated or too long.
+static int get_varint(struct trace_reader *t, unsigned long *v)
+{
+    if (t->len - t->pos < VARINT_MAX && reader_fill(t) == 0)
+        return 0;
+
+    unsigned long result = 0;
+
+    for (int shift = 0; shift < VARINT_MAX * 7 && t->pos < t->len; shift += 7)
+    {
+        unsigned char b = t->buffer[t->pos++];
+
+        result |= (unsigned long)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            *v = result;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+struct trace_reader *trace_reader_open(const char *filename)
+{
+    struct trace_reader *t = malloc(sizeof(*t));
+    unsigned long npages;
+
+    if (!t)
+        return 0;
+
+    t->fd = open(filename, O_RDONLY);
+    if (t->fd < 0)
+    {
+        free(t);
+        return 0;
+    }
+
+    t->pos = 0;
+    t->len = 0;
+    t->last = 0;
+    if (reader_fill(t) < TRACE_MAGIC_SIZE || memcmp(t->buffer, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0)
+    {
+        trace_reader_close(t);
+        return 0;
+    }
+    t->pos = TRACE_MAGIC_SIZE;
+
+    if (get_varint(t, &npages) != 1 || npages < 1 || npages > 0x7fffffff)
+    {
+        trace_reader_close(t);
+        return 0;
+    }
+    t->npages = npages;
+
+    return t;
+}
+
+int trace_reader_npages(struct trace_reader *t)
+{
+    return t->npages;
+}
+
+int trace_read(struct trace_reader *t, int *page, int *kind)
+{
+    unsigned long v;
+    int status = get_varint(t, &v);
+
+    if (status != 1)
+        return status;
+
+    long next = t->last + zigzag_decode(v >> 2);
+
+    if (next < 0 || next >= t->npages || (v & 3) > TRACE_HIT)
+        return -1;
+
+    t->last = next;
+    *page = next;
+    *kind = v & 3;
+    return 1;
+}
+
+void trace_reader_close(struct trace_reader *t)
+{
+    close(t->fd);
+    free(t);
+}
+
+long trace_load(const char *filename, int *npages, int **pages, unsigned char **kinds)
+{
+    struct trace_reader *t = trace_reader_open(filename);
+    long n = 0, max = 1 << 16;
+    int *p = malloc(max * sizeof(int));
+    unsigned char *k = malloc(max);
+    int page, kind, status = -1;
+
+    while (t && p && k && (status = trace_read(t, &page, &kind)) == 1)
+    {
+        if (n == max)
+        {
+            max *= 2;
+            int *more_pages = realloc(p, max * sizeof(int));
+            unsigned char *more_kinds = realloc(k, max);
+
+            p = more_pages ? more_pages : p;
+            k = more_kinds ? more_kinds : k;
+            if (!more_pages || !more_kinds)
+            {
+                status = -1;
+                break;
+            }
+        }
+        p[n] = page;
+        k[n++] = kind;
+    }
+
+    if (t)
+    {
+        *npages = t->npages;
+        trace_reader_close(t);
+    }
+    if (status < 0)
+    {
+        free(p);
+        free(k);
+        return -1;
+    }
+
+    *pages = p;
+    if (kinds)
+        *kinds = k;
+    else
+        free(k);
+    return n;
+}
@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+Binary fault traces.
+
+A trace is the stream of page references seen by the fault handler, written
+compactly enough to record every fault of a long run. The file starts with the
+magic "VMTRACE1" and the number of pages as a varint. Each record is then one
+varint holding the zigzag-encoded difference from the previous record's page,
+shifted left by two, with the kind in the low two bits. Sequential and nearby
+references, which make up most of a trace, take a single byte.
+
+Writers and readers buffer the file, so recording costs a few instructions per
+fault and replaying runs at memory speed.
+*/
+
+#define TRACE_READ 0  // fault on a page that was not resident
+#define TRACE_WRITE 1 // write to a page not resident, or resident and read-only
+#define TRACE_HIT 2   // access to a resident page, caught by reference sampling or readahead
+
+struct trace_writer;
+struct trace_reader;
+
+/* Create the trace file "filename" for a run over "npages" pages.
+ Returns null on failure, with errno set. */
+
+struct trace_writer *trace_writer_create(const char *filename, int npages);
+
+/* Append a reference of kind "kind" to "page". */
+
+void trace_write(struct trace_writer *t, int page, int kind);
+
+/* Return the number of references written so far. */
+
+long trace_writer_count(struct trace_writer *t);
+
+/* Flush and close a trace. Returns 0, or -1 if any write failed. */
+
+int trace_writer_close(struct trace_writer *t);
+
+/* Open the trace file "filename" for replay. Returns null if it cannot be
+ opened or is not a trace. */
+
+struct trace_reader *trace_reader_open(const char *filename);
+
+/* Return the number of pages of the run that recorded the trace. */
+
+int trace_reader_npages(struct trace_reader *t);
+
+/* Read the next reference into "page" and "kind". Returns 1, 0 at the end of the
+ trace, or -1 if the trace is corrupt. */
+
+int trace_read(struct trace_reader *t, int *page, int *kind);
+
+/* Close a trace opened for replay. */
+
+void trace_reader_close(struct trace_reader *t);
+
+/* Read the whole trace "filename" into memory: the pages referenced into
+ "*pages" and, unless "kinds" is null, their kinds into "*kinds", both allocated
+ with malloc. Stores the number of pages of the run in "*npages". Returns the
+ number of references, or -1 if the trace cannot be read or is corrupt. */
+
+long trace_load(const char *filename, int *npages, int **pages, unsigned char **kinds);
+
+#endif
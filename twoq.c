@@ -0,0 +1,163 @@
+#include "policy.h"
+
+#include <stdlib.h>
+
+/*
+2Q (Johnson and Shasha, VLDB 1994), full version.
+
+A page seen for the first time goes into A1in, a FIFO holding about a quarter of
+the frames. Pages evicted from A1in are remembered in the ghost FIFO A1out; only
+a page that misses while still in A1out is considered hot and goes into Am, an
+LRU list holding the remaining frames. Scans pass through A1in and A1out without
+disturbing Am.
+*/
+
+#define TWOQ_NONE 0
+#define TWOQ_A1IN 1
+#define TWOQ_A1OUT 2
+#define TWOQ_AM 3
+
+struct twoq_state
+{
+    unsigned char *where;
+    int *next;
+    int *prev;
+    struct page_list a1in, a1out, am;
+    int kin;
+    int kout;
+    int into_am;
+};
+
+static struct page_list *twoq_list(struct twoq_state *s, int where)
+{
+    switch (where)
+    {
+    case TWOQ_A1IN:
+        return &s->a1in;
+    case TWOQ_A1OUT:
+        return &s->a1out;
+    case TWOQ_AM:
+        return &s->am;
+    }
+    return 0;
+}
+
+static void twoq_move(struct twoq_state *s, int page, int where)
+{
+    if (s->where[page] != TWOQ_NONE)
+        page_list_remove(twoq_list(s, s->where[page]), s->next, s->prev, page);
+
+    s->where[page] = where;
+
+    if (where != TWOQ_NONE)
+        page_list_push(twoq_list(s, where), s->next, s->prev, page);
+}
+
+static void twoq_destroy(struct policy *p)
+{
+    struct twoq_state *s = p->state;
+
+    free(s->where);
+    free(s->next);
+    free(s->prev);
+    free(s);
+}
+
+static int twoq_init(struct policy *p)
+{
+    struct twoq_state *s = calloc(1, sizeof(*s));
+
+    if (!s)
+        return -1;
+
+    s->where = calloc(p->npages, 1);
+    s->next = malloc(sizeof(int) * p->npages);
+    s->prev = malloc(sizeof(int) * p->npages);
+    p->state = s;
+
+    if (!s->where || !s->next || !s->prev)
+    {
+        twoq_destroy(p);
+        return -1;
+    }
+
+    page_list_init(&s->a1in);
+    page_list_init(&s->a1out);
+    page_list_init(&s->am);
+
+    s->kin = p->nframes / 4 > 1 ? p->nframes / 4 : 1;
+    s->kout = p->nframes / 2 > 1 ? p->nframes / 2 : 1;
+
+    return 0;
+}
+
+static void twoq_on_fault(struct policy *p, int page)
+{
+    struct twoq_state *s = p->state;
+
+    s->into_am = s->where[page] == TWOQ_A1OUT;
+    if (s->into_am)
+        twoq_move(s, page, TWOQ_NONE);
+}
+
+static int twoq_choose_victim(struct policy *p, int page)
+{
+    struct twoq_state *s = p->state;
+    int victim = -1;
+
+    if (s->a1in.size > s->kin || s->am.size == 0)
+        victim = policy_list_victim(p, &s->a1in, s->prev);
+
+    if (victim < 0)
+        victim = policy_list_victim(p, &s->am, s->prev);
+
+    if (victim < 0)
+        victim = policy_list_victim(p, &s->a1in, s->prev);
+
+    return victim < 0 ? -1 : frame_table_lookup(p->ft, victim);
+}
+
+static void twoq_on_evict(struct policy *p, int page, int frame)
+{
+    struct twoq_state *s = p->state;
+
+    if (s->where[page] == TWOQ_A1IN)
+    {
+        twoq_move(s, page, TWOQ_A1OUT);
+        if (s->a1out.size > s->kout)
+            s->where[page_list_pop(&s->a1out, s->next, s->prev)] = TWOQ_NONE;
+    }
+    else if (s->where[page] == TWOQ_AM)
+    {
+        twoq_move(s, page, TWOQ_NONE);
+    }
+}
+
+static void twoq_on_load(struct policy *p, int page, int frame)
+{
+    struct twoq_state *s = p->state;
+
+    twoq_move(s, page, s->into_am ? TWOQ_AM : TWOQ_A1IN);
+    s->into_am = 0;
+}
+
+static void twoq_on_access(struct policy *p, int page, int frame)
+{
+    struct twoq_state *s = p->state;
+
+    // references to pages in A1in are deliberately ignored
+    if (s->where[page] == TWOQ_AM)
+        twoq_move(s, page, TWOQ_AM);
+}
+
+const struct policy_ops twoq_policy_ops = {
+    .name = "2q",
+    .sampled = 1,
+    .init = twoq_init,
+    .destroy = twoq_destroy,
+    .on_fault = twoq_on_fault,
+    .on_access = twoq_on_access,
+    .choose_victim = twoq_choose_victim,
+    .on_evict = twoq_on_evict,
+    .on_load = twoq_on_load,
+};
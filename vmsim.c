@@ -0,0 +1,331 @@
+/*
+Trace-driven simulator for the page replacement policies.
+
+vmsim replays a trace recorded by "virtmem -t" against any policy and number of
+frames, entirely in memory: the policies and the frame table are the same code
+that runs inside virtmem, but there is no page table, no signal handling and no
+disk, so a trace replays at millions of references per second.
+
+Every record of the trace is a reference to its page. A reference to a page that
+is not resident is a miss, read from "disk" into a free frame or the frame of the
+policy's victim; a write reference makes the page dirty, and dirty victims are
+counted as disk writes. References to resident pages set the reference bit and
+are passed to the policy's on_access, as reference sampling would in virtmem,
+except that every hit in the trace is seen.
+
+The trace is also the reference string of the OPT policy (see opt.h), so every
+replay is measured against the optimum: the misses of the policy are reported
+as a multiple of OPT's. With the policy "all", every policy is replayed in turn.
+
+With -m, vmsim instead computes the miss ratio curve of the trace for LRU in
+one pass (see mrc.h), optionally sampling the pages with -S, and reports how
+many frames it takes to get most of the hits LRU can take. Points below the
+frame count the trace was recorded with count hits the trace left out as misses.
+
+A trace recorded with few frames holds nearly every change of page made by the
+program, and so can be replayed at any larger frame count. Two frames is the
+least that lets every program run, since one instruction may touch two pages.
+*/
+
+#include "trace.h"
+#include "frame_table.h"
+#include "policy.h"
+#include "opt.h"
+#include "mrc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// the trace, read into memory before the replay
+int npages;
+long nrefs;
+int *ref_pages;
+unsigned char *ref_kinds;
+
+struct sim_result
+{
+    long page_faults; // misses, and first writes to clean resident pages
+    long disk_reads;  // misses
+    long disk_writes; // dirty evictions
+    double seconds;
+};
+
+// the simulator sees every reference, so a cleared reference bit needs no re-arming
+void unreference_frame(void *arg, int frame)
+{
+    struct frame_table *ft = arg;
+
+    frame_table_info(ft, frame)->flags &= ~FRAME_REFERENCED;
+}
+
+void simulate_reference(struct frame_table *ft, struct policy *policy, struct sim_result *r, long index, int page, int kind)
+{
+    int frame = frame_table_lookup(ft, page);
+    struct frame_info *fi;
+
+    if (frame < 0)
+    {
+        r->page_faults++;
+        r->disk_reads++;
+        policy_on_fault(policy, page);
+
+        frame = frame_table_alloc(ft);
+        if (frame < 0)
+        {
+            frame = policy_choose_victim(policy, page);
+            if (frame < 0)
+            {
+                fprintf(stderr, "%s: no frame can be evicted for page #%d\n", policy->ops->name, page);
+                abort();
+            }
+
+            fi = frame_table_info(ft, frame);
+            if (fi->flags & FRAME_DIRTY)
+            {
+                r->disk_writes++;
+            }
+            policy_on_evict(policy, fi->page, frame);
+            frame_table_unmap(ft, frame);
+        }
+
+        frame_table_map(ft, frame, page);
+        fi = frame_table_info(ft, frame);
+        fi->age = index;
+        policy_on_load(policy, page, frame);
+    }
+    else
+    {
+        fi = frame_table_info(ft, frame);
+        if (kind == TRACE_WRITE && !(fi->flags & FRAME_DIRTY))
+        {
+            r->page_faults++;
+        }
+        fi->flags |= FRAME_REFERENCED;
+        fi->age = index;
+        policy_on_access(policy, page, frame);
+    }
+
+    if (kind == TRACE_WRITE)
+    {
+        fi->flags |= FRAME_DIRTY;
+    }
+}
+
+static double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// replay the whole trace against policy "alg" with "nframes" frames
+int simulate(const char *alg, int nframes, struct sim_result *r)
+{
+    struct frame_table *ft = frame_table_create(nframes, npages);
+    struct policy *policy = ft ? policy_create(alg, ft, npages, unreference_frame, ft) : 0;
+
+    if (!policy || (policy->ops == &opt_policy_ops && opt_set_references(policy, ref_pages, nrefs, 0) < 0))
+    {
+        printf("couldn't create %s policy\n", alg);
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < nrefs; i++)
+    {
+        simulate_reference(ft, policy, r, i, ref_pages[i], ref_kinds[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    r->seconds = elapsed_seconds(&start, &end);
+
+    policy_delete(policy);
+    frame_table_delete(ft);
+    return 0;
+}
+
+// print the LRU miss ratio curve of the trace, and the frames needed for most of the hits
+int miss_ratio_curve(double rate)
+{
+    struct mrc *m = mrc_create(npages, rate);
+
+    if (!m)
+    {
+        printf("couldn't create miss ratio curve\n");
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < nrefs; i++)
+    {
+        mrc_access(m, ref_pages[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = elapsed_seconds(&start, &end);
+
+    int max = mrc_max_distance(m) + 1;
+    if (max > npages)
+    {
+        max = npages;
+    }
+    int step = max > 100 ? max / 100 : 1;
+    long cold = mrc_misses(m, npages);
+
+    printf("Miss ratio curve: %d pages | %ld references | %s | %.6f s\n", npages, nrefs,
+           rate < 1 ? "SHARDS sampling" : "exact", seconds);
+    printf("%10s %12s %10s\n", "nframes", "misses", "ratio");
+    for (int c = 1; c <= max; c = (c < max && c + step > max) ? max : c + step)
+    {
+        long misses = mrc_misses(m, c);
+
+        printf("%10d %12ld %9.2f%%\n", c, misses, nrefs ? 100.0 * misses / nrefs : 0.0);
+    }
+
+    // the smallest memory that takes a given share of the hits a full memory would
+    int shares[] = {90, 95, 99};
+    long best = nrefs - cold;
+
+    for (int i = 0; i < 3; i++)
+    {
+        int c = 1;
+
+        while (c < npages && (nrefs - mrc_misses(m, c)) * 100 < best * shares[i])
+        {
+            c++;
+        }
+        printf("Budget: %d frames for %d%% of the hits\n", c, shares[i]);
+    }
+
+    mrc_delete(m);
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("use: vmsim <tracefile> <nframes> <%s|all>\n", policy_names());
+    printf("     vmsim -m [-S sample-rate] <tracefile>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int curve = 0;
+    double rate = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "mS:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            curve = 1;
+            break;
+        case 'S':
+            rate = atof(optarg);
+            if (rate <= 0 || rate > 1)
+            {
+                printf("sample rate must be > 0 and <= 1\n");
+                exit(1);
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != (curve ? 1 : 3))
+    {
+        usage();
+        return 1;
+    }
+    argv += optind - 1;
+
+    const char *trace_file = argv[1];
+
+    if (curve)
+    {
+        nrefs = trace_load(trace_file, &npages, &ref_pages, &ref_kinds);
+        if (nrefs < 0)
+        {
+            fprintf(stderr, "couldn't read trace file %s\n", trace_file);
+            return 1;
+        }
+        int status = miss_ratio_curve(rate);
+        free(ref_pages);
+        free(ref_kinds);
+        return status < 0;
+    }
+
+    int nframes = atoi(argv[2]);
+    const char *alg = argv[3];
+
+    if (nframes < 1)
+    {
+        printf("nframes must be an integer and >= 1\n");
+        exit(1);
+    }
+
+    if (strcmp(alg, "all") && !policy_lookup(alg))
+    {
+        printf("unknown replacement policy: %s\n", alg);
+        exit(1);
+    }
+
+    nrefs = trace_load(trace_file, &npages, &ref_pages, &ref_kinds);
+    if (nrefs < 0)
+    {
+        fprintf(stderr, "couldn't read trace file %s\n", trace_file);
+        return 1;
+    }
+
+    struct sim_result r, best;
+
+    if (simulate("opt", nframes, &best) < 0)
+    {
+        return 1;
+    }
+
+    if (strcmp(alg, "all"))
+    {
+        if (simulate(alg, nframes, &r) < 0)
+        {
+            return 1;
+        }
+
+        printf("Summary: Page Faults - %ld | Disk Reads - %ld | Disk Writes - %ld \n", r.page_faults, r.disk_reads, r.disk_writes);
+        printf("Replay: %d pages | %d frames | %ld references | %.6f s | %.0f references/sec\n",
+               npages, nframes, nrefs, r.seconds, r.seconds > 0 ? nrefs / r.seconds : 0.0);
+        printf("Optimal: %ld misses | %s %.3fx OPT\n", best.disk_reads, alg,
+               best.disk_reads ? (double)r.disk_reads / best.disk_reads : 1.0);
+    }
+    else
+    {
+        char names[256];
+
+        strcpy(names, policy_names());
+        printf("%d pages | %d frames | %ld references\n", npages, nframes, nrefs);
+        printf("%-10s %12s %12s %12s %10s\n", "policy", "faults", "misses", "writes", "vs OPT");
+        for (char *name = strtok(names, "|"); name; name = strtok(0, "|"))
+        {
+            if (simulate(name, nframes, &r) < 0)
+            {
+                return 1;
+            }
+            printf("%-10s %12ld %12ld %12ld %9.3fx\n", name, r.page_faults, r.disk_reads, r.disk_writes,
+                   best.disk_reads ? (double)r.disk_reads / best.disk_reads : 1.0);
+        }
+    }
+
+    free(ref_pages);
+    free(ref_kinds);
+
+    return 0;
+}
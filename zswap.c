@@ -0,0 +1,155 @@
+#include "zswap.h"
+#include "lz.h"
+#include "page_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct zswap
+{
+    int npages;
+    int page_size;
+    long capacity;
+
+    char **data; // compressed page, or null if the page is not in the pool
+    int *size;
+    int *next;
+    int *prev;
+    struct page_list lru; // head is the most recently stored page
+
+    char *scratch; // compression output, and decompressed pages being spilled
+
+    zswap_spill_t spill;
+    void *arg;
+
+    struct zswap_stats stats;
+};
+
+struct zswap *zswap_create(int npages, int page_size, long capacity, zswap_spill_t spill, void *arg)
+{
+    struct zswap *z = calloc(1, sizeof(*z));
+
+    if (!z)
+        return 0;
+
+    z->npages = npages;
+    z->page_size = page_size;
+    z->capacity = capacity;
+    z->spill = spill;
+    z->arg = arg;
+
+    z->data = calloc(npages, sizeof(char *));
+    z->size = calloc(npages, sizeof(int));
+    z->next = malloc(npages * sizeof(int));
+    z->prev = malloc(npages * sizeof(int));
+    z->scratch = malloc(page_size);
+
+    if (!z->data || !z->size || !z->next || !z->prev || !z->scratch)
+    {
+        zswap_delete(z);
+        return 0;
+    }
+
+    page_list_init(&z->lru);
+
+    return z;
+}
+
+void zswap_delete(struct zswap *z)
+{
+    if (z->data)
+    {
+        for (int i = 0; i < z->npages; i++)
+            free(z->data[i]);
+    }
+
+    free(z->data);
+    free(z->size);
+    free(z->next);
+    free(z->prev);
+    free(z->scratch);
+    free(z);
+}
+
+static void zswap_drop(struct zswap *z, int page)
+{
+    page_list_remove(&z->lru, z->next, z->prev, page);
+    free(z->data[page]);
+    z->data[page] = 0;
+    z->stats.pages--;
+    z->stats.bytes -= z->size[page];
+}
+
+// push the least recently stored page out to disk
+static void zswap_spill_one(struct zswap *z)
+{
+    int page = z->lru.tail;
+
+    if (lz_decompress(z->data[page], z->size[page], z->scratch, z->page_size) != z->page_size)
+    {
+        fprintf(stderr, "zswap: page #%d is corrupt\n", page);
+        abort();
+    }
+
+    zswap_drop(z, page);
+    z->spill(z->arg, page, z->scratch);
+    z->stats.spills++;
+}
+
+int zswap_store(struct zswap *z, int page, const char *data)
+{
+    int size = lz_compress(data, z->page_size, z->scratch, z->page_size * 3 / 4);
+    char *copy;
+
+    if (size < 0 || size > z->capacity || !(copy = malloc(size)))
+    {
+        z->stats.rejects++;
+        return -1;
+    }
+    memcpy(copy, z->scratch, size);
+
+    if (z->data[page])
+        zswap_drop(z, page);
+
+    // spilling reuses the scratch buffer, so the page was copied out first
+    while (z->stats.bytes + size > z->capacity)
+        zswap_spill_one(z);
+
+    z->data[page] = copy;
+    z->size[page] = size;
+    page_list_push(&z->lru, z->next, z->prev, page);
+
+    z->stats.stores++;
+    z->stats.pages++;
+    z->stats.bytes += size;
+    z->stats.stored_in += z->page_size;
+    z->stats.stored_out += size;
+
+    return 0;
+}
+
+int zswap_load(struct zswap *z, int page, char *data)
+{
+    if (!z->data[page])
+    {
+        z->stats.misses++;
+        return -1;
+    }
+
+    if (lz_decompress(z->data[page], z->size[page], data, z->page_size) != z->page_size)
+    {
+        fprintf(stderr, "zswap: page #%d is corrupt\n", page);
+        abort();
+    }
+
+    zswap_drop(z, page);
+    z->stats.hits++;
+
+    return 0;
+}
+
+struct zswap_stats zswap_get_stats(struct zswap *z)
+{
+    return z->stats;
+}
@@ -0,0 +1,58 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+/*
+A compressed in-memory swap tier between physical memory and the virtual disk.
+Evicted pages are compressed (see lz.h) into a pool of bounded size instead of
+being written to disk, and a later fault takes them back out of the pool. When
+the pool is full its least recently stored pages are spilled: decompressed and
+handed to a callback that writes them to disk. Pages that do not compress to at
+most three quarters of their size are rejected and go to disk directly.
+
+Loads are exclusive: a page taken out of the pool is no longer in it, and the
+copy on disk is stale, so the caller must treat the page as dirty.
+*/
+
+struct zswap;
+
+/* Called for every page pushed out of the pool, with its decompressed contents. */
+
+typedef void (*zswap_spill_t)(void *arg, int page, const char *data);
+
+struct zswap_stats
+{
+    int stores;               // pages taken into the pool
+    int rejects;              // pages that compressed too poorly, or did not fit
+    int spills;               // pages pushed out to disk to make room
+    int hits;                 // loads served from the pool
+    int misses;               // loads of pages not in the pool
+    int pages;                // pages in the pool now
+    long bytes;               // compressed bytes in the pool now
+    long long stored_in;      // uncompressed bytes of all pages stored
+    long long stored_out;     // compressed bytes of all pages stored
+};
+
+/* Create a pool for "npages" virtual pages of "page_size" bytes, holding at most
+ "capacity" bytes of compressed data. Returns null on failure. */
+
+struct zswap *zswap_create(int npages, int page_size, long capacity, zswap_spill_t spill, void *arg);
+
+/* Delete a pool and everything in it, without spilling. */
+
+void zswap_delete(struct zswap *z);
+
+/* Compress "page" into the pool, spilling older pages if needed.
+ Returns 0 if the page was stored, -1 if it was rejected. */
+
+int zswap_store(struct zswap *z, int page, const char *data);
+
+/* If "page" is in the pool, decompress it into "data", drop it from the pool and
+ return 0. Otherwise return -1. */
+
+int zswap_load(struct zswap *z, int page, char *data);
+
+/* Return the counters. */
+
+struct zswap_stats zswap_get_stats(struct zswap *z);
+
+#endif